@@ -0,0 +1,71 @@
+// array_config.h — microphone array geometry, steering table and beam output mode
+//
+// Plain macros only: included from tusb_config.h to size the USB stream.
+
+#ifndef ARRAY_CONFIG_H
+#define ARRAY_CONFIG_H
+
+#include "capture_config.h"
+
+// ---------- Geometry ----------
+// Mic positions in 0.1 mm, channel order as captured (I2S: ch0 = GP2 left, ch1 = GP2 right,
+// ...; TDM: TDM_CHANNEL_MAP order). All in the z = 0 plane by default.
+#define ARRAY_N_MICS            CAPTURE_N_CHANNELS
+
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#ifndef ARRAY_MIC_POSITIONS
+// Uniform circular array, radius 50 mm, 45 deg spacing (the default 8-slot map)
+#define ARRAY_MIC_POSITIONS {   \
+    {  500,    0, 0 },          \
+    {  354,  354, 0 },          \
+    {    0,  500, 0 },          \
+    { -354,  354, 0 },          \
+    { -500,    0, 0 },          \
+    { -354, -354, 0 },          \
+    {    0, -500, 0 },          \
+    {  354, -354, 0 },          \
+}
+#endif
+#else
+// Uniform circular array, radius 50 mm, 60 deg spacing
+#define ARRAY_MIC_POSITIONS {   \
+    {  500,    0, 0 },          \
+    {  250,  433, 0 },          \
+    { -250,  433, 0 },          \
+    { -500,    0, 0 },          \
+    { -250, -433, 0 },          \
+    {  250, -433, 0 },          \
+}
+#endif
+
+// ---------- Steering table ----------
+// Beam look directions {azimuth, elevation} in whole degrees, azimuth from +x towards +y.
+#define BEAM_N_BEAMS            4
+#define BEAM_DIRECTIONS {       \
+    {   0, 20 },                \
+    {  90, 20 },                \
+    { 180, 20 },                \
+    { 270, 20 },                \
+}
+
+// ---------- USB output ----------
+#define BEAM_OUTPUT_NONE        0   // raw mics only, beamformer off
+#define BEAM_OUTPUT_APPEND      1   // raw mics followed by the beams
+// APPEND with 6 mics and 4 beams is 10 USB channels: a 24-bit packet would be 49 x 10 x 3 =
+// 1470 B, over the 1023 B Full-Speed iso limit, so that build offers the 16-bit alt only
+// (audio_config.h); 24-bit beams go over vendor bulk.
+#define BEAM_OUTPUT_REPLACE     2   // beams only
+
+#ifndef BEAM_OUTPUT
+#define BEAM_OUTPUT             BEAM_OUTPUT_NONE
+#endif
+
+#if BEAM_OUTPUT == BEAM_OUTPUT_APPEND
+#define ARRAY_N_USB_CHANNELS    (ARRAY_N_MICS + BEAM_N_BEAMS)
+#elif BEAM_OUTPUT == BEAM_OUTPUT_REPLACE
+#define ARRAY_N_USB_CHANNELS    BEAM_N_BEAMS
+#else
+#define ARRAY_N_USB_CHANNELS    ARRAY_N_MICS
+#endif
+
+#endif // ARRAY_CONFIG_H
@@ -0,0 +1,74 @@
+// audio_config.h — the one stream configuration: channels, sample rates, bit depths
+//
+// tusb_config.h, usb_descriptors.c and the firmware all derive from these macros.
+// Plain macros only.
+
+#ifndef AUDIO_CONFIG_H
+#define AUDIO_CONFIG_H
+
+#include "array_config.h"
+
+// ---------- Channels ----------
+#define AUDIO_N_CHANNELS            ARRAY_N_USB_CHANNELS
+
+// ---------- Sample rates (UAC2 Clock Source, host-selectable) ----------
+#define AUDIO_N_RATES               5
+#define AUDIO_SAMPLE_RATES          { 8000, 16000, 24000, 32000, 48000 }
+#define AUDIO_MAX_SAMPLE_RATE       48000
+#define AUDIO_DEFAULT_SAMPLE_RATE   48000
+
+// The mics run at their native rate; rates that divide it are decimated from it
+// (decimate.h), others re-clock the I2S bus directly.
+#define AUDIO_NATIVE_RATE           48000
+#define AUDIO_CAPTURE_RATE(rate)    (AUDIO_NATIVE_RATE % (rate) == 0 ? AUDIO_NATIVE_RATE : (rate))
+
+// ---------- Bit depths (one AS alternate setting each; alt 0 = zero bandwidth) ----------
+// Async source: up to one frame more than nominal per 1 ms packet
+#define AUDIO_EP_SIZE(bytes)        ((AUDIO_MAX_SAMPLE_RATE / 1000 + 1) * AUDIO_N_CHANNELS * (bytes))
+
+// A Full-Speed iso packet is at most 1023 bytes: a depth whose packet does not fit gets
+// no alt setting (wide TDM arrays) and is only streamed over vendor bulk (vstream.h).
+#define AUDIO_ISO_MAX_PACKET        1023
+#define AUDIO_ALT_16BIT             1
+#define AUDIO_ALT_24BIT             2
+#if AUDIO_EP_SIZE(3) <= AUDIO_ISO_MAX_PACKET
+#define AUDIO_N_ALTS                2
+#define AUDIO_ISO_MAX_SAMPLE_BYTES  3
+#elif AUDIO_EP_SIZE(2) <= AUDIO_ISO_MAX_PACKET
+#define AUDIO_N_ALTS                1
+#define AUDIO_ISO_MAX_SAMPLE_BYTES  2
+#else
+#define AUDIO_N_ALTS                0
+#define AUDIO_ISO_MAX_SAMPLE_BYTES  2   // sizes TinyUSB's buffers; no alt ever opens the endpoint
+#endif
+#define AUDIO_ALT_BYTES(alt)        ((alt) == AUDIO_ALT_16BIT ? 2 : 3)
+#define AUDIO_MAX_SAMPLE_BYTES      3   // either stream
+
+// ---------- UAC2 topology: Clock Source -> Input Terminal (mics) -> Output Terminal (USB) ----------
+#define AUDIO_ITF_AC                0
+#define AUDIO_ITF_AS                1
+#define AUDIO_ENTITY_CLOCK          0x01
+#define AUDIO_ENTITY_IT             0x02
+#define AUDIO_ENTITY_OT             0x04
+
+// ---------- Descriptor lengths (usb_descriptors.c) ----------
+#define AUDIO_DESC_LEN_IAD          8
+#define AUDIO_DESC_LEN_ITF          9
+#define AUDIO_DESC_LEN_AC_HEADER    9
+#define AUDIO_DESC_LEN_CLK_SRC      8
+#define AUDIO_DESC_LEN_IT           17
+#define AUDIO_DESC_LEN_OT           12
+#define AUDIO_DESC_LEN_AS_GENERAL   16
+#define AUDIO_DESC_LEN_FORMAT       6
+#define AUDIO_DESC_LEN_EP           7
+#define AUDIO_DESC_LEN_CS_EP        8
+
+#define AUDIO_DESC_LEN_AC_CS        (AUDIO_DESC_LEN_AC_HEADER + AUDIO_DESC_LEN_CLK_SRC + \
+                                     AUDIO_DESC_LEN_IT + AUDIO_DESC_LEN_OT)
+#define AUDIO_DESC_LEN_ALT          (AUDIO_DESC_LEN_ITF + AUDIO_DESC_LEN_AS_GENERAL + AUDIO_DESC_LEN_FORMAT + \
+                                     AUDIO_DESC_LEN_EP + AUDIO_DESC_LEN_CS_EP)
+// Whole audio function, IAD included (TinyUSB parses this much)
+#define AUDIO_FUNC_DESC_LEN         (AUDIO_DESC_LEN_IAD + AUDIO_DESC_LEN_ITF + AUDIO_DESC_LEN_AC_CS + \
+                                     AUDIO_DESC_LEN_ITF + AUDIO_N_ALTS * AUDIO_DESC_LEN_ALT)
+
+#endif // AUDIO_CONFIG_H
@@ -0,0 +1,198 @@
+// audio_ctrl.c — UAC2 class requests: Clock Source sample rate and AS alt setting
+//
+// The host picks the rate on the Clock Source (SET CUR) and the bit depth with the
+// AS alternate setting. Either one stops the pipeline, re-clocks the PIO and re-sizes
+// the DMA slots (capture_set_rate), resets the drift tracker and restarts the stages
+// with the new packet format. Rates that divide the mics' native rate keep the bus at
+// that rate and are decimated in the pipeline. All of this runs on core0 from tud_task().
+//
+// The vendor bulk stream (vstream.c) goes through the same reconfiguration with the
+// pipeline's lossless output; it and the iso stream exclude each other.
+
+#include "audio_ctrl.h"
+#include "audio_config.h"
+#include "capture.h"
+#include "pipeline.h"
+#include "detect.h"
+#include "tusb.h"
+
+// ---------- Globals ----------
+static const uint32_t rates[AUDIO_N_RATES] = AUDIO_SAMPLE_RATES;
+
+static drift_t  *ctrl_drift;
+static uint32_t  cur_rate  = AUDIO_DEFAULT_SAMPLE_RATE;
+static uint32_t  cur_bytes = AUDIO_MAX_SAMPLE_BYTES;
+static uint32_t  cur_output = PIPELINE_OUT_PCM;
+static bool      cur_detect;
+static bool      running;
+static bool      iso_active;        // an AS alt setting > 0 is selected
+
+// GET RANGE reply for the sample frequency: one discrete rate per subrange
+typedef struct TU_ATTR_PACKED {
+    uint16_t n_subranges;
+    struct TU_ATTR_PACKED { uint32_t min, max, res; } sub[AUDIO_N_RATES];
+} freq_range_t;
+
+// ---------- Reconfigure ----------
+static void apply_format(bool start)
+{
+    // Drift and packet sizing work on capture frames, decimated or not
+    uint32_t capture_rate = AUDIO_CAPTURE_RATE(cur_rate);
+    pipeline_stop();
+    capture_set_rate(capture_rate);
+    drift_init(ctrl_drift, capture_rate);
+    pipeline_set_format(capture_rate, cur_rate, cur_bytes);
+    pipeline_set_output(cur_output);
+    pipeline_set_detect(cur_detect);
+    if (start) pipeline_start(ctrl_drift);
+    running = start;
+}
+
+static bool rate_supported(uint32_t rate)
+{
+    for (uint32_t i = 0; i < AUDIO_N_RATES; i++)
+        if (rates[i] == rate) return true;
+    return false;
+}
+
+void audio_ctrl_init(drift_t *drift)
+{
+    ctrl_drift = drift;
+    pipeline_start(drift);
+    running = true;
+}
+
+uint32_t audio_ctrl_sample_rate(void)
+{
+    return cur_rate;
+}
+
+uint32_t audio_ctrl_sample_bytes(void)
+{
+    return cur_bytes;
+}
+
+// ---------- Vendor bulk stream ----------
+// Event mode: a rate the detector takes, and a pre-trigger ring that covers the format
+static bool detect_format_ok(uint32_t rate, uint32_t sample_bytes, bool stamped)
+{
+    return detect_factor(rate) && pipeline_detect_fits(rate, sample_bytes, stamped);
+}
+
+bool audio_ctrl_bulk_start(uint32_t sample_bytes, bool stamped, bool detect)
+{
+    if (sample_bytes < 2 || sample_bytes > AUDIO_MAX_SAMPLE_BYTES) return false;
+    if (iso_active) return false;
+    if (detect && !detect_format_ok(cur_rate, sample_bytes, stamped)) return false;
+
+    cur_bytes  = sample_bytes;
+    cur_output = stamped ? PIPELINE_OUT_STAMPED : PIPELINE_OUT_LOSSLESS;
+    cur_detect = detect;
+    apply_format(true);
+    return true;
+}
+
+void audio_ctrl_bulk_stop(void)
+{
+    if (cur_output == PIPELINE_OUT_PCM) return;
+    pipeline_stop();
+    running = false;
+    cur_output = PIPELINE_OUT_PCM;
+    cur_detect = false;
+}
+
+bool audio_ctrl_bulk_running(void)
+{
+    return running && cur_output != PIPELINE_OUT_PCM;
+}
+
+// ---------- TinyUSB audio class callbacks ----------
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    uint8_t entity = TU_U16_HIGH(p_request->wIndex);
+    uint8_t ctrl   = TU_U16_HIGH(p_request->wValue);
+
+    // Only the Clock Source has controls; everything else stalls
+    if (entity != AUDIO_ENTITY_CLOCK) return false;
+
+    if (ctrl == AUDIO_CS_CTRL_SAM_FREQ)
+    {
+        if (p_request->bRequest == AUDIO_CS_REQ_CUR)
+        {
+            uint32_t freq = cur_rate;
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &freq, sizeof(freq));
+        }
+        if (p_request->bRequest == AUDIO_CS_REQ_RANGE)
+        {
+            freq_range_t r = { .n_subranges = AUDIO_N_RATES };
+            for (uint32_t i = 0; i < AUDIO_N_RATES; i++)
+            {
+                r.sub[i].min = rates[i];
+                r.sub[i].max = rates[i];
+                r.sub[i].res = 0;
+            }
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &r, sizeof(r));
+        }
+    }
+    else if (ctrl == AUDIO_CS_CTRL_CLK_VALID && p_request->bRequest == AUDIO_CS_REQ_CUR)
+    {
+        uint8_t valid = 1;          // internal clock, always locked
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &valid, sizeof(valid));
+    }
+    return false;
+}
+
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf)
+{
+    (void)rhport;
+    uint8_t entity = TU_U16_HIGH(p_request->wIndex);
+    uint8_t ctrl   = TU_U16_HIGH(p_request->wValue);
+
+    if (entity != AUDIO_ENTITY_CLOCK || ctrl != AUDIO_CS_CTRL_SAM_FREQ ||
+        p_request->bRequest != AUDIO_CS_REQ_CUR || p_request->wLength != 4)
+        return false;
+
+    uint32_t rate = (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+    if (!rate_supported(rate)) return false;
+    if (cur_detect && !detect_format_ok(rate, cur_bytes, cur_output == PIPELINE_OUT_STAMPED))
+        return false;                                           // event mode keeps running
+    if (rate != cur_rate)
+    {
+        cur_rate = rate;
+        apply_format(running);
+    }
+    return true;
+}
+
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    uint8_t itf = TU_U16_LOW(p_request->wIndex);
+    uint8_t alt = TU_U16_LOW(p_request->wValue);
+
+    if (itf != AUDIO_ITF_AS || alt == 0 || alt > AUDIO_N_ALTS) return true;
+
+    // Restart on the new alt even at the same depth: the ring starts over empty.
+    // This also ends a bulk stream.
+    cur_bytes  = AUDIO_ALT_BYTES(alt);
+    cur_output = PIPELINE_OUT_PCM;
+    cur_detect = false;
+    iso_active = true;
+    apply_format(true);
+    return true;
+}
+
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    if (TU_U16_LOW(p_request->wIndex) != AUDIO_ITF_AS) return true;
+
+    // Alt 0 on the AS interface leaves a bulk stream alone
+    iso_active = false;
+    if (running && cur_output == PIPELINE_OUT_PCM)
+    {
+        pipeline_stop();
+        running = false;
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+// audio_ctrl.h — UAC2 class requests: Clock Source sample rate and AS alt setting
+
+#ifndef AUDIO_CTRL_H
+#define AUDIO_CTRL_H
+
+#include <stdint.h>
+#include "drift.h"
+
+// Starts the pipeline at AUDIO_DEFAULT_SAMPLE_RATE / widest alt. Call after capture_start().
+// From then on host requests reconfigure capture, drift and pipeline (core0, tud_task).
+void audio_ctrl_init(drift_t *drift);
+
+uint32_t audio_ctrl_sample_rate(void);
+uint32_t audio_ctrl_sample_bytes(void);
+
+// Vendor bulk stream (vstream.c): restarts the pipeline with lossless output at
+// sample_bytes (2 or 3) and the current Clock Source rate, SOF-stamped if asked, in
+// event mode if asked (pipeline_set_detect()). Fails while the host has an audio alt
+// setting selected, or for event mode at a rate the detector does not take or a format
+// the pre-trigger ring cannot cover (pipeline_detect_fits(); the Clock Source then refuses
+// such rates until the stream stops); selecting an alt setting later ends the bulk stream.
+bool audio_ctrl_bulk_start(uint32_t sample_bytes, bool stamped, bool detect);
+void audio_ctrl_bulk_stop(void);
+bool audio_ctrl_bulk_running(void);
+
+#endif // AUDIO_CTRL_H
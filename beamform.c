@@ -0,0 +1,204 @@
+// beamform.c — fixed-point delay-and-sum beamformer
+
+#include "beamform.h"
+#include <stdbool.h>
+#include <string.h>
+
+// sin(0..90 deg), Q14
+static const int16_t sin_q14[91] = {
+        0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,
+     2845,  3126,  3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,
+     5604,  5872,  6138,  6402,  6664,  6924,  7182,  7438,  7692,  7943,
+     8192,  8438,  8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384,
+};
+
+static int32_t isin(int32_t deg)
+{
+    deg %= 360;
+    if (deg < 0) deg += 360;
+    if (deg <= 90)  return  sin_q14[deg];
+    if (deg <= 180) return  sin_q14[180 - deg];
+    if (deg <= 270) return -sin_q14[deg - 180];
+    return -sin_q14[360 - deg];
+}
+
+static inline int32_t icos(int32_t deg)
+{
+    return isin(deg + 90);
+}
+
+// Signed division rounding half away from zero
+static int64_t div_round(int64_t num, int64_t den)
+{
+    if (den < 0) { num = -num; den = -den; }
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+void beam_lagrange(uint32_t phase, int16_t h[BEAM_TAPS])
+{
+    // d = 1 + phase / P; with D = d * P every factor (d - j) = (D - j * P) / P.
+    // h_k = prod_{j != k} (d - j) / (k - j), denominators -6, 2, -2, 6.
+    const int32_t P = BEAM_FRAC_STEPS;
+    const int32_t D = P + (int32_t)phase;
+    const int32_t den[BEAM_TAPS] = { -6, 2, -2, 6 };
+
+    for (int32_t k = 0; k < BEAM_TAPS; k++)
+    {
+        int64_t num = 1;
+        for (int32_t j = 0; j < BEAM_TAPS; j++)
+            if (j != k) num *= D - j * P;
+        h[k] = (int16_t)div_round(num << BEAM_COEF_Q, (int64_t)den[k] * P * P * P);
+    }
+}
+
+int32_t beam_mic_advance(const beam_mic_t *mic, const beam_dir_t *dir, uint32_t sample_rate)
+{
+    // Unit look vector, Q14
+    int32_t ce = icos(dir->el_deg);
+    int32_t ux = (ce * icos(dir->az_deg)) >> 14;
+    int32_t uy = (ce * isin(dir->az_deg)) >> 14;
+    int32_t uz = isin(dir->el_deg);
+
+    int64_t dot = (int64_t)mic->x * ux + (int64_t)mic->y * uy + (int64_t)mic->z * uz;
+    return (int32_t)div_round(dot * sample_rate * BEAM_FRAC_STEPS,
+                              (int64_t)BEAM_SOUND_SPEED << 14);
+}
+
+int beam_init(beamformer_t *bf, const beam_mic_t *mics, uint32_t n_mics,
+              const beam_dir_t *dirs, uint32_t n_beams, uint32_t sample_rate)
+{
+    if (n_mics > BEAM_MAX_MICS || n_beams > BEAM_MAX_BEAMS) return -1;
+
+    memset(bf, 0, sizeof(*bf));
+    bf->n_mics   = n_mics;
+    bf->n_beams  = n_beams;
+    bf->norm_q16 = (int32_t)(65536 / n_mics);
+
+    for (uint32_t p = 0; p < BEAM_FRAC_STEPS; p++)
+        beam_lagrange(p, bf->frac_coef[p]);
+
+    for (uint32_t b = 0; b < n_beams; b++)
+    {
+        int32_t adv[BEAM_MAX_MICS];
+        int32_t min_adv = INT32_MAX;
+        for (uint32_t m = 0; m < n_mics; m++)
+        {
+            adv[m] = beam_mic_advance(&mics[m], &dirs[b], sample_rate);
+            if (adv[m] < min_adv) min_adv = adv[m];
+        }
+
+        // Delay each mic by how much earlier it hears the look direction
+        for (uint32_t m = 0; m < n_mics; m++)
+        {
+            uint32_t q = (uint32_t)(adv[m] - min_adv);
+            uint32_t lag = q >> BEAM_FRAC_BITS;
+            if (lag + BEAM_TAPS - 1 > BEAM_HIST) return -1;
+            bf->steer[b][m].lag = (uint16_t)lag;
+            bf->steer[b][m].h   = bf->frac_coef[q & (BEAM_FRAC_STEPS - 1)];
+        }
+    }
+    return 0;
+}
+
+static inline int32_t sat_q31(int64_t v)
+{
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+// h[0] * x[0] + h[1] * x[-1] + h[2] * x[-2] + h[3] * x[-3]
+static inline int32_t frac_c(const int16_t *x, const int16_t *h)
+{
+    return h[0] * x[0] + h[1] * x[-1] + h[2] * x[-2] + h[3] * x[-3];
+}
+
+// The words at x - 1 and x - 3 hold the samples oldest first, the taps run newest
+// first: SMLADX crosses the halves. x is only halfword-aligned, which the M33 takes.
+static inline int32_t frac_dsp(const int16_t *x, const int16_t *h)
+{
+    uint32_t x10, x32, h01, h23;
+    memcpy(&x10, &x[-1], sizeof(x10));
+    memcpy(&x32, &x[-3], sizeof(x32));
+    memcpy(&h01, &h[0], sizeof(h01));
+    memcpy(&h23, &h[2], sizeof(h23));
+    return dsp_smladx(x32, h23, dsp_smladx(x10, h01, 0));
+}
+
+// (hi * 2^8 + lo) >> BEAM_COEF_Q, the 24-bit FIR from its two halves. hi * 2^8 would
+// overflow 32 bits, so the part of hi below the shift is folded into lo first.
+static inline int32_t frac_join(int32_t hi, int32_t lo)
+{
+    const int32_t s = BEAM_COEF_Q - 8;
+    return (hi >> s) + ((((hi & ((1 << s) - 1)) << 8) + lo) >> BEAM_COEF_Q);
+}
+
+static inline __attribute__((always_inline))
+void beam_run(beamformer_t *bf, const int32_t *in, uint32_t in_stride,
+              int32_t *out, uint32_t out_stride, uint32_t out_offset, uint32_t n_frames, bool dsp)
+{
+    while (n_frames)
+    {
+        uint32_t n = n_frames < BEAM_MAX_BLOCK ? n_frames : BEAM_MAX_BLOCK;
+
+        // Deinterleave the block behind each mic's history, 24 bits split 16 + 8
+        for (uint32_t m = 0; m < bf->n_mics; m++)
+        {
+            int16_t *hi = &bf->lin_hi[m][BEAM_HIST];
+            int16_t *lo = &bf->lin_lo[m][BEAM_HIST];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                int32_t v = in[i * in_stride + m];
+                hi[i] = (int16_t)(v >> 16);
+                lo[i] = (int16_t)((v >> 8) & 0xFF);
+            }
+        }
+
+        for (uint32_t b = 0; b < bf->n_beams; b++)
+        {
+            const beam_steer_t *st = bf->steer[b];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                int32_t sum = 0;
+                for (uint32_t m = 0; m < bf->n_mics; m++)
+                {
+                    uint32_t j = BEAM_HIST + i - st[m].lag;
+                    const int16_t *hi = &bf->lin_hi[m][j], *lo = &bf->lin_lo[m][j];
+                    sum += dsp ? frac_join(frac_dsp(hi, st[m].h), frac_dsp(lo, st[m].h))
+                               : frac_join(frac_c(hi, st[m].h), frac_c(lo, st[m].h));
+                }
+                // sum is Q23, norm Q16
+                out[i * out_stride + out_offset + b] = sat_q31(((int64_t)sum * bf->norm_q16) >> 8);
+            }
+        }
+
+        // Keep the newest BEAM_HIST samples as history
+        for (uint32_t m = 0; m < bf->n_mics; m++)
+        {
+            memmove(bf->lin_hi[m], &bf->lin_hi[m][n], BEAM_HIST * sizeof(int16_t));
+            memmove(bf->lin_lo[m], &bf->lin_lo[m][n], BEAM_HIST * sizeof(int16_t));
+        }
+
+        in  += n * in_stride;
+        out += n * out_stride;
+        n_frames -= n;
+    }
+}
+
+void beam_process_c(beamformer_t *bf, const int32_t *in, uint32_t in_stride,
+                    int32_t *out, uint32_t out_stride, uint32_t out_offset, uint32_t n_frames)
+{
+    beam_run(bf, in, in_stride, out, out_stride, out_offset, n_frames, false);
+}
+
+void beam_process_dsp(beamformer_t *bf, const int32_t *in, uint32_t in_stride,
+                      int32_t *out, uint32_t out_stride, uint32_t out_offset, uint32_t n_frames)
+{
+    beam_run(bf, in, in_stride, out, out_stride, out_offset, n_frames, true);
+}
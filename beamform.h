@@ -0,0 +1,71 @@
+// beamform.h — fixed-point delay-and-sum beamformer (no SDK dependencies)
+//
+// Each beam delays every mic by its steering delay (integer part + 4-tap Lagrange
+// fractional FIR) and averages. The steering table is built once by beam_init();
+// beam_process() then only does table lookups and MACs. All arithmetic is integer,
+// so the host build reproduces the device output bit for bit.
+
+#ifndef BEAMFORM_H
+#define BEAMFORM_H
+
+#include <stdint.h>
+#include "dsp.h"
+
+#define BEAM_MAX_MICS           16
+#define BEAM_MAX_BEAMS          8
+#define BEAM_MAX_BLOCK          64          // frames per beam_process() call
+#define BEAM_FRAC_BITS          5           // fractional delay resolution: 1/32 sample
+#define BEAM_FRAC_STEPS         (1 << BEAM_FRAC_BITS)
+#define BEAM_TAPS               4
+#define BEAM_COEF_Q             14
+#define BEAM_HIST               32          // history per mic: max delay + taps must fit
+#define BEAM_SOUND_SPEED        3430000     // 0.1 mm/s (343 m/s)
+
+typedef struct { int16_t x, y, z; } beam_mic_t;            // 0.1 mm
+typedef struct { int16_t az_deg, el_deg; } beam_dir_t;
+
+typedef struct {
+    const int16_t *h;       // BEAM_TAPS Lagrange taps, Q14
+    uint16_t       lag;     // integer lag of tap 0
+} beam_steer_t;
+
+typedef struct {
+    uint32_t     n_mics;
+    uint32_t     n_beams;
+    int32_t      norm_q16;                                  // 1 / n_mics, Q16
+    int16_t      frac_coef[BEAM_FRAC_STEPS][BEAM_TAPS];
+    beam_steer_t steer[BEAM_MAX_BEAMS][BEAM_MAX_MICS];
+    // History + current block, 24-bit samples split into a signed top 16 bits (lin_hi)
+    // and the low 8 bits (lin_lo, 0..255) so each half is a 16 x 16 MAC
+    int16_t      lin_hi[BEAM_MAX_MICS][BEAM_HIST + BEAM_MAX_BLOCK];
+    int16_t      lin_lo[BEAM_MAX_MICS][BEAM_HIST + BEAM_MAX_BLOCK];
+} beamformer_t;
+
+// Exact Q14 Lagrange taps for a delay of 1 + phase / BEAM_FRAC_STEPS samples.
+void beam_lagrange(uint32_t phase, int16_t h[BEAM_TAPS]);
+
+// Steering delay of one mic in 1/BEAM_FRAC_STEPS samples, relative to the array origin
+// (larger = the wavefront from dir reaches this mic earlier).
+int32_t beam_mic_advance(const beam_mic_t *mic, const beam_dir_t *dir, uint32_t sample_rate);
+
+// Builds the steering table. Returns 0, or -1 if the aperture needs more than BEAM_HIST.
+int beam_init(beamformer_t *bf, const beam_mic_t *mics, uint32_t n_mics,
+              const beam_dir_t *dirs, uint32_t n_beams, uint32_t sample_rate);
+
+// in: n_frames x in_stride interleaved Q31 (mics in the first n_mics channels), filtered
+// at 24 bits (the capture depth; lower bits are dropped).
+// out: beam b of frame f goes to out[f * out_stride + out_offset + b], Q31.
+// _c and _dsp (four SMLADX per mic) give the same output; the plain name is the one
+// DSP_KERNELS selects (dsp.h).
+void beam_process_c(beamformer_t *bf, const int32_t *in, uint32_t in_stride,
+                    int32_t *out, uint32_t out_stride, uint32_t out_offset, uint32_t n_frames);
+void beam_process_dsp(beamformer_t *bf, const int32_t *in, uint32_t in_stride,
+                      int32_t *out, uint32_t out_stride, uint32_t out_offset, uint32_t n_frames);
+
+#if DSP_KERNELS
+#define beam_process            beam_process_dsp
+#else
+#define beam_process            beam_process_c
+#endif
+
+#endif // BEAMFORM_H
@@ -0,0 +1,337 @@
+// capture.c — PIO I2S / TDM RX -> DMA capture ring (no IRQs on the hot path)
+//
+// Two chained DMA channels keep the ring running on their own:
+//   data: PIO RX FIFO -> ring slot, one packet of words at the current rate, chains to ctrl
+//   ctrl: slot_addr[] -> data.al2_write_addr_trig, 1 word, read ring over the table
+// ctrl re-arms data with the next slot address, so nothing runs per packet on the CPU.
+// The producer position is read back from the data channel's write pointer; slots are
+// contiguous, so the ring can be consumed frame by frame. A rate change stops both
+// channels and re-arms them with the slot size for the new rate. The bus program
+// (capture_config.h) only changes the PIO setup, the frame size and the unpack kernel.
+
+#include "capture.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#include "tdm_rx.pio.h"
+#else
+#include "i2s_rx3.pio.h"
+#endif
+
+#define SLOT_ADDR_TABLE_BYTES   (CAPTURE_RING_PACKETS * sizeof(uint32_t))
+
+// ---------- Globals ----------
+static uint32_t ring[CAPTURE_RING_PACKETS * CAPTURE_MAX_WORDS_PER_PACKET];
+static uint32_t slot_addr[CAPTURE_RING_PACKETS] __attribute__((aligned(SLOT_ADDR_TABLE_BYTES)));
+static uint     dma_data_chan;
+static uint     dma_ctrl_chan;
+static PIO      cap_pio;
+static uint     cap_sm;
+static uint     cap_offset;
+static uint32_t frames_pp;              // frames per slot at the current rate
+static uint32_t ring_frames;            // CAPTURE_RING_PACKETS * frames_pp
+static uint32_t cons_frame;             // consumer index (frames), owned by the consumer only
+static uint32_t cons_total;             // monotonic consumer count, owned by the consumer only
+static volatile uint32_t total_frames;  // monotonic producer count, see capture_frames_total()
+static uint32_t total_last;             // producer frame index at the last poll
+
+volatile capture_stats_t capture_stats;
+
+// ---------- Bus program: i2s_rx3 or tdm_rx ----------
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#define BUS_N_LINES             TDM_N_LINES
+#define BUS_PUSH_BITS           32                  // 32 / TDM_N_LINES BCLKs per word
+#define BUS_ENTRY_POINT         tdm_rx_offset_entry_point
+#define bus_get_default_config  tdm_rx_program_get_default_config
+
+static const uint8_t      tdm_map[CAPTURE_N_CHANNELS] = TDM_CHANNEL_MAP;
+static const tdm_layout_t tdm_layout = {
+    TDM_N_SLOTS, TDM_SLOT_BITS, TDM_DATA_BITS, TDM_N_LINES, CAPTURE_N_CHANNELS, tdm_map,
+};
+static uint16_t tdm_code[sizeof(tdm_rx_program_instructions) / sizeof(uint16_t)];
+
+// tdm_rx is assembled for one line: widen its `in pins, 1` to TDM_N_LINES bits
+static uint bus_add_program(PIO pio)
+{
+    pio_program_t prog = tdm_rx_program;
+    for (uint i = 0; i < prog.length; i++)
+    {
+        uint16_t op = prog.instructions[i];
+        tdm_code[i] = (op & 0xE000u) == 0x4000u ? (uint16_t)((op & ~0x1Fu) | TDM_N_LINES) : op;
+    }
+    prog.instructions = tdm_code;
+    return pio_add_program(pio, &prog);
+}
+
+// Entry point with X = Y = BCLKs per frame - 3, built 5 bits at a time in the ISR
+static void bus_rewind(PIO pio, uint sm, uint offset)
+{
+    uint n = TDM_BCLKS_PER_FRAME - 3;
+    pio_sm_exec(pio, sm, pio_encode_set(pio_x, n >> 5));
+    pio_sm_exec(pio, sm, pio_encode_in(pio_x, 5));
+    pio_sm_exec(pio, sm, pio_encode_set(pio_x, n & 31));
+    pio_sm_exec(pio, sm, pio_encode_in(pio_x, 5));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_y, pio_isr));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_x, pio_isr));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_isr, pio_null));
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset + BUS_ENTRY_POINT));
+}
+
+static inline void bus_unpack(const uint32_t *raw, int32_t *out, uint32_t n_frames)
+{
+    tdm_unpack(&tdm_layout, raw, out, n_frames);
+}
+#else
+#define BUS_N_LINES             I2S3_N_LINES
+#define BUS_PUSH_BITS           (8 * I2S3_N_LINES)  // 8 BCLKs per word
+#define BUS_ENTRY_POINT         i2s_rx3_offset_entry_point
+#define bus_get_default_config  i2s_rx3_program_get_default_config
+
+static uint bus_add_program(PIO pio)
+{
+    return pio_add_program(pio, &i2s_rx3_program);
+}
+
+// Last instruction of the right slot with the left bit counter loaded
+static void bus_rewind(PIO pio, uint sm, uint offset)
+{
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset + BUS_ENTRY_POINT));
+    pio_sm_exec(pio, sm, pio_encode_set(pio_x, 29));
+}
+
+static inline void bus_unpack(const uint32_t *raw, int32_t *out, uint32_t n_frames)
+{
+    i2s3_unpack(raw, out, n_frames);
+}
+#endif
+
+// ---------- PIO init helper ----------
+// 2 instr per BCLK: i2s_rx3 has 64 BCLKs per frame (f_sm = 128 * fs), tdm_rx slots x slot bits
+static float sm_clkdiv(uint32_t sample_rate)
+{
+    return (float)clock_get_hz(clk_sys) / ((float)CAPTURE_SM_CYCLES_PER_FRAME * (float)sample_rate);
+}
+
+static void bus_program_init(PIO pio, uint sm, uint offset,
+                             uint pin_sd0, uint pin_ws,
+                             uint32_t sample_rate)
+{
+    // WS/FSYNC + BCLK are consecutive side-set outputs; the data lines are consecutive inputs
+    pio_gpio_init(pio, pin_ws);
+    pio_gpio_init(pio, pin_ws + 1);
+    for (uint i = 0; i < BUS_N_LINES; i++)
+        pio_gpio_init(pio, pin_sd0 + i);
+
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_ws,  2, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, pin_sd0, BUS_N_LINES, false);
+
+    pio_sm_config c = bus_get_default_config(offset);
+    sm_config_set_sideset_pins(&c, pin_ws);
+    sm_config_set_in_pins(&c, pin_sd0);
+
+    // Shift left (MSB first), autopush whole BCLKs of all lines
+    sm_config_set_in_shift(&c, false /*left*/, true /*autopush*/, BUS_PUSH_BITS);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&c, sm_clkdiv(sample_rate));
+
+    pio_sm_init(pio, sm, offset + BUS_ENTRY_POINT, &c);
+    bus_rewind(pio, sm, offset);
+}
+
+// ---------- DMA ring ----------
+static void dma_ring_init(PIO pio, uint sm)
+{
+    dma_data_chan = (uint)dma_claim_unused_channel(true);
+    dma_ctrl_chan = (uint)dma_claim_unused_channel(true);
+
+    // data: FIFO -> slot, then hand over to ctrl
+    dma_channel_config c = dma_channel_get_default_config(dma_data_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);       // PIO RX FIFO is 32-bit
+    channel_config_set_read_increment(&c, false);                  // read from fixed FIFO address
+    channel_config_set_write_increment(&c, true);                  // write linear slot
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));     // PIO RX DREQ
+    channel_config_set_chain_to(&c, dma_ctrl_chan);
+    dma_channel_configure(dma_data_chan, &c,
+                          ring, &pio->rxf[sm],
+                          0,                                       // set per rate by dma_ring_arm()
+                          false);
+
+    // ctrl: next slot address -> data write pointer (+ trigger); wraps over slot_addr[]
+    dma_channel_config k = dma_channel_get_default_config(dma_ctrl_chan);
+    channel_config_set_transfer_data_size(&k, DMA_SIZE_32);
+    channel_config_set_read_increment(&k, true);
+    channel_config_set_write_increment(&k, false);
+    channel_config_set_ring(&k, false /*read*/, __builtin_ctz(SLOT_ADDR_TABLE_BYTES));
+    dma_channel_configure(dma_ctrl_chan, &k,
+                          &dma_hw->ch[dma_data_chan].al2_write_addr_trig,
+                          &slot_addr[1],
+                          1,
+                          false);
+}
+
+// Lays the slots out for the current rate and starts the data channel on slot 0.
+static void dma_ring_arm(void)
+{
+    uint32_t words_pp = frames_pp * CAPTURE_WORDS_PER_FRAME;
+    for (uint i = 0; i < CAPTURE_RING_PACKETS; i++)
+        slot_addr[i] = (uint32_t)(uintptr_t)&ring[i * words_pp];
+
+    dma_channel_set_read_addr(dma_ctrl_chan, &slot_addr[1], false);    // slot 0 is armed by hand
+    dma_channel_set_trans_count(dma_data_chan, words_pp, false);       // reloaded on every re-trigger
+    dma_channel_set_write_addr(dma_data_chan, ring, false);
+
+    cons_frame = 0;
+    cons_total = total_frames;
+    total_last = 0;
+    dma_channel_start(dma_data_chan);
+}
+
+static void set_geometry(uint32_t sample_rate)
+{
+    frames_pp   = sample_rate / 1000;
+    ring_frames = CAPTURE_RING_PACKETS * frames_pp;
+}
+
+// Byte offset of the data channel's write pointer into the ring
+static inline uint32_t ring_offset(void)
+{
+    return dma_hw->ch[dma_data_chan].write_addr - (uint32_t)(uintptr_t)ring;
+}
+
+// Frame the data channel is currently filling (all frames before it are complete).
+static inline uint32_t prod_frame_at(uint32_t off)
+{
+    return (off / (CAPTURE_WORDS_PER_FRAME * sizeof(uint32_t))) % ring_frames;
+}
+
+static inline uint32_t prod_frame(void)
+{
+    return prod_frame_at(ring_offset());
+}
+
+void capture_start(PIO pio, uint sm, uint pin_sd0, uint pin_ws, uint32_t sample_rate)
+{
+    cap_pio = pio;
+    cap_sm  = sm;
+    cap_offset = bus_add_program(pio);
+    bus_program_init(pio, sm, cap_offset, pin_sd0, pin_ws, sample_rate);
+
+    // DMA first so the joined FIFO never overflows on start-up
+    set_geometry(sample_rate);
+    dma_ring_init(pio, sm);
+    dma_ring_arm();
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+void capture_set_rate(uint32_t sample_rate)
+{
+    pio_sm_set_enabled(cap_pio, cap_sm, false);
+
+    // ctrl twice: aborting data may still chain into it
+    dma_channel_abort(dma_ctrl_chan);
+    dma_channel_abort(dma_data_chan);
+    dma_channel_abort(dma_ctrl_chan);
+
+    // Same program and pins, new divider; back to the entry point with the FIFO empty
+    pio_sm_clear_fifos(cap_pio, cap_sm);
+    pio_sm_restart(cap_pio, cap_sm);
+    pio_sm_set_clkdiv(cap_pio, cap_sm, sm_clkdiv(sample_rate));
+    pio_sm_clkdiv_restart(cap_pio, cap_sm);
+    bus_rewind(cap_pio, cap_sm, cap_offset);
+
+    set_geometry(sample_rate);
+    dma_ring_arm();
+    pio_sm_set_enabled(cap_pio, cap_sm, true);
+}
+
+uint32_t capture_frames_per_packet(void)
+{
+    return frames_pp;
+}
+
+uint32_t capture_target_fill(void)
+{
+    return ring_frames / 2;
+}
+
+uint32_t capture_fill(void)
+{
+    return (prod_frame() + ring_frames - cons_frame) % ring_frames;
+}
+
+static uint32_t frames_total_at(uint32_t p)
+{
+    uint32_t d = (p + ring_frames - total_last) % ring_frames;
+    capture_stats.dma_blocks += (total_last % frames_pp + d) / frames_pp;  // slot ends crossed
+    total_frames += d;
+    total_last = p;
+    return total_frames;
+}
+
+uint32_t capture_frames_total(void)
+{
+    return frames_total_at(prod_frame());
+}
+
+uint32_t capture_position(uint32_t *frac_q8)
+{
+    const uint32_t frame_bytes = CAPTURE_WORDS_PER_FRAME * sizeof(uint32_t);
+    uint32_t off = ring_offset();
+    *frac_q8 = off % frame_bytes * 256 / frame_bytes;
+    return frames_total_at(prod_frame_at(off));
+}
+
+uint32_t capture_read_position(void)
+{
+    return cons_total;
+}
+
+uint32_t capture_read(int32_t *out, uint32_t n_frames)
+{
+    uint32_t fill = capture_fill();
+    uint32_t target = ring_frames / 2;
+
+    // A consumer stalled for a whole ring sees the lapped ring as a small fill; the
+    // monotonic producer count (polled from SOF, up to a packet behind) shows the laps
+    int32_t behind = (int32_t)(total_frames - cons_total - fill);
+    if (behind + (int32_t)frames_pp >= (int32_t)ring_frames)
+    {
+        uint32_t lapped = (uint32_t)(behind + (int32_t)frames_pp) / ring_frames * ring_frames;
+        cons_total += lapped;
+        capture_stats.skipped += lapped;
+        capture_stats.overruns++;
+    }
+
+    // Keep a packet of headroom in front of the DMA; past that, skip the oldest
+    // frames back to the target fill so what we unpack cannot be overwritten.
+    if (fill + frames_pp + 1 > ring_frames - frames_pp)
+    {
+        cons_frame = (cons_frame + fill - target) % ring_frames;
+        cons_total += fill - target;
+        capture_stats.skipped += fill - target;
+        fill = target;
+        capture_stats.overruns++;
+    }
+
+    uint32_t n = n_frames;
+    if (fill < n)
+    {
+        n = fill;
+        capture_stats.underruns++;
+    }
+
+    // Split at the ring end
+    const uint32_t *base = ring;
+    uint32_t first = ring_frames - cons_frame;
+    if (first > n) first = n;
+    bus_unpack(base + cons_frame * CAPTURE_WORDS_PER_FRAME, out, first);
+    bus_unpack(base, out + first * CAPTURE_N_CHANNELS, n - first);
+    cons_frame = (cons_frame + n) % ring_frames;
+    cons_total += n;
+
+    for (uint32_t i = n * CAPTURE_N_CHANNELS; i < n_frames * CAPTURE_N_CHANNELS; i++)
+        out[i] = 0;
+
+    capture_stats.packets++;
+    return n;
+}
@@ -0,0 +1,86 @@
+// capture.h — PIO I2S / TDM RX -> DMA capture ring (no IRQs on the hot path)
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include "hardware/pio.h"
+#include "samples.h"
+#include "audio_config.h"
+
+// ---------- Bus (capture_config.h) ----------
+// Raw words per frame and PIO cycles per frame (2 per BCLK) of the selected program
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#define CAPTURE_WORDS_PER_FRAME     (TDM_BCLKS_PER_FRAME * TDM_N_LINES / 32)
+#define CAPTURE_SM_CYCLES_PER_FRAME (2 * TDM_BCLKS_PER_FRAME)
+#else
+#define CAPTURE_WORDS_PER_FRAME     I2S3_WORDS_PER_FRAME
+#define CAPTURE_SM_CYCLES_PER_FRAME 128
+#if CAPTURE_N_CHANNELS != I2S3_N_CHANNELS
+#error "capture_config.h channel count out of step with samples.h"
+#endif
+#endif
+
+// ---------- Ring geometry ----------
+// One ring slot = one USB packet (1 ms) of raw PIO words at the current rate;
+// storage is sized for AUDIO_MAX_SAMPLE_RATE.
+#define CAPTURE_MAX_FRAMES_PER_PACKET   (AUDIO_MAX_SAMPLE_RATE / 1000)
+#define CAPTURE_MAX_WORDS_PER_PACKET    (CAPTURE_MAX_FRAMES_PER_PACKET * CAPTURE_WORDS_PER_FRAME)
+
+// Ring depth in packets = capture latency knob. Power of 2 (DMA read ring on the
+// address table). One slot is always owned by the DMA, so max fill is N - 1.
+#ifndef CAPTURE_RING_PACKETS
+#define CAPTURE_RING_PACKETS        8
+#endif
+
+#if (CAPTURE_RING_PACKETS & (CAPTURE_RING_PACKETS - 1)) || CAPTURE_RING_PACKETS < 2
+#error "CAPTURE_RING_PACKETS must be a power of 2 >= 2"
+#endif
+
+// The consumer reads at frame granularity (packets vary +/- 1 frame, see drift.h).
+#define CAPTURE_MAX_READ_FRAMES     (CAPTURE_MAX_FRAMES_PER_PACKET + 1)
+
+// ---------- Counters ----------
+typedef struct {
+    uint32_t packets;       // reads served
+    uint32_t dma_blocks;    // ring slots completed (counted by capture_frames_total())
+    uint32_t overruns;      // reads that had to skip frames before the DMA lapped the consumer
+    uint32_t skipped;       // frames those reads skipped (whole ring laps included)
+    uint32_t underruns;     // reads that found fewer frames than asked for (padded with silence)
+} capture_stats_t;
+
+extern volatile capture_stats_t capture_stats;
+
+// Loads i2s_rx3 or tdm_rx (capture_config.h), claims two DMA channels (data + control
+// block) and starts capture. pin_ws is WS or FSYNC; BCLK is the next pin.
+void capture_start(PIO pio, uint sm, uint pin_sd0, uint pin_ws, uint32_t sample_rate);
+
+// Stops the SM and DMA, then restarts with the PIO divider and slot size for a new
+// rate. The ring restarts empty. The consumer must be stopped meanwhile.
+void capture_set_rate(uint32_t sample_rate);
+
+// Current geometry: frames per 1 ms slot, and the fill the consumer steers towards
+// (half the ring).
+uint32_t capture_frames_per_packet(void);
+uint32_t capture_target_fill(void);
+
+// Number of complete frames waiting in the ring.
+uint32_t capture_fill(void);
+
+// Monotonic count of captured frames (wraps at 2^32). Must be polled at least
+// once per CAPTURE_RING_PACKETS - 1 ms so ring wraps are not missed (e.g. from SOF).
+uint32_t capture_frames_total(void);
+
+// capture_frames_total() plus how far the DMA is into the next frame, in 1/256 frame
+// (word resolution), both from one read of the write pointer. Same polling rule.
+uint32_t capture_position(uint32_t *frac_q8);
+
+// capture_frames_total() index of the next frame capture_read() returns (skips included).
+uint32_t capture_read_position(void);
+
+// Unpacks the oldest n_frames (<= CAPTURE_MAX_READ_FRAMES) straight from the ring
+// into Q31 interleaved samples (CAPTURE_N_CHANNELS, TDM slots already mapped). Missing frames are zero-filled; single consumer only.
+// Returns the number of captured frames actually read.
+uint32_t capture_read(int32_t *out, uint32_t n_frames);
+
+#endif // CAPTURE_H
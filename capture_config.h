@@ -0,0 +1,68 @@
+// capture_config.h — capture bus: stereo I2S on 3 data lines, or frame-sync TDM
+//
+// Plain macros only: included from array_config.h, which takes its mic count from here.
+// Build with -DCAPTURE_BUS=CAPTURE_BUS_TDM (and the TDM_* overrides below) for TDM mics
+// or codecs; see wiring_and_bom.md for the pins.
+
+#ifndef CAPTURE_CONFIG_H
+#define CAPTURE_CONFIG_H
+
+// ---------- Bus ----------
+#define CAPTURE_BUS_I2S3            0   // pio/i2s_rx3.pio: 3 SD lines x 2 slots, 6 ICS43434 mics
+#define CAPTURE_BUS_TDM             1   // pio/tdm_rx.pio: TDM_N_LINES lines x TDM_N_SLOTS slots
+
+#ifndef CAPTURE_BUS
+#define CAPTURE_BUS                 CAPTURE_BUS_I2S3
+#endif
+
+// ---------- TDM frame (pio/tdm_rx.pio) ----------
+// FSYNC is a one-BCLK pulse ending where slot 0 starts, so the MSB of slot 0 follows
+// one BCLK after the pulse is sampled (as WS in I2S). Every data line carries the same
+// slot layout; lines share BCLK and FSYNC.
+#ifndef TDM_N_SLOTS
+#define TDM_N_SLOTS                 8   // 8 or 16 slots per frame
+#endif
+#ifndef TDM_SLOT_BITS
+#define TDM_SLOT_BITS               32  // 16, 24 or 32 BCLKs per slot
+#endif
+#ifndef TDM_DATA_BITS
+#define TDM_DATA_BITS               24  // significant bits at the top of the slot, the rest is dropped
+#endif
+#ifndef TDM_N_LINES
+#define TDM_N_LINES                 1   // 1, 2 or 4 data lines on consecutive GPIOs
+#endif
+
+#define TDM_BCLKS_PER_FRAME         (TDM_N_SLOTS * TDM_SLOT_BITS)
+#define TDM_N_BUS_CHANNELS          (TDM_N_SLOTS * TDM_N_LINES)
+
+// ---------- TDM channel map ----------
+// Capture channel c (mic c in array_config.h, USB channel c) takes bus channel
+// TDM_CHANNEL_MAP[c], where bus channel = line * TDM_N_SLOTS + slot. Entries past the
+// bus (e.g. TDM_SLOT_NONE) capture silence. Override both macros together.
+#define TDM_SLOT_NONE               0xFF
+#ifndef TDM_CHANNEL_MAP
+#define TDM_N_CHANNELS              8
+#define TDM_CHANNEL_MAP             { 0, 1, 2, 3, 4, 5, 6, 7 }
+#endif
+
+#if (TDM_N_SLOTS != 8 && TDM_N_SLOTS != 16) || \
+    (TDM_SLOT_BITS != 16 && TDM_SLOT_BITS != 24 && TDM_SLOT_BITS != 32)
+#error "TDM frame must be 8 or 16 slots of 16, 24 or 32 bits"
+#endif
+#if TDM_N_LINES != 1 && TDM_N_LINES != 2 && TDM_N_LINES != 4
+#error "TDM_N_LINES must be 1, 2 or 4 (one autopushed word holds whole BCLKs)"
+#endif
+#if TDM_DATA_BITS < 16 || TDM_DATA_BITS > TDM_SLOT_BITS
+#error "TDM_DATA_BITS must be 16 .. TDM_SLOT_BITS"
+#endif
+
+// ---------- Captured channels ----------
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#define CAPTURE_N_CHANNELS          TDM_N_CHANNELS
+#define CAPTURE_DATA_BITS           TDM_DATA_BITS
+#else
+#define CAPTURE_N_CHANNELS          6   // I2S3_N_CHANNELS (samples.h)
+#define CAPTURE_DATA_BITS           24
+#endif
+
+#endif // CAPTURE_CONFIG_H
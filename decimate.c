@@ -0,0 +1,197 @@
+// decimate.c — fixed-point polyphase FIR decimator
+
+#include "decimate.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// ---------- Compile-time coefficients ----------
+// Kaiser-windowed sinc with the cutoff at fs_out / 2 (a Nyquist(M) filter). With the
+// centre on a whole sample, sin(pi m / M) only takes the values sin(k pi / 6), so every
+// tap is a floating constant expression the compiler folds into the Q15 table; the
+// Kaiser window's I0() is its power series in (x/2)^2, which needs no sqrt.
+#define DECIM_BETA              7.5
+#define DECIM_PI                3.14159265358979323846
+#define DECIM_SQRT3_2           0.86602540378443864476
+
+// sin(i * pi / 6), i = 0..11
+#define SIN_PI6(i)  ((i) == 0 ? 0.0 : (i) == 1 ? 0.5 : (i) == 2 ? DECIM_SQRT3_2 : (i) == 3 ? 1.0 :   \
+                     (i) == 4 ? DECIM_SQRT3_2 : (i) == 5 ? 0.5 : (i) == 6 ? 0.0 : (i) == 7 ? -0.5 : \
+                     (i) == 8 ? -DECIM_SQRT3_2 : (i) == 9 ? -1.0 : (i) == 10 ? -DECIM_SQRT3_2 : -0.5)
+
+// sin(pi m / M) / (pi m) for integer m; M divides 6
+#define SINC_M(M, m)    ((m) == 0 ? 1.0 / (M) :                                                 \
+                         SIN_PI6((((m) % (2 * (M))) + 2 * (M)) % (2 * (M)) * (6 / (M))) / (DECIM_PI * (m)))
+
+// I0(x) with y = (x/2)^2: sum of y^k / (k!)^2, 20 terms
+#define I0_SERIES(y)    (1 + (y) * (1 + (y) / 4 * (1 + (y) / 9 * (1 + (y) / 16 * (1 + (y) / 25 *   \
+                        (1 + (y) / 36 * (1 + (y) / 49 * (1 + (y) / 64 * (1 + (y) / 81 *            \
+                        (1 + (y) / 100 * (1 + (y) / 121 * (1 + (y) / 144 * (1 + (y) / 169 *        \
+                        (1 + (y) / 196 * (1 + (y) / 225 * (1 + (y) / 256 * (1 + (y) / 289 *        \
+                        (1 + (y) / 324 * (1 + (y) / 361 * (1 + (y) / 400))))))))))))))))))))
+
+#define CENTRE(M)       ((M) * DECIM_TAPS_PER_PHASE / 2 - 1)
+#define KAISER_R(M, n)  (((double)(n) - CENTRE(M)) / CENTRE(M))
+#define KAISER(M, n)    (I0_SERIES(DECIM_BETA * DECIM_BETA / 4 * (1 - KAISER_R(M, n) * KAISER_R(M, n))) / \
+                         I0_SERIES(DECIM_BETA * DECIM_BETA / 4))
+
+// Round to Q15 (the offset keeps the truncating cast a floor)
+#define Q15(v)          ((int32_t)((v) * 32768.0 + 32768.5) - 32768)
+#define TAP(M, n)       Q15(SINC_M(M, (n) - CENTRE(M)) * KAISER(M, n))
+
+#define TAPS4(M, n)     TAP(M, n), TAP(M, (n) + 1), TAP(M, (n) + 2), TAP(M, (n) + 3)
+#define TAPS24(M, n)    TAPS4(M, n), TAPS4(M, (n) + 4), TAPS4(M, (n) + 8), \
+                        TAPS4(M, (n) + 12), TAPS4(M, (n) + 16), TAPS4(M, (n) + 20)
+
+// M * DECIM_TAPS_PER_PHASE entries; the last one is outside the filter and unused
+static const int16_t coefs_m2[2 * DECIM_TAPS_PER_PHASE] = {
+    TAPS24(2, 0), TAPS24(2, 24),
+};
+static const int16_t coefs_m3[3 * DECIM_TAPS_PER_PHASE] = {
+    TAPS24(3, 0), TAPS24(3, 24), TAPS24(3, 48),
+};
+static const int16_t coefs_m6[6 * DECIM_TAPS_PER_PHASE] = {
+    TAPS24(6, 0),  TAPS24(6, 24),  TAPS24(6, 48),
+    TAPS24(6, 72), TAPS24(6, 96),  TAPS24(6, 120),
+};
+
+const int16_t *decim_coefs(uint32_t factor, uint32_t *n_taps)
+{
+    *n_taps = factor * DECIM_TAPS_PER_PHASE - 1;
+    switch (factor)
+    {
+    case 2:  return coefs_m2;
+    case 3:  return coefs_m3;
+    case 6:  return coefs_m6;
+    default: return NULL;
+    }
+}
+
+int decim_init(decimator_t *d, uint32_t factor, uint32_t n_ch)
+{
+    uint32_t n_taps;
+    const int16_t *h = decim_coefs(factor, &n_taps);
+    if (!h || n_ch > DECIM_MAX_CH) return -1;
+
+    memset(d, 0, sizeof(*d));
+    d->factor = factor;
+    d->n_taps = n_taps;
+    d->n_ch   = n_ch;
+    memcpy(d->h, h, n_taps * sizeof(int16_t));
+    return 0;
+}
+
+// Output sample at 24 bits
+static inline int32_t sat_q23(int32_t v)
+{
+    if (v > (1 << 23) - 1) return (1 << 23) - 1;
+    if (v < -(1 << 23)) return -(1 << 23);
+    return v;
+}
+
+// (hi * 2^8 + lo) >> DECIM_COEF_Q: the 24-bit dot product from its two halves (the
+// rounding constant is in lo). hi * 2^8 would overflow 32 bits, so the part of hi below
+// the shift is folded into lo first.
+static inline int32_t dot_join(int32_t hi, int32_t lo)
+{
+    const int32_t s = DECIM_COEF_Q - 8;
+    return (hi >> s) + ((((hi & ((1 << s) - 1)) << 8) + lo) >> DECIM_COEF_Q);
+}
+
+// Symmetric taps: the dot product needs no time reversal. sum |h| < 1.5 in Q15, so
+// neither int32 accumulator can overflow, and the order of the adds does not matter.
+static inline int32_t dot_c(const int16_t *xh, const int16_t *xl, const int16_t *h, uint32_t n_taps)
+{
+    int32_t hi = 0, lo = 1 << (DECIM_COEF_Q - 1);
+    for (uint32_t t = 0; t < n_taps; t++)
+    {
+        hi += h[t] * xh[t];
+        lo += h[t] * xl[t];
+    }
+    return dot_join(hi, lo);
+}
+
+// Two taps per SMLAD; x is only halfword-aligned, which word loads on the M33 take
+static inline int32_t dot_dsp(const int16_t *xh, const int16_t *xl, const int16_t *h, uint32_t n_taps)
+{
+    int32_t hi = 0, lo = 1 << (DECIM_COEF_Q - 1);
+    uint32_t t = 0;
+    for (; t + 2 <= n_taps; t += 2)
+    {
+        uint32_t hw, xhw, xlw;
+        memcpy(&hw, &h[t], sizeof(hw));
+        memcpy(&xhw, &xh[t], sizeof(xhw));
+        memcpy(&xlw, &xl[t], sizeof(xlw));
+        hi = dsp_smlad(xhw, hw, hi);
+        lo = dsp_smlad(xlw, hw, lo);
+    }
+    if (t < n_taps)
+    {
+        hi += h[t] * xh[t];
+        lo += h[t] * xl[t];
+    }
+    return dot_join(hi, lo);
+}
+
+static inline __attribute__((always_inline))
+uint32_t decim_run(decimator_t *d, const int32_t *in, uint32_t in_stride,
+                   int32_t *out, uint32_t out_stride, uint32_t n_frames, bool dsp)
+{
+    uint32_t n_out = 0;
+
+    while (n_frames)
+    {
+        uint32_t n = n_frames < DECIM_MAX_BLOCK ? n_frames : DECIM_MAX_BLOCK;
+
+        // Deinterleave the block behind each channel's history, 24 bits split 16 + 8
+        for (uint32_t c = 0; c < d->n_ch; c++)
+        {
+            int16_t *hi = &d->lin_hi[c][DECIM_HIST];
+            int16_t *lo = &d->lin_lo[c][DECIM_HIST];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                int32_t v = in[i * in_stride + c];
+                hi[i] = (int16_t)(v >> 16);
+                lo[i] = (int16_t)((v >> 8) & 0xFF);
+            }
+        }
+
+        uint32_t i = d->phase;
+        uint32_t k = 0;
+        for (; i < n; i += d->factor, k++)
+        {
+            for (uint32_t c = 0; c < d->n_ch; c++)
+            {
+                uint32_t j = DECIM_HIST + i + 1 - d->n_taps;
+                const int16_t *xh = &d->lin_hi[c][j], *xl = &d->lin_lo[c][j];
+                int32_t y = dsp ? dot_dsp(xh, xl, d->h, d->n_taps) : dot_c(xh, xl, d->h, d->n_taps);
+                out[(n_out + k) * out_stride + c] = sat_q23(y) * 256;
+            }
+        }
+        d->phase = i - n;
+
+        // Keep the newest DECIM_HIST samples as history
+        for (uint32_t c = 0; c < d->n_ch; c++)
+        {
+            memmove(d->lin_hi[c], &d->lin_hi[c][n], DECIM_HIST * sizeof(int16_t));
+            memmove(d->lin_lo[c], &d->lin_lo[c][n], DECIM_HIST * sizeof(int16_t));
+        }
+
+        in += n * in_stride;
+        n_out += k;
+        n_frames -= n;
+    }
+    return n_out;
+}
+
+uint32_t decim_process_c(decimator_t *d, const int32_t *in, uint32_t in_stride,
+                         int32_t *out, uint32_t out_stride, uint32_t n_frames)
+{
+    return decim_run(d, in, in_stride, out, out_stride, n_frames, false);
+}
+
+uint32_t decim_process_dsp(decimator_t *d, const int32_t *in, uint32_t in_stride,
+                           int32_t *out, uint32_t out_stride, uint32_t n_frames)
+{
+    return decim_run(d, in, in_stride, out, out_stride, n_frames, true);
+}
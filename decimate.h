@@ -0,0 +1,68 @@
+// decimate.h — fixed-point polyphase FIR decimator, 48 kHz -> 24/16/8 kHz (no SDK dependencies)
+//
+// The mics keep running at their native rate; lower USB rates are made by low-pass
+// filtering and keeping every M-th sample. Only the kept outputs are computed, so one
+// output costs M * DECIM_TAPS_PER_PHASE MACs, i.e. DECIM_TAPS_PER_PHASE per input frame
+// whatever the factor. Coefficients are compile-time constants (see decimate.c) and are
+// copied into the decimator by decim_init() so the inner loop runs from RAM.
+//
+// Samples go through the filter at 24 bits, the capture depth, so the 24-bit alt keeps
+// its resolution at the decimated rates too. Each history sample is kept as a signed
+// top 16 bits and an unsigned low 8 bits. Every tap is then two 16 x 16 MACs into 32-bit
+// accumulators, which the M0+ multiplies directly and SMLAD takes two taps at a time.
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+#include "dsp.h"
+
+#define DECIM_MAX_CH            16
+#define DECIM_MAX_BLOCK         64          // input frames per inner block
+#define DECIM_MAX_FACTOR        6
+#define DECIM_TAPS_PER_PHASE    24
+#define DECIM_MAX_TAPS          (DECIM_MAX_FACTOR * DECIM_TAPS_PER_PHASE - 1)
+#define DECIM_HIST              (DECIM_MAX_TAPS - 1)
+#define DECIM_COEF_Q            15
+
+// Response, relative to the output rate fs_out = fs_in / M:
+//   passband  0 .. 0.4 fs_out      stopband  0.6 fs_out .. fs_in / 2 (> 65 dB)
+// Aliases from 0.5..0.6 fs_out only fold into 0.4..0.5 fs_out, above the passband.
+#define DECIM_PASS_EDGE_PCT     40
+#define DECIM_STOP_EDGE_PCT     60
+
+typedef struct {
+    uint32_t factor;                                        // M
+    uint32_t n_taps;                                        // M * DECIM_TAPS_PER_PHASE - 1, odd, linear phase
+    uint32_t n_ch;
+    uint32_t phase;                                         // input frames to skip before the next output
+    int16_t  h[DECIM_MAX_TAPS];                             // Q15
+    int16_t  lin_hi[DECIM_MAX_CH][DECIM_HIST + DECIM_MAX_BLOCK];    // history + current block,
+    int16_t  lin_lo[DECIM_MAX_CH][DECIM_HIST + DECIM_MAX_BLOCK];    // sample bits 31..16 / 15..8
+} decimator_t;
+
+// Compile-time Q15 taps for factor M (2, 3 or 6), or NULL. *n_taps receives the length.
+const int16_t *decim_coefs(uint32_t factor, uint32_t *n_taps);
+
+// Returns 0, or -1 for an unsupported factor or channel count.
+int decim_init(decimator_t *d, uint32_t factor, uint32_t n_ch);
+
+// in: n_frames x in_stride interleaved Q31 (channels in the first n_ch slots); bits 7..0
+// are dropped.
+// out: one frame per M inputs, n_ch channels at out_stride, Q31 with 24 significant bits;
+// out may alias in.
+// Blocks of any size keep the phase, so packets of 47/48/49 frames are fine.
+// Returns the number of output frames written. _c and _dsp (SMLAD, two taps per
+// instruction) give the same output; the plain name is the one DSP_KERNELS selects (dsp.h).
+uint32_t decim_process_c(decimator_t *d, const int32_t *in, uint32_t in_stride,
+                         int32_t *out, uint32_t out_stride, uint32_t n_frames);
+uint32_t decim_process_dsp(decimator_t *d, const int32_t *in, uint32_t in_stride,
+                           int32_t *out, uint32_t out_stride, uint32_t n_frames);
+
+#if DSP_KERNELS
+#define decim_process           decim_process_dsp
+#else
+#define decim_process           decim_process_c
+#endif
+
+#endif // DECIMATE_H
@@ -0,0 +1,449 @@
+// detect.c — fixed-point harmonic drone detector
+
+#include "detect.h"
+#include <string.h>
+
+// sin(2 pi k / DETECT_SIN_STEPS), k = 0 .. DETECT_SIN_STEPS / 4, Q15
+static const int16_t sin_quarter[DETECT_SIN_STEPS / 4 + 1] = {
+        0,   201,   402,   603,   804,  1005,  1206,  1407,  1608,  1809,
+     2009,  2210,  2410,  2611,  2811,  3012,  3212,  3412,  3612,  3811,
+     4011,  4210,  4410,  4609,  4808,  5007,  5205,  5404,  5602,  5800,
+     5998,  6195,  6393,  6590,  6786,  6983,  7179,  7375,  7571,  7767,
+     7962,  8157,  8351,  8545,  8739,  8933,  9126,  9319,  9512,  9704,
+     9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462,
+    13645, 13828, 14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269,
+    15446, 15623, 15800, 15976, 16151, 16325, 16499, 16673, 16846, 17018,
+    17189, 17360, 17530, 17700, 17869, 18037, 18204, 18371, 18537, 18703,
+    18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000, 20159, 20317,
+    20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+    22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311,
+    23452, 23592, 23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680,
+    24811, 24942, 25072, 25201, 25329, 25456, 25582, 25708, 25832, 25955,
+    26077, 26198, 26319, 26438, 26556, 26674, 26790, 26905, 27019, 27133,
+    27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001, 28105, 28208,
+    28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+    29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037,
+    30117, 30195, 30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783,
+    30852, 30919, 30985, 31050, 31113, 31176, 31237, 31297, 31356, 31414,
+    31470, 31526, 31580, 31633, 31685, 31736, 31785, 31833, 31880, 31926,
+    31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250, 32285, 32318,
+    32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737,
+    32745, 32752, 32757, 32761, 32765, 32766, 32767,
+};
+
+#define SIN_MASK        (DETECT_SIN_STEPS - 1)
+#define COS_OFFSET      (DETECT_SIN_STEPS / 4)
+#define DB_PER_OCTAVE   771                 // 10 log10(2) = 3.0103 dB per log2 unit, Q8
+#define HZ_TO_F(hz)     ((hz) * DETECT_N * (1 << DETECT_F_Q) / DETECT_RATE)
+
+// Steps of one frame: prepare, FFT stages, comb + decision, per-mic DFTs, steering
+#define STEP_FFT        1
+#define STEP_COMB       (STEP_FFT + DETECT_LOG2_N)
+#define STEP_DFT        (STEP_COMB + 1)
+
+// log2(v) in Q8: the exponent, then the mantissa's top 8 bits (linear in between,
+// 0.09 at worst). log2(0) reads as 0.
+static int32_t log2_q8(uint32_t v)
+{
+    if (!v) return 0;
+    uint32_t e = 31 - (uint32_t)__builtin_clz(v);
+    uint32_t m = e >= 8 ? v >> (e - 8) : v << (8 - e);
+    return (int32_t)(e << 8 | (m & 0xFF));
+}
+
+static inline int32_t db_q8(int32_t log2_q8v)
+{
+    return (log2_q8v * DB_PER_OCTAVE) >> 8;
+}
+
+// Shift that brings v (> 0) to [2^b, 2^(b+1))
+static inline int32_t block_shift(uint64_t v, int32_t b)
+{
+    return b - (63 - __builtin_clzll(v));
+}
+
+static inline int32_t scale(int32_t v, int32_t sh)
+{
+    return sh >= 0 ? v * (1 << sh) : v >> -sh;
+}
+
+static inline uint32_t bit_reverse(uint32_t n)
+{
+    uint32_t r = 0;
+    for (uint32_t b = 0; b < DETECT_LOG2_N; b++, n >>= 1)
+        r = r << 1 | (n & 1);
+    return r;
+}
+
+uint32_t detect_factor(uint32_t sample_rate)
+{
+    if (sample_rate % DETECT_RATE) return 0;
+    uint32_t m = sample_rate / DETECT_RATE;
+    uint32_t n_taps;
+    return m == 1 || decim_coefs(m, &n_taps) ? m : 0;
+}
+
+int detect_init(detector_t *d, const beam_mic_t *mics, uint32_t n_mics, uint32_t sample_rate)
+{
+    uint32_t m = detect_factor(sample_rate);
+    if (!m || !n_mics || n_mics > DETECT_MAX_MICS) return -1;
+
+    memset(d, 0, sizeof(*d));
+    d->factor = m;
+    d->n_mics = n_mics;
+    d->step   = DETECT_IDLE;
+    if (m > 1 && decim_init(&d->dec, m, n_mics) != 0) return -1;
+
+    for (uint32_t k = 0; k < DETECT_SIN_STEPS; k++)
+    {
+        uint32_t q = k % (DETECT_SIN_STEPS / 2);
+        int16_t  v = sin_quarter[q <= COS_OFFSET ? q : DETECT_SIN_STEPS / 2 - q];
+        d->sin[k] = k < DETECT_SIN_STEPS / 2 ? v : (int16_t)-v;
+    }
+    for (uint32_t n = 0; n < DETECT_N; n++)
+        d->win[n] = (int16_t)((32767 - d->sin[(n * (DETECT_SIN_STEPS / DETECT_N) + COS_OFFSET) & SIN_MASK]) >> 1);
+
+    // 1/32 samples at 16x the rate = 1/512 samples at DETECT_RATE
+    for (uint32_t e = 0; e < DETECT_N_EL; e++)
+        for (uint32_t a = 0; a < DETECT_N_AZ; a++)
+        {
+            beam_dir_t dir = { (int16_t)(a * DETECT_AZ_STEP), (int16_t)(e * DETECT_EL_STEP) };
+            for (uint32_t c = 0; c < n_mics; c++)
+                d->adv[e * DETECT_N_AZ + a][c] = (int16_t)beam_mic_advance(&mics[c], &dir, DETECT_RATE * 16);
+        }
+    return 0;
+}
+
+// ---------- Steps ----------
+// Levels of the newest hop, then the mic sum scaled to 2^14 at its peak, windowed, into
+// the FFT buffer in bit-reversed order.
+static void step_prepare(detector_t *d)
+{
+    detect_features_t *f = &d->cur;
+    memset(f, 0, sizeof(*f));
+    f->n_mics = (uint8_t)d->n_mics;
+    for (uint32_t c = 0; c < d->n_mics; c++)
+    {
+        uint64_t e = 0;
+        for (uint32_t n = DETECT_N - DETECT_HOP; n < DETECT_N; n++)
+            e += (uint64_t)((int32_t)d->x[c][n] * d->x[c][n]);
+        // 0 dBFS = a full-scale square wave, 2^30 per sample
+        f->level_q8[c] = (int16_t)db_q8(log2_q8((uint32_t)(e / DETECT_HOP)) - (30 << 8));
+    }
+
+    uint32_t peak = 0;
+    for (uint32_t n = 0; n < DETECT_N; n++)
+    {
+        int32_t s = 0;
+        for (uint32_t c = 0; c < d->n_mics; c++)
+            s += d->x[c][n];
+        d->re[n] = s;
+        uint32_t a = (uint32_t)(s < 0 ? -s : s);
+        if (a > peak) peak = a;
+    }
+    d->shift = peak ? block_shift(peak, 14) : 30;
+
+    for (uint32_t n = 0; n < DETECT_N; n++)
+        d->im[bit_reverse(n)] = (scale(d->re[n], d->shift) * d->win[n]) >> 16;
+    // The sum went to im[] in bit-reversed order; it is real
+    for (uint32_t n = 0; n < DETECT_N; n++)
+    {
+        d->re[n] = d->im[n];
+        d->im[n] = 0;
+    }
+}
+
+// Radix-2 DIT stage s with 1/2 scaling: magnitudes never grow past the 2^14 input
+static void step_fft(detector_t *d, uint32_t s)
+{
+    uint32_t half = 1u << s, tw_step = DETECT_SIN_STEPS >> (s + 1);
+    for (uint32_t g = 0; g < DETECT_N; g += 2 * half)
+        for (uint32_t j = 0; j < half; j++)
+        {
+            int32_t  c = d->sin[(j * tw_step + COS_OFFSET) & SIN_MASK], sn = d->sin[j * tw_step];
+            uint32_t a = g + j, b = a + half;
+            int32_t  tr = (d->re[b] * c + d->im[b] * sn) >> 15;
+            int32_t  ti = (d->im[b] * c - d->re[b] * sn) >> 15;
+            int32_t  ar = d->re[a], ai = d->im[a];
+            d->re[a] = (ar + tr) >> 1;
+            d->im[a] = (ai + ti) >> 1;
+            d->re[b] = (ar - tr) >> 1;
+            d->im[b] = (ai - ti) >> 1;
+        }
+}
+
+// Rise over the floor at f (1/16 bins): the larger of the two bins around it
+static inline int32_t tooth(const int16_t *rise, uint32_t f)
+{
+    uint32_t k = f >> DETECT_F_Q;
+    return rise[k] > rise[k + 1] ? rise[k] : rise[k + 1];
+}
+
+// Spectrum -> floor-relative levels -> best comb -> decision. Returns false if the
+// frame needs no DOA.
+static bool step_comb(detector_t *d)
+{
+    detect_features_t *f = &d->cur;
+    int16_t rise[DETECT_BINS];
+    for (uint32_t k = 0; k < DETECT_BINS; k++)
+    {
+        uint32_t p = (uint32_t)(d->re[k] * d->re[k] + d->im[k] * d->im[k]);
+        int32_t  l = log2_q8(p) - 2 * 256 * d->shift;
+        if (!d->primed)
+            d->level[k] = d->floor[k] = (int16_t)l;
+        d->level[k] = (int16_t)(d->level[k] + ((l - d->level[k]) >> DETECT_SMOOTH));
+        int32_t r = d->level[k] - d->floor[k];
+        rise[k] = (int16_t)(r > 0 ? r : 0);
+    }
+    d->primed = true;
+
+    // Teeth at the harmonics, minus the gaps half-way between them
+    int32_t  best = INT32_MIN;
+    uint32_t best_f0 = 0;
+    for (uint32_t f0 = HZ_TO_F(DETECT_F0_MIN_HZ); f0 <= HZ_TO_F(DETECT_F0_MAX_HZ); f0 += DETECT_F0_STEP)
+    {
+        int32_t s = 0;
+        for (uint32_t h = 1; h <= DETECT_HARMONICS; h++)
+            s += tooth(rise, h * f0) - tooth(rise, h * f0 - f0 / 2);
+        if (s > best)
+        {
+            best = s;
+            best_f0 = f0;
+        }
+    }
+    f->f0_q4    = (uint16_t)((best_f0 * DETECT_RATE + DETECT_N / 2) / DETECT_N);
+    f->score_q8 = (int16_t)db_q8(best / DETECT_HARMONICS);
+    for (uint32_t h = 1; h <= DETECT_HARMONICS; h++)
+    {
+        int32_t db = db_q8(tooth(rise, h * best_f0)) >> 8;
+        f->harm_db[h - 1] = (uint8_t)(db > 255 ? 255 : db);
+    }
+
+    // Hysteresis; the floor learns only while nothing is building up or held
+    bool up = f->score_q8 >= DETECT_ON_DB * 256;
+    if (!d->active)
+    {
+        d->on_count = up ? d->on_count + 1 : 0;
+        if (d->on_count >= DETECT_ON_HOPS)
+        {
+            d->active = true;
+            d->hold = DETECT_HOLD_HOPS;
+            f->flags |= DETECT_ONSET;
+        }
+    }
+    else if (f->score_q8 >= DETECT_OFF_DB * 256)
+        d->hold = DETECT_HOLD_HOPS;
+    else if (--d->hold == 0)
+    {
+        d->active = false;
+        d->on_count = 0;
+        f->flags |= DETECT_RELEASE;
+    }
+    if (d->active) f->flags |= DETECT_ACTIVE;
+
+    if (!d->active && !d->on_count)
+        for (uint32_t k = 0; k < DETECT_BINS; k++)
+        {
+            int32_t g = d->level[k] - d->floor[k];
+            d->floor[k] = (int16_t)(d->floor[k] + (g >> (g < 0 ? DETECT_FLOOR_DOWN : DETECT_FLOOR_UP)));
+        }
+
+    // DOA harmonics below DETECT_DOA_MAX_HZ that rise enough, best first by the rise plus
+    // twice log2 of the harmonic number: the small aperture's phase differences, hence
+    // the contrast of the steered power, grow with frequency squared
+    d->n_doa = 0;
+    if (!up) return false;
+    int32_t  min_rise = DETECT_DOA_MIN_DB * 256 * 256 / DB_PER_OCTAVE;
+    int32_t  cand_r[DETECT_DOA_HARMONICS + 1];
+    uint32_t cand_f[DETECT_DOA_HARMONICS + 1], n = 0;
+    for (uint32_t h = 1; h * best_f0 <= HZ_TO_F(DETECT_DOA_MAX_HZ); h++)
+    {
+        int32_t r = tooth(rise, h * best_f0);
+        if (r < min_rise) continue;
+        r += 2 * log2_q8(h);
+        uint32_t i = n;
+        for (; i > 0 && cand_r[i - 1] < r; i--)
+        {
+            cand_r[i] = cand_r[i - 1];
+            cand_f[i] = cand_f[i - 1];
+        }
+        cand_r[i] = r;
+        cand_f[i] = h * best_f0;
+        if (n < DETECT_DOA_HARMONICS) n++;
+    }
+    memcpy(d->doa_f, cand_f, n * sizeof(uint32_t));
+    d->n_doa = n;
+    return n != 0;
+}
+
+// DFT of mic c at the DOA harmonics over the windowed frame; each harmonic's mics are
+// then scaled together so their |re| + |im| sum to at most 2^14
+static void step_dft(detector_t *d, uint32_t c)
+{
+    const int16_t *x = d->x[c];
+    for (uint32_t j = 0; j < d->n_doa; j++)
+    {
+        uint32_t fq = d->doa_f[j];
+        int32_t  re = 0, im = 0;
+        for (uint32_t n = 0; n < DETECT_N; n++)
+        {
+            int32_t  xw = (x[n] * d->win[n]) >> 15;
+            uint32_t p = (n * fq) >> (DETECT_LOG2_N + DETECT_F_Q - 10);   // 1024 steps per turn
+            re += (xw * d->sin[(p + COS_OFFSET) & SIN_MASK]) >> DETECT_LOG2_N;
+            im -= (xw * d->sin[p & SIN_MASK]) >> DETECT_LOG2_N;
+        }
+        d->xr[j][c] = re;
+        d->xi[j][c] = im;
+    }
+}
+
+static void normalize(detector_t *d)
+{
+    for (uint32_t j = 0; j < d->n_doa; j++)
+    {
+        uint64_t sum = 0;
+        for (uint32_t c = 0; c < d->n_mics; c++)
+        {
+            int32_t r = d->xr[j][c], i = d->xi[j][c];
+            sum += (uint32_t)(r < 0 ? -r : r) + (uint32_t)(i < 0 ? -i : i);
+        }
+        if (!sum) continue;
+        int32_t sh = block_shift(sum, 13);
+        for (uint32_t c = 0; c < d->n_mics; c++)
+        {
+            d->xr[j][c] = scale(d->xr[j][c], sh);
+            d->xi[j][c] = scale(d->xi[j][c], sh);
+        }
+    }
+}
+
+// Steered response power over the direction grid: each mic rotated back by its advance
+static void step_steer(detector_t *d)
+{
+    detect_features_t *f = &d->cur;
+    normalize(d);
+
+    uint32_t best = 0, best_dir = 0;
+    uint64_t total = 0;
+    for (uint32_t k = 0; k < DETECT_N_DIRS; k++)
+    {
+        uint32_t pw = 0;
+        for (uint32_t j = 0; j < d->n_doa; j++)
+        {
+            int32_t sr = 0, si = 0;
+            for (uint32_t c = 0; c < d->n_mics; c++)
+            {
+                // turns = f / (16 N) * adv / 512
+                uint32_t p = (uint32_t)(((int32_t)d->doa_f[j] * d->adv[k][c] + 2048) >> 12);
+                int32_t  cs = d->sin[(p + COS_OFFSET) & SIN_MASK], sn = d->sin[p & SIN_MASK];
+                int32_t  r = d->xr[j][c], i = d->xi[j][c];
+                sr += (r * cs + i * sn) >> 15;
+                si += (i * cs - r * sn) >> 15;
+            }
+            pw += (uint32_t)(sr * sr) + (uint32_t)(si * si);
+        }
+        total += pw;
+        if (pw > best)
+        {
+            best = pw;
+            best_dir = k;
+        }
+    }
+    uint64_t q = total ? ((uint64_t)best * 256 * DETECT_N_DIRS) / total : 0;
+    f->flags |= DETECT_DOA;
+    f->az_deg = (int16_t)(best_dir % DETECT_N_AZ * DETECT_AZ_STEP);
+    f->el_deg = (int16_t)(best_dir / DETECT_N_AZ * DETECT_EL_STEP);
+    f->doa_q8 = (uint16_t)(q > 0xFFFF ? 0xFFFF : q);
+}
+
+// Runs the next step of the frame; true when its report is complete
+static bool step(detector_t *d)
+{
+    uint32_t s = d->step;
+    bool done = false;
+    if (s == 0)
+        step_prepare(d);
+    else if (s < STEP_COMB)
+        step_fft(d, s - STEP_FFT);
+    else if (s == STEP_COMB)
+        done = !step_comb(d);
+    else if (s < STEP_DFT + d->n_mics)
+        step_dft(d, s - STEP_DFT);
+    else
+    {
+        step_steer(d);
+        done = true;
+    }
+    d->step = done ? DETECT_IDLE : s + 1;
+    return done;
+}
+
+static uint32_t finish(detector_t *d, detect_report_t *out)
+{
+    if (d->step == DETECT_IDLE) return 0;
+    while (!step(d)) {}
+    out->frame = d->frame_end;
+    out->f = d->cur;
+    return 1;
+}
+
+// ---------- Input ----------
+uint32_t detect_process(detector_t *d, const int32_t *in, uint32_t in_stride, uint32_t n_frames,
+                        detect_report_t *out)
+{
+    uint32_t n_out = 0;
+    while (n_frames)
+    {
+        // Up to the next hop boundary, so its input frame is exact
+        uint32_t need = DETECT_HOP - d->fill;
+        uint32_t take = d->factor == 1 ? need : d->dec.phase + (need - 1) * d->factor + 1;
+        if (take > DECIM_MAX_BLOCK) take = DECIM_MAX_BLOCK;
+        if (take > n_frames) take = n_frames;
+
+        const int32_t *s = in;
+        uint32_t stride = in_stride, got = take;
+        if (d->factor > 1)
+        {
+            got = decim_process(&d->dec, in, in_stride, d->dec_out, d->n_mics, take);
+            s = d->dec_out;
+            stride = d->n_mics;
+        }
+        for (uint32_t c = 0; c < d->n_mics; c++)
+        {
+            int16_t *x = &d->x[c][DETECT_N + d->fill];
+            for (uint32_t i = 0; i < got; i++)
+                x[i] = (int16_t)(s[i * stride + c] >> 16);
+        }
+        d->fill += got;
+        d->frames += take;
+        in += take * in_stride;
+        n_frames -= take;
+
+        if (d->fill == DETECT_HOP)
+        {
+            // The previous frame must be done before its samples move
+            n_out += finish(d, &out[n_out]);
+            for (uint32_t c = 0; c < d->n_mics; c++)
+                memmove(d->x[c], &d->x[c][DETECT_HOP], DETECT_N * sizeof(int16_t));
+            d->fill = 0;
+            d->frame_end = d->frames;
+            if (d->hops < DETECT_N / DETECT_HOP) d->hops++;
+            if (d->hops == DETECT_N / DETECT_HOP) d->step = 0;     // a whole frame is in
+        }
+    }
+
+    if (d->step != DETECT_IDLE && step(d))
+    {
+        out[n_out].frame = d->frame_end;
+        out[n_out].f = d->cur;
+        n_out++;
+    }
+    return n_out;
+}
+
+void detect_skip(detector_t *d, uint32_t n_frames)
+{
+    d->frames += n_frames;
+}
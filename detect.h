@@ -0,0 +1,147 @@
+// detect.h — fixed-point harmonic drone detector: spectral front-end, comb score, DOA (no SDK dependencies)
+//
+// Multirotors radiate a blade-pass fundamental of tens to a few hundred Hz with a long
+// series of harmonics. The detector decimates every mic to DETECT_RATE and, every
+// DETECT_HOP samples, analyses the last DETECT_N: the level of each mic, a Hann-windowed
+// FFT of the mic sum, a per-bin noise floor and a harmonic comb over the candidate
+// fundamentals. A candidate scores the rise of its harmonics over the floor minus the
+// rise half-way between them, which rejects both half and twice the true fundamental.
+// A score of DETECT_ON_DB for DETECT_ON_HOPS frames in a row starts a detection; it ends
+// DETECT_HOLD_HOPS frames after the score last reached DETECT_OFF_DB. The floor learns
+// only outside detections, so start the detector without a target present.
+//
+// While the score is up, the direction of arrival is the peak of the steered response
+// power at a few harmonics: per-mic DFTs at those frequencies, phased for every direction
+// of a fixed grid with the beamformer's geometry (beam_mic_advance()). A small array
+// resolves low frequencies poorly, so the harmonics are ranked by their rise plus a
+// bonus for frequency rather than by the rise alone.
+//
+// A frame's analysis is split into steps, one per detect_process() call (the FFT stage
+// by stage, the DFTs mic by mic), so no single 1 ms packet carries all of it. Reports do
+// not depend on how the input is cut, and all arithmetic is integer: the host build
+// reproduces them bit for bit (host/detect_ref.c).
+
+#ifndef DETECT_H
+#define DETECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "beamform.h"
+#include "decimate.h"
+
+#define DETECT_RATE             8000                    // analysis rate
+#define DETECT_LOG2_N           9
+#define DETECT_N                (1 << DETECT_LOG2_N)    // FFT length: 64 ms, 15.6 Hz bins
+#define DETECT_HOP              (DETECT_N / 2)          // one report per 32 ms
+#define DETECT_BINS             (DETECT_N / 2 + 1)
+#define DETECT_MAX_MICS         16
+#define DETECT_SIN_STEPS        1024                    // sine table, per turn
+
+// Comb: candidate fundamentals every 1/4 bin, frequencies in 1/16 bins
+#define DETECT_F_Q              4
+#define DETECT_F0_STEP          4
+#define DETECT_F0_MIN_HZ        60
+#define DETECT_F0_MAX_HZ        400
+#define DETECT_HARMONICS        8
+
+// Decision, on the comb score (mean rise of the harmonics over the gaps between them).
+// Noise alone scores 3..6 dB: the best of the candidates always finds some rise.
+#define DETECT_ON_DB            10
+#define DETECT_OFF_DB           6
+#define DETECT_ON_HOPS          3                       // ~100 ms
+#define DETECT_HOLD_HOPS        31                      // ~1 s
+
+// Noise floor, log domain: falls by 1/4 of the gap per frame, rises by 1/256 (~8 s)
+#define DETECT_FLOOR_DOWN       2
+#define DETECT_FLOOR_UP         8
+#define DETECT_SMOOTH           1                       // per-bin level IIR, 1/2 per frame
+
+// DOA: the best harmonics up to DETECT_DOA_MAX_HZ that rise DETECT_DOA_MIN_DB over
+// the floor, on a grid of azimuths x elevations 0 .. (DETECT_N_EL - 1) * DETECT_EL_STEP
+#define DETECT_DOA_HARMONICS    4
+#define DETECT_DOA_MAX_HZ       2000
+#define DETECT_DOA_MIN_DB       12
+#define DETECT_AZ_STEP          10
+#define DETECT_EL_STEP          20
+#define DETECT_N_AZ             (360 / DETECT_AZ_STEP)
+#define DETECT_N_EL             4
+#define DETECT_N_DIRS           (DETECT_N_AZ * DETECT_N_EL)
+
+// ---------- Report (feature vector, also the wire format: vstream.h) ----------
+#define DETECT_ACTIVE           0x01    // inside a detection, onset .. release
+#define DETECT_ONSET            0x02    // the frame that started it
+#define DETECT_RELEASE          0x04    // the frame that ended it (DETECT_ACTIVE clear)
+#define DETECT_DOA              0x08    // az/el/doa_q8 valid
+
+typedef struct __attribute__((packed)) {
+    uint8_t  flags;
+    uint8_t  n_mics;
+    uint16_t f0_q4;                         // best fundamental, Hz Q4
+    int16_t  score_q8;                      // its comb score, dB Q8
+    int16_t  az_deg, el_deg;                // direction of arrival (DETECT_DOA)
+    uint16_t doa_q8;                        // steered power at the peak over the grid mean, Q8
+    uint8_t  harm_db[DETECT_HARMONICS];     // rise of each harmonic over the floor, dB
+    int16_t  level_q8[DETECT_MAX_MICS];     // per-mic level over the newest hop, dBFS Q8
+} detect_features_t;
+
+#define DETECT_FEATURE_BYTES    52
+_Static_assert(sizeof(detect_features_t) == DETECT_FEATURE_BYTES, "detect feature vector size");
+
+typedef struct {
+    uint32_t          frame;                // input frames before the analysed frame's end
+    detect_features_t f;
+} detect_report_t;
+
+// ---------- Detector ----------
+typedef struct {
+    uint32_t    factor;                     // input rate / DETECT_RATE
+    uint32_t    n_mics;
+    uint32_t    frames;                     // input frames taken or skipped (wraps)
+    uint32_t    fill;                       // samples of the next hop received
+    uint32_t    hops;                       // received, up to a whole frame
+    decimator_t dec;
+    int32_t     dec_out[DECIM_MAX_BLOCK * DETECT_MAX_MICS];
+    int16_t     x[DETECT_MAX_MICS][DETECT_N + DETECT_HOP];   // analysis frame + the next hop
+    int16_t     sin[DETECT_SIN_STEPS];      // Q15
+    int16_t     win[DETECT_N];              // periodic Hann, Q15
+    int16_t     adv[DETECT_N_DIRS][DETECT_MAX_MICS];         // steering advance, 1/512 samples
+
+    // Frame under analysis
+    uint32_t    step;                       // next step, DETECT_IDLE when none
+    uint32_t    frame_end;
+    int32_t     shift;                      // block exponent of the FFT input
+    int32_t     re[DETECT_N], im[DETECT_N];
+    uint32_t    n_doa;
+    uint32_t    doa_f[DETECT_DOA_HARMONICS];                 // 1/16 bins
+    int32_t     xr[DETECT_DOA_HARMONICS][DETECT_MAX_MICS];
+    int32_t     xi[DETECT_DOA_HARMONICS][DETECT_MAX_MICS];
+    detect_features_t cur;
+
+    // Across frames
+    bool        primed;                     // level/floor hold a frame
+    int16_t     level[DETECT_BINS];         // smoothed log2 power, Q8
+    int16_t     floor[DETECT_BINS];
+    uint32_t    on_count, hold;
+    bool        active;
+} detector_t;
+
+#define DETECT_IDLE             0xFFFFFFFFu
+
+// Input rate / DETECT_RATE for a stream rate the detector takes, else 0.
+uint32_t detect_factor(uint32_t sample_rate);
+
+// Steering from the mic positions (beamform.h); state starts from silence with no floor.
+// Returns 0, or -1 for an unsupported rate or mic count.
+int detect_init(detector_t *d, const beam_mic_t *mics, uint32_t n_mics, uint32_t sample_rate);
+
+// in: n_frames x in_stride interleaved Q31 at the init rate (mics in the first n_mics).
+// Writes the reports of frames finished by this call to out and returns their number:
+// at most 2 + n_frames / (DETECT_HOP * factor).
+uint32_t detect_process(detector_t *d, const int32_t *in, uint32_t in_stride, uint32_t n_frames,
+                        detect_report_t *out);
+
+// Input lost ahead of the next detect_process() call (a capture overrun): it counts
+// toward the report frame numbers, the analysis just runs on.
+void detect_skip(detector_t *d, uint32_t n_frames);
+
+#endif // DETECT_H
@@ -0,0 +1,71 @@
+// drift.c — I2S vs USB SOF clock drift tracker + asynchronous packet sizing
+
+#include "drift.h"
+
+void drift_init(drift_t *d, uint32_t sample_rate)
+{
+    d->nominal_q16      = (uint32_t)(((uint64_t)sample_rate << 16) / 1000u);
+    d->rate_q16         = d->nominal_q16;
+    d->acc_q16          = 0;
+    d->win_ms           = 0;
+    d->win_frames_start = 0;
+    d->last_sof         = 0;
+    d->windows          = 0;
+    d->started          = false;
+}
+
+void drift_sof(drift_t *d, uint32_t sof_frame, uint32_t captured_frames)
+{
+    if (!d->started)
+    {
+        // First SOF: open the first window
+        d->started = true;
+        d->last_sof = sof_frame;
+        d->win_frames_start = captured_frames;
+        d->win_ms = 1;
+        return;
+    }
+
+    // SOF frame number is 11 bits; count missed SOFs too
+    d->win_ms += (sof_frame - d->last_sof) & 0x7FFu;
+    d->last_sof = sof_frame;
+    if (d->win_ms <= DRIFT_WINDOW_MS) return;
+
+    uint32_t frames = captured_frames - d->win_frames_start;
+    uint32_t ms     = d->win_ms - 1;
+    uint32_t rate   = (uint32_t)(((uint64_t)frames << 16) / ms);
+
+    if (d->windows == 0)
+        d->rate_q16 = rate;
+    else
+        d->rate_q16 = (uint32_t)((int32_t)d->rate_q16 + (((int32_t)rate - (int32_t)d->rate_q16) >> DRIFT_IIR_SHIFT));
+
+    d->windows++;
+    d->win_frames_start = captured_frames;
+    d->win_ms = 1;
+}
+
+uint32_t drift_packet_frames(drift_t *d, uint32_t fill_frames, uint32_t target_fill)
+{
+    int32_t err = (int32_t)fill_frames - (int32_t)target_fill;
+    int32_t nom = (int32_t)(d->nominal_q16 >> 16);
+
+    d->acc_q16 += (int32_t)d->rate_q16 + err * DRIFT_SERVO_GAIN_Q16;
+    int32_t n = d->acc_q16 >> 16;
+
+    // Asynchronous source: never more than one frame away from nominal
+    if (n > nom + 1) n = nom + 1;
+    if (n < nom - 1) n = nom - 1;
+
+    // Keep the residue within one frame if the clamp kicked in
+    d->acc_q16 -= n << 16;
+    if (d->acc_q16 < 0)        d->acc_q16 = 0;
+    if (d->acc_q16 > 0xFFFF)   d->acc_q16 = 0xFFFF;
+    return (uint32_t)n;
+}
+
+int32_t drift_ppm(const drift_t *d)
+{
+    int64_t diff = (int64_t)d->rate_q16 - (int64_t)d->nominal_q16;
+    return (int32_t)(diff * 1000000 / (int64_t)d->nominal_q16);
+}
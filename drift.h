@@ -0,0 +1,39 @@
+// drift.h — I2S vs USB SOF clock drift tracker + asynchronous packet sizing (no SDK dependencies)
+
+#ifndef DRIFT_H
+#define DRIFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Measurement window in SOF frames (1 ms each) and IIR smoothing (1 / 2^shift).
+#define DRIFT_WINDOW_MS         1024
+#define DRIFT_IIR_SHIFT         3
+// Ring fill servo: Q16 frames/ms added per frame of fill error (slow, keeps fill centred).
+#define DRIFT_SERVO_GAIN_Q16    16
+
+typedef struct {
+    uint32_t nominal_q16;       // nominal frames per ms, Q16
+    uint32_t rate_q16;          // measured frames per ms, Q16 (smoothed)
+    int32_t  acc_q16;           // fractional frame accumulator for packet sizing
+    uint32_t win_ms;            // SOFs seen in the current window
+    uint32_t win_frames_start;  // captured frame count at window start
+    uint32_t last_sof;          // last 11-bit SOF frame number
+    uint32_t windows;           // completed windows (0 => rate not measured yet)
+    bool     started;           // first SOF seen
+} drift_t;
+
+void drift_init(drift_t *d, uint32_t sample_rate);
+
+// Call on every SOF with the USB frame number and the monotonic captured frame count.
+void drift_sof(drift_t *d, uint32_t sof_frame, uint32_t captured_frames);
+
+// Frames to put in the next IN packet: nominal +/- 1, following the measured rate
+// and nudged towards target_fill.
+uint32_t drift_packet_frames(drift_t *d, uint32_t fill_frames, uint32_t target_fill);
+
+// Measured I2S clock offset against the host SOF clock, parts per million. The host reads
+// it from the telemetry snapshot (telemetry.h drift_ppm, host/telemetry_decode).
+int32_t drift_ppm(const drift_t *d);
+
+#endif // DRIFT_H
@@ -0,0 +1,75 @@
+// dsp.h — Cortex-M33 DSP-extension operations for the sample kernels (no SDK dependencies)
+//
+// The RP2350's M33 cores add the Armv8-M DSP extension: SMLAD/SMLADX (two signed 16 x 16
+// MACs into one 32-bit accumulator), SSAT (saturate to n bits) and packing halfword moves.
+// The kernels in samples.c, decimate.c and beamform.c have a version built on them
+// (_dsp) next to the portable C one (_c). DSP_KERNELS picks which one the plain names
+// call: by default the DSP versions where the compiler targets the extension
+// (__ARM_FEATURE_DSP, the rp2350-arm-s platform), the C versions on the RP2040's M0+
+// and on RISC-V.
+//
+// Where the extension is missing the operations below are C models of the instructions,
+// so the _dsp kernels also build on the host and host/kernels_ref.c checks them against
+// the _c ones bit for bit.
+
+#ifndef DSP_H
+#define DSP_H
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define DSP_HW                  1
+#include <arm_acle.h>
+#else
+#define DSP_HW                  0
+#endif
+
+#ifndef DSP_KERNELS
+#define DSP_KERNELS             DSP_HW
+#endif
+
+#if DSP_HW
+// acc + x.lo * y.lo + x.hi * y.hi (halves signed), modulo 2^32
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+    return __smlad((int16x2_t)x, (int16x2_t)y, acc);
+}
+
+// acc + x.lo * y.hi + x.hi * y.lo
+static inline int32_t dsp_smladx(uint32_t x, uint32_t y, int32_t acc)
+{
+    return __smladx((int16x2_t)x, (int16x2_t)y, acc);
+}
+
+// x clamped to [-2^(bits-1), 2^(bits-1) - 1]; bits must be a constant
+#define dsp_ssat(x, bits)       __ssat((x), (bits))
+#else
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+    uint32_t lo = (uint32_t)((int32_t)(int16_t)x * (int16_t)y);
+    uint32_t hi = (uint32_t)((int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16));
+    return (int32_t)((uint32_t)acc + lo + hi);
+}
+
+static inline int32_t dsp_smladx(uint32_t x, uint32_t y, int32_t acc)
+{
+    return dsp_smlad(x, y << 16 | y >> 16, acc);
+}
+
+static inline int32_t dsp_ssat_model(int32_t x, uint32_t bits)
+{
+    int32_t max = (int32_t)((1u << (bits - 1)) - 1);
+    if (x > max) return max;
+    if (x < -max - 1) return -max - 1;
+    return x;
+}
+#define dsp_ssat(x, bits)       dsp_ssat_model((x), (bits))
+#endif
+
+// Top halves of two words into one: a's in bits 0..15, b's in 16..31 (PKHTB)
+static inline uint32_t dsp_pack_hi16(int32_t a, int32_t b)
+{
+    return ((uint32_t)a >> 16) | ((uint32_t)b & 0xFFFF0000u);
+}
+
+#endif // DSP_H
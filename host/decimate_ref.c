@@ -0,0 +1,219 @@
+// decimate_ref.c — host test harness for decimate.c
+//
+// For each factor: checks the compile-time Q15 taps against a double-precision Kaiser
+// design, measures the quantized filter's passband ripple and stopband attenuation,
+// checks the block implementation bit for bit against a direct FIR over the whole
+// signal (fed in 47/48/49-frame packets like the USB path), measures tone levels
+// through the fixed-point path (one below the 16-bit LSB), and times it in host cycles / ns per output sample.
+
+#include "decimate.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define FS_IN       48000
+#define N_CH        6
+#define N_FRAMES    48000
+#define BETA        7.5
+
+static const uint32_t factors[] = { 2, 3, 6 };
+
+static int32_t in[N_FRAMES * N_CH];
+static int32_t out_dev[N_FRAMES * N_CH];
+static int32_t out_ref[N_FRAMES * N_CH];
+
+static double i0(double x)
+{
+    double y = x * x / 4, term = 1, sum = 1;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= y / ((double)k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+// Same design as decimate.c, computed at run time in double
+static double design_tap(uint32_t m_fac, uint32_t n, uint32_t n_taps)
+{
+    double c = (n_taps - 1) / 2.0;
+    double m = n - c;
+    double sinc = m == 0 ? 1.0 / m_fac : sin(M_PI * m / m_fac) / (M_PI * m);
+    double r = m / c;
+    return sinc * i0(BETA * sqrt(1 - r * r)) / i0(BETA);
+}
+
+// |H(f)| in dB of the quantized taps, f in Hz at FS_IN
+static double response_db(const int16_t *h, uint32_t n_taps, double f)
+{
+    double re = 0, im = 0, w = 2 * M_PI * f / FS_IN;
+    for (uint32_t n = 0; n < n_taps; n++)
+    {
+        re += h[n] * cos(w * n);
+        im -= h[n] * sin(w * n);
+    }
+    return 20 * log10(hypot(re, im) / 32768.0 + 1e-20);
+}
+
+// Direct FIR, same integer arithmetic, no blocks; zero history before the first frame
+static uint32_t reference(const int16_t *h, uint32_t n_taps, uint32_t m_fac,
+                          const int32_t *x, int32_t *y, uint32_t n_frames)
+{
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_frames; i += m_fac, k++)
+        for (uint32_t c = 0; c < N_CH; c++)
+        {
+            int64_t acc = 1 << (DECIM_COEF_Q - 1);
+            for (uint32_t t = 0; t < n_taps; t++)
+            {
+                int64_t j = (int64_t)i + 1 - n_taps + t;
+                acc += (int64_t)h[t] * (j < 0 ? 0 : (x[j * N_CH + c] >> 8));     // 24 bits
+            }
+            acc >>= DECIM_COEF_Q;
+            if (acc > (1 << 23) - 1) acc = (1 << 23) - 1;
+            if (acc < -(1 << 23)) acc = -(1 << 23);
+            y[k * N_CH + c] = (int32_t)acc * 256;
+        }
+    return k;
+}
+
+// Device implementation in USB-sized packets, in place like the pipeline
+static uint32_t device(decimator_t *d, const int32_t *x, int32_t *y, uint32_t n_frames)
+{
+    static int32_t pkt[64 * N_CH];
+    uint32_t f = 0, k = 0;
+    while (f < n_frames)
+    {
+        uint32_t n = 47 + (uint32_t)(rand() % 3);
+        if (n > n_frames - f) n = n_frames - f;
+        memcpy(pkt, x + f * N_CH, n * N_CH * sizeof(int32_t));
+        uint32_t o = decim_process(d, pkt, N_CH, pkt, N_CH, n);
+        memcpy(y + k * N_CH, pkt, o * N_CH * sizeof(int32_t));
+        f += n;
+        k += o;
+    }
+    return k;
+}
+
+static void tone(double f, double amp)
+{
+    for (uint32_t n = 0; n < N_FRAMES; n++)
+        for (uint32_t c = 0; c < N_CH; c++)
+            in[n * N_CH + c] = (int32_t)(amp * sin(2 * M_PI * f * n / FS_IN)) & ~0xFF;
+}
+
+static double rms_db(const int32_t *y, uint32_t n, uint32_t skip)
+{
+    double acc = 0;
+    for (uint32_t i = skip; i < n; i++)
+        acc += (double)y[i * N_CH] * y[i * N_CH];
+    return 10 * log10(acc / (n - skip) / (0.5 * 2147483648.0 * 2147483648.0) + 1e-30);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static decimator_t d;
+    int fail = 0;
+
+    printf("factor  fs_out  taps  coef err  ripple[dB]  stop[dB]  alias band[dB]  bit-exact  "
+           "pass tone[dB]  stop tone[dB]  low tone[dB]  MAC/out  cyc/out  ns/out\n");
+
+    for (uint32_t fi = 0; fi < sizeof(factors) / sizeof(factors[0]); fi++)
+    {
+        uint32_t m_fac = factors[fi], n_taps;
+        const int16_t *h = decim_coefs(m_fac, &n_taps);
+        double fs_out = (double)FS_IN / m_fac;
+
+        // 1) Compile-time taps vs the double design
+        int32_t coef_err = 0;
+        for (uint32_t n = 0; n < n_taps; n++)
+        {
+            int32_t e = abs(h[n] - (int32_t)lround(design_tap(m_fac, n, n_taps) * 32768.0));
+            if (e > coef_err) coef_err = e;
+        }
+        if (coef_err > 1) fail = 1;
+
+        // 2) Response of the quantized filter
+        double pmax = -1e9, pmin = 1e9, smax = -1e9, amax = -1e9;
+        for (double f = 0; f <= FS_IN / 2; f += 5)
+        {
+            double db = response_db(h, n_taps, f);
+            if (f <= fs_out * DECIM_PASS_EDGE_PCT / 100)
+            {
+                if (db > pmax) pmax = db;
+                if (db < pmin) pmin = db;
+            }
+            else if (f >= fs_out * DECIM_STOP_EDGE_PCT / 100)
+            {
+                if (db > smax) smax = db;
+            }
+            else if (f >= fs_out / 2)
+            {
+                if (db > amax) amax = db;
+            }
+        }
+
+        // 3) Bit-exactness on full-scale noise
+        srand(1);
+        for (uint32_t i = 0; i < N_FRAMES * N_CH; i++)
+            in[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) & ~0xFF;
+        decim_init(&d, m_fac, N_CH);
+        uint32_t n_dev = device(&d, in, out_dev, N_FRAMES);
+        uint32_t n_ref = reference(h, n_taps, m_fac, in, out_ref, N_FRAMES);
+        uint32_t mismatches = n_dev != n_ref;
+        for (uint32_t i = 0; i < n_ref * N_CH && i < n_dev * N_CH; i++)
+            mismatches += out_dev[i] != out_ref[i];
+        if (mismatches) fail = 1;
+
+        // 4) Tones at -6 dBFS through the fixed-point path
+        decim_init(&d, m_fac, N_CH);
+        tone(0.25 * fs_out, 0.5 * 2147483647.0);
+        double pass_db = rms_db(out_dev, device(&d, in, out_dev, N_FRAMES), n_taps) + 6.02;
+        decim_init(&d, m_fac, N_CH);
+        tone(0.75 * fs_out, 0.5 * 2147483647.0);
+        double stop_db = rms_db(out_dev, device(&d, in, out_dev, N_FRAMES), n_taps) + 6.02;
+        // and one at -110 dBFS, below the 16-bit LSB
+        decim_init(&d, m_fac, N_CH);
+        tone(0.25 * fs_out, pow(10.0, -110.0 / 20.0) * 2147483647.0);
+        double low_db = rms_db(out_dev, device(&d, in, out_dev, N_FRAMES), n_taps) + 110.0;
+        if (fabs(low_db) > 1.0) fail = 1;
+
+        // 5) Timing: 50 x 1 s of 6 channels, one output sample = one channel of one frame
+        decim_init(&d, m_fac, N_CH);
+        uint32_t outs = 0;
+        double t0 = now_ns();
+#ifdef HAVE_TSC
+        uint64_t c0 = __rdtsc();
+#endif
+        for (int r = 0; r < 50; r++)
+            outs += decim_process(&d, in, N_CH, out_dev, N_CH, N_FRAMES) * N_CH;
+#ifdef HAVE_TSC
+        double cyc = (double)(__rdtsc() - c0) / outs;
+#else
+        double cyc = 0;
+#endif
+        double ns = (now_ns() - t0) / outs;
+
+        printf("%6u  %6.0f  %4u  %4d LSB  %10.4f  %8.1f  %14.1f  %9s  %13.2f  %13.1f  %12.2f  %7u  %7.1f  %6.2f\n",
+               m_fac, fs_out, n_taps, coef_err, pmax - pmin, pmin - smax, pmin - amax,
+               mismatches ? "NO" : "yes", pass_db, stop_db, low_db, n_taps, cyc, ns);
+    }
+
+    printf("\nstop = attenuation from %d%% fs_out to fs_in/2; alias band = %d..%d%% fs_out "
+           "(folds above the passband only)\n", DECIM_STOP_EDGE_PCT, 50, DECIM_STOP_EDGE_PCT);
+    printf("low tone = level of a -110 dBFS passband tone re -110 dBFS (needs the 24-bit path)\n");
+    return fail;
+}
@@ -0,0 +1,601 @@
+// detect_ref.c — host reference, scenarios and benchmark for detect.c
+//
+// Synthesises the array's mics at 48 kHz: per-mic self-noise, plus either a multirotor
+// as a plane wave (a wobbling blade-pass fundamental with harmonics that comes and goes)
+// or a distractor (a single loud tone, 50 Hz mains hum with its harmonics). Every run
+// feeds detect_process() 47/48/49-frame packets as the pipeline does, and checks its
+// reports bit for bit against a straight per-frame reimplementation: one decimation of
+// the whole signal, a recursive FFT, the comb and the steering written out directly,
+// with the sine table, window and steering advances recomputed in double and rounded.
+// Per scenario it then reports false onsets, onset and release latency, and the f0 and
+// direction error while active; finally host cycles / ns per input frame and the worst
+// packet at each rate the detector takes.
+
+#include "detect.h"
+#include "array_config.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define FS              48000
+#define N_MICS          ARRAY_N_MICS
+#define MAX_SECONDS     60
+#define MAX_REPORTS     (MAX_SECONDS * DETECT_RATE / DETECT_HOP + 2)
+#define NOISE_DBFS      -60.0               // per-mic self-noise, RMS
+#define N_HARM_SIG      12                  // harmonics the synthetic rotor radiates
+#define RAMP_S          0.05
+#define ONSET_MAX_S     0.5                 // after the rotor starts
+#define RELEASE_MAX_S   (0.3 + DETECT_HOLD_HOPS * (double)DETECT_HOP / DETECT_RATE)
+#define F0_TOL          0.03
+#define AZ_TOL_DEG      15
+
+static const beam_mic_t mics[N_MICS] = ARRAY_MIC_POSITIONS;
+
+// ---------- Signals ----------
+typedef struct {
+    const char *name;
+    double seconds;
+    double f0, az, el, harm_dbfs;           // rotor (f0 = 0: none), level of its fundamental
+    double on_s, off_s;
+    double tone_hz, tone_dbfs;              // distractors (0 = none)
+    double hum_dbfs;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "noise",        30,   0,   0,  0,   0, 0, 0,    0,   0,   0 },
+    { "tone 1 kHz",   15,   0,   0,  0,   0, 0, 0, 1000, -30,   0 },
+    { "mains hum",    15,   0,   0,  0,   0, 0, 0,    0,   0, -35 },
+    { "rotor 120 Hz", 14, 120,  30, 20, -66, 4, 10,   0,   0,   0 },
+    { "rotor 210 Hz", 14, 210, 200, 40, -70, 4, 10,   0,   0,   0 },
+    { "rotor 330 Hz", 14, 330, 300,  0, -72, 4, 10,   0,   0,   0 },
+    { "rotor 75 Hz",  14,  75, 120, 20, -66, 4, 10,   0,   0,   0 },
+    { "rotor + hum",  14, 160,  90, 20, -66, 4, 10,   0,   0, -40 },
+};
+#define N_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static uint32_t rng = 1;
+
+static double uniform(void)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return ((rng >> 8) + 0.5) / 16777216.0;
+}
+
+// Box-Muller, both values of a pair
+static double gauss(void)
+{
+    static double next;
+    static bool   have;
+    if ((have = !have))
+    {
+        double r = sqrt(-2 * log(uniform())), p = 2 * M_PI * uniform();
+        next = r * sin(p);
+        return r * cos(p);
+    }
+    return next;
+}
+
+static double dbfs(double db) { return pow(10, db / 20); }
+static double rad(double deg) { return deg * M_PI / 180; }
+
+// Arrival advance of a plane wave from (az, el) at mic m, seconds
+static double advance_s(const beam_mic_t *m, double az, double el)
+{
+    return (m->x * cos(rad(el)) * cos(rad(az)) + m->y * cos(rad(el)) * sin(rad(az)) +
+            m->z * sin(rad(el))) / BEAM_SOUND_SPEED;
+}
+
+typedef struct {
+    const scenario_t *sc;
+    uint32_t fs;
+    uint64_t n;                             // frames generated
+    double   adv[N_MICS];
+    double   cph[N_HARM_SIG], sph[N_HARM_SIG];   // harmonic phases
+} gen_t;
+
+static void gen_init(gen_t *g, const scenario_t *sc, uint32_t fs)
+{
+    memset(g, 0, sizeof(*g));
+    g->sc = sc;
+    g->fs = fs;
+    for (uint32_t m = 0; m < N_MICS; m++)
+        g->adv[m] = advance_s(&mics[m], sc->az, sc->el);
+    for (uint32_t h = 0; h < N_HARM_SIG; h++)
+    {
+        double ph = 2 * M_PI * uniform();
+        g->cph[h] = cos(ph);
+        g->sph[h] = sin(ph);
+    }
+}
+
+// Rotor phase: f0 wobbles 1% at 0.3 Hz
+static double rotor_phase(double f0, double t)
+{
+    return 2 * M_PI * f0 * (t - 0.01 / (2 * M_PI * 0.3) * cos(2 * M_PI * 0.3 * t));
+}
+
+static double envelope(const scenario_t *sc, double t)
+{
+    if (t < sc->on_s || t > sc->off_s + RAMP_S) return 0;
+    if (t < sc->on_s + RAMP_S) return (t - sc->on_s) / RAMP_S;
+    if (t > sc->off_s) return 1 - (t - sc->off_s) / RAMP_S;
+    return 1;
+}
+
+// n frames of N_MICS, Q31 with 24 significant bits as the mics deliver them
+static void gen_frames(gen_t *g, int32_t *out, uint32_t n)
+{
+    const scenario_t *sc = g->sc;
+    double noise = dbfs(NOISE_DBFS), a0 = dbfs(sc->harm_dbfs);
+    for (uint32_t f = 0; f < n; f++, g->n++)
+    {
+        double t = (double)g->n / g->fs;
+        double env = sc->f0 > 0 ? envelope(sc, t) : 0;
+        double common = 0;
+        if (sc->tone_hz > 0) common += dbfs(sc->tone_dbfs) * sin(2 * M_PI * sc->tone_hz * t);
+        if (sc->hum_dbfs < 0)
+            for (uint32_t h = 1; h <= 9; h++)
+                common += dbfs(sc->hum_dbfs) / h * sin(2 * M_PI * 50 * h * t + h);
+        for (uint32_t m = 0; m < N_MICS; m++)
+        {
+            double v = common + noise * gauss();
+            if (env > 0)
+            {
+                // Harmonic h + 1 from the rotation e^(jp) taken h + 1 times
+                double p = rotor_phase(sc->f0, t + g->adv[m]), cr = cos(p), ci = sin(p), hr = cr, hi = ci;
+                for (uint32_t h = 0; h < N_HARM_SIG; h++)
+                {
+                    v += env * a0 / sqrt(h + 1.0) * (hi * g->cph[h] + hr * g->sph[h]);
+                    double r = hr * cr - hi * ci;
+                    hi = hr * ci + hi * cr;
+                    hr = r;
+                }
+            }
+            if (v > 1) v = 1;
+            if (v < -1) v = -1;
+            out[f * N_MICS + m] = (int32_t)lrint(v * 8388607.0) * 256;
+        }
+    }
+}
+
+// ---------- Reference ----------
+// Tables from double, rounded as the device's constants are
+static int16_t ref_sin[DETECT_SIN_STEPS];
+static int16_t ref_win[DETECT_N];
+static int16_t ref_adv[DETECT_N_DIRS][N_MICS];
+
+static int32_t q14(double v) { return (int32_t)round(v * 16384.0); }
+
+static void ref_tables(void)
+{
+    for (uint32_t k = 0; k < DETECT_SIN_STEPS; k++)
+        ref_sin[k] = (int16_t)lrint(32767 * sin(2 * M_PI * k / DETECT_SIN_STEPS));
+    for (uint32_t n = 0; n < DETECT_N; n++)
+        ref_win[n] = (int16_t)((32767 - lrint(32767 * cos(2 * M_PI * n / DETECT_N))) >> 1);
+
+    // beam_mic_advance(): Q14 look vector, rounded to 1/32 samples at 16x DETECT_RATE
+    for (uint32_t e = 0; e < DETECT_N_EL; e++)
+        for (uint32_t a = 0; a < DETECT_N_AZ; a++)
+        {
+            double  az = rad(a * DETECT_AZ_STEP), el = rad(e * DETECT_EL_STEP);
+            int32_t ce = q14(cos(el));
+            int32_t ux = (ce * q14(cos(az))) >> 14, uy = (ce * q14(sin(az))) >> 14, uz = q14(sin(el));
+            for (uint32_t m = 0; m < N_MICS; m++)
+            {
+                double dot = (double)mics[m].x * ux + (double)mics[m].y * uy + (double)mics[m].z * uz;
+                ref_adv[e * DETECT_N_AZ + a][m] =
+                    (int16_t)round(dot * DETECT_RATE * 16 * BEAM_FRAC_STEPS / (BEAM_SOUND_SPEED * 16384.0));
+            }
+        }
+}
+
+static int32_t ref_cos(uint32_t p) { return ref_sin[(p + DETECT_SIN_STEPS / 4) % DETECT_SIN_STEPS]; }
+static int32_t ref_sn(uint32_t p)  { return ref_sin[p % DETECT_SIN_STEPS]; }
+
+static int32_t ref_log2_q8(uint32_t v)
+{
+    if (!v) return 0;
+    int32_t e = 0;
+    while ((v >> e) > 1) e++;
+    return e << 8 | (int32_t)(((uint64_t)v << 8 >> e) & 0xFF);
+}
+
+static int32_t ref_db(int32_t l) { return (l * 771) >> 8; }
+
+// v * 2^sh brings the positive v into [2^b, 2^(b+1))
+static int32_t ref_shift(uint64_t v, int32_t b)
+{
+    int32_t sh = 0;
+    for (; v >= (2ull << b); v >>= 1) sh--;
+    for (; v < (1ull << b); v <<= 1) sh++;
+    return sh;
+}
+
+static int32_t ref_scale(int32_t v, int32_t sh) { return sh >= 0 ? v * (1 << sh) : v >> -sh; }
+
+// Radix-2 DIT by definition: halves of the even and odd samples, 1/2 per level
+static void ref_fft(const int32_t *xr, const int32_t *xi, uint32_t n, uint32_t stride, int32_t *yr, int32_t *yi)
+{
+    if (n == 1)
+    {
+        yr[0] = xr[0];
+        yi[0] = xi[0];
+        return;
+    }
+    int32_t er[DETECT_N / 2], ei[DETECT_N / 2], or_[DETECT_N / 2], oi[DETECT_N / 2];
+    ref_fft(xr, xi, n / 2, 2 * stride, er, ei);
+    ref_fft(xr + stride, xi + stride, n / 2, 2 * stride, or_, oi);
+    for (uint32_t k = 0; k < n / 2; k++)
+    {
+        uint32_t p = k * (DETECT_SIN_STEPS / n);
+        int32_t  tr = (or_[k] * ref_cos(p) + oi[k] * ref_sn(p)) >> 15;
+        int32_t  ti = (oi[k] * ref_cos(p) - or_[k] * ref_sn(p)) >> 15;
+        yr[k]         = (er[k] + tr) >> 1;
+        yi[k]         = (ei[k] + ti) >> 1;
+        yr[k + n / 2] = (er[k] - tr) >> 1;
+        yi[k + n / 2] = (ei[k] - ti) >> 1;
+    }
+}
+
+typedef struct {
+    int32_t  level[DETECT_BINS], floor[DETECT_BINS];
+    bool     primed, active;
+    uint32_t on_count, hold;
+} ref_t;
+
+static int32_t ref_tooth(const int32_t *rise, uint32_t f)
+{
+    uint32_t k = f / 16;
+    return rise[k] > rise[k + 1] ? rise[k] : rise[k + 1];
+}
+
+// One frame ending before decimated sample `end` of x[m]
+static void ref_frame(ref_t *r, int16_t *const *x, uint32_t end, detect_features_t *f)
+{
+    const uint32_t N = DETECT_N, F0_LO = 60 * N * 16 / DETECT_RATE, F0_HI = 400 * N * 16 / DETECT_RATE;
+    memset(f, 0, sizeof(*f));
+    f->n_mics = N_MICS;
+    for (uint32_t m = 0; m < N_MICS; m++)
+    {
+        uint64_t e = 0;
+        for (uint32_t n = end - DETECT_HOP; n < end; n++)
+            e += (uint64_t)((int64_t)x[m][n] * x[m][n]);
+        f->level_q8[m] = (int16_t)ref_db(ref_log2_q8((uint32_t)(e / DETECT_HOP)) - 30 * 256);
+    }
+
+    // Mic sum, block-scaled, windowed, transformed
+    int32_t sum[DETECT_N], zr[DETECT_N], zi[DETECT_N] = { 0 }, yr[DETECT_N], yi[DETECT_N];
+    uint32_t peak = 0;
+    for (uint32_t n = 0; n < N; n++)
+    {
+        sum[n] = 0;
+        for (uint32_t m = 0; m < N_MICS; m++) sum[n] += x[m][end - N + n];
+        if ((uint32_t)abs(sum[n]) > peak) peak = (uint32_t)abs(sum[n]);
+    }
+    int32_t sh = peak ? ref_shift(peak, 14) : 30;
+    for (uint32_t n = 0; n < N; n++)
+        zr[n] = (ref_scale(sum[n], sh) * ref_win[n]) >> 16;
+    ref_fft(zr, zi, N, 1, yr, yi);
+
+    int32_t rise[DETECT_BINS];
+    for (uint32_t k = 0; k < DETECT_BINS; k++)
+    {
+        int32_t l = ref_log2_q8((uint32_t)(yr[k] * yr[k] + yi[k] * yi[k])) - 512 * sh;
+        if (!r->primed) r->level[k] = r->floor[k] = l;
+        r->level[k] += (l - r->level[k]) >> DETECT_SMOOTH;
+        rise[k] = r->level[k] > r->floor[k] ? r->level[k] - r->floor[k] : 0;
+    }
+    r->primed = true;
+
+    int32_t best = INT32_MIN;
+    uint32_t f0 = 0;
+    for (uint32_t c = F0_LO; c <= F0_HI; c += DETECT_F0_STEP)
+    {
+        int32_t s = 0;
+        for (uint32_t h = 1; h <= DETECT_HARMONICS; h++)
+            s += ref_tooth(rise, h * c) - ref_tooth(rise, h * c - c / 2);
+        if (s > best) { best = s; f0 = c; }
+    }
+    f->f0_q4 = (uint16_t)((f0 * DETECT_RATE + N / 2) / N);
+    f->score_q8 = (int16_t)ref_db(best / DETECT_HARMONICS);
+    for (uint32_t h = 1; h <= DETECT_HARMONICS; h++)
+    {
+        int32_t db = ref_db(ref_tooth(rise, h * f0)) / 256;
+        f->harm_db[h - 1] = (uint8_t)(db > 255 ? 255 : db);
+    }
+
+    bool up = f->score_q8 >= DETECT_ON_DB * 256;
+    if (!r->active)
+    {
+        r->on_count = up ? r->on_count + 1 : 0;
+        if (r->on_count >= DETECT_ON_HOPS) { r->active = true; r->hold = DETECT_HOLD_HOPS; f->flags |= DETECT_ONSET; }
+    }
+    else if (f->score_q8 >= DETECT_OFF_DB * 256) r->hold = DETECT_HOLD_HOPS;
+    else if (--r->hold == 0) { r->active = false; r->on_count = 0; f->flags |= DETECT_RELEASE; }
+    if (r->active) f->flags |= DETECT_ACTIVE;
+    if (!r->active && !r->on_count)
+        for (uint32_t k = 0; k < DETECT_BINS; k++)
+        {
+            int32_t g = r->level[k] - r->floor[k];
+            r->floor[k] += g >> (g < 0 ? DETECT_FLOOR_DOWN : DETECT_FLOOR_UP);
+        }
+    if (!up) return;
+
+    // DOA harmonics: those that rise enough, ranked by the rise plus 2 log2(h), stable
+    uint32_t hf[DETECT_N], n_h = 0;
+    int32_t  hk[DETECT_N];
+    for (uint32_t h = 1; h * f0 * DETECT_RATE <= DETECT_DOA_MAX_HZ * N * 16; h++)
+        if (ref_tooth(rise, h * f0) >= DETECT_DOA_MIN_DB * 65536 / 771)
+        {
+            hf[n_h] = h * f0;
+            hk[n_h++] = ref_tooth(rise, h * f0) + 2 * ref_log2_q8(h);
+        }
+    for (uint32_t i = 0; i < n_h; i++)
+        for (uint32_t j = n_h - 1; j > i; j--)
+            if (hk[j] > hk[j - 1])
+            {
+                int32_t t = hk[j]; hk[j] = hk[j - 1]; hk[j - 1] = t;
+                uint32_t u = hf[j]; hf[j] = hf[j - 1]; hf[j - 1] = u;
+            }
+    if (n_h > DETECT_DOA_HARMONICS) n_h = DETECT_DOA_HARMONICS;
+    if (!n_h) return;
+
+    int32_t xr[DETECT_DOA_HARMONICS][N_MICS], xi[DETECT_DOA_HARMONICS][N_MICS];
+    for (uint32_t j = 0; j < n_h; j++)
+    {
+        uint64_t s = 0;
+        for (uint32_t m = 0; m < N_MICS; m++)
+        {
+            int32_t re = 0, im = 0;
+            for (uint32_t n = 0; n < N; n++)
+            {
+                int32_t  w = (x[m][end - N + n] * ref_win[n]) >> 15;
+                uint32_t p = n * hf[j] / 8;
+                re += (w * ref_cos(p)) >> DETECT_LOG2_N;
+                im -= (w * ref_sn(p)) >> DETECT_LOG2_N;
+            }
+            xr[j][m] = re;
+            xi[j][m] = im;
+            s += (uint64_t)abs(re) + (uint64_t)abs(im);
+        }
+        int32_t k = s ? ref_shift(s, 13) : 0;
+        for (uint32_t m = 0; m < N_MICS; m++)
+        {
+            xr[j][m] = ref_scale(xr[j][m], k);
+            xi[j][m] = ref_scale(xi[j][m], k);
+        }
+    }
+
+    uint32_t best_p = 0, best_d = 0;
+    uint64_t total = 0;
+    for (uint32_t d = 0; d < DETECT_N_DIRS; d++)
+    {
+        uint32_t pw = 0;
+        for (uint32_t j = 0; j < n_h; j++)
+        {
+            int32_t sr = 0, si = 0;
+            for (uint32_t m = 0; m < N_MICS; m++)
+            {
+                uint32_t p = (uint32_t)(((int32_t)hf[j] * ref_adv[d][m] + 2048) >> 12);
+                sr += (xr[j][m] * ref_cos(p % DETECT_SIN_STEPS) + xi[j][m] * ref_sn(p % DETECT_SIN_STEPS)) >> 15;
+                si += (xi[j][m] * ref_cos(p % DETECT_SIN_STEPS) - xr[j][m] * ref_sn(p % DETECT_SIN_STEPS)) >> 15;
+            }
+            pw += (uint32_t)(sr * sr) + (uint32_t)(si * si);
+        }
+        total += pw;
+        if (pw > best_p) { best_p = pw; best_d = d; }
+    }
+    uint64_t q = total ? (uint64_t)best_p * 256 * DETECT_N_DIRS / total : 0;
+    f->flags |= DETECT_DOA;
+    f->az_deg = (int16_t)(best_d % DETECT_N_AZ * DETECT_AZ_STEP);
+    f->el_deg = (int16_t)(best_d / DETECT_N_AZ * DETECT_EL_STEP);
+    f->doa_q8 = (uint16_t)(q > 0xFFFF ? 0xFFFF : q);
+}
+
+// ---------- Runs ----------
+static int32_t         buf[64 * N_MICS];
+static int32_t         dec8[64 * N_MICS];
+static int16_t         x8[N_MICS][MAX_SECONDS * DETECT_RATE + 64];
+static detect_report_t dev[MAX_REPORTS], ref[MAX_REPORTS];
+static detector_t      det;
+static decimator_t     rdec;
+
+typedef struct {
+    uint32_t n_dev, n_ref, mismatches;
+    uint32_t onsets, early, releases;
+    double   onset_s, release_s;
+    uint32_t active, f0_ok, az_ok, doa;
+    double   f0_err_sum, az_err_sum;
+} result_t;
+
+static double az_diff(double a, double b)
+{
+    double d = fmod(fabs(a - b), 360);
+    return d > 180 ? 360 - d : d;
+}
+
+static result_t run(const scenario_t *sc)
+{
+    result_t res = { 0 };
+    gen_t g;
+    rng = 7;
+    gen_init(&g, sc, FS);
+    detect_init(&det, mics, N_MICS, FS);
+    uint32_t m = FS / DETECT_RATE;
+    decim_init(&rdec, m, N_MICS);
+
+    // Device: pipeline-sized packets; reference input: the same frames, decimated once
+    uint32_t total = (uint32_t)(sc->seconds * FS), n8 = 0;
+    for (uint32_t f = 0; f < total;)
+    {
+        uint32_t n = 47 + (uint32_t)(rand() % 3);
+        if (n > total - f) n = total - f;
+        gen_frames(&g, buf, n);
+        res.n_dev += detect_process(&det, buf, N_MICS, n, &dev[res.n_dev]);
+        uint32_t k = decim_process(&rdec, buf, N_MICS, dec8, N_MICS, n);
+        for (uint32_t i = 0; i < k; i++, n8++)
+            for (uint32_t c = 0; c < N_MICS; c++)
+                x8[c][n8] = (int16_t)(dec8[i * N_MICS + c] >> 16);
+        f += n;
+    }
+
+    // Reference frames from the second hop on; boundary k is decimated output k*HOP - 1
+    static ref_t r;
+    memset(&r, 0, sizeof(r));
+    int16_t *xs[N_MICS];
+    for (uint32_t c = 0; c < N_MICS; c++) xs[c] = x8[c];
+    for (uint32_t k = DETECT_N / DETECT_HOP; k * DETECT_HOP <= n8; k++)
+    {
+        detect_report_t *p = &ref[res.n_ref++];
+        p->frame = (k * DETECT_HOP - 1) * m + 1;
+        ref_frame(&r, xs, k * DETECT_HOP, &p->f);
+    }
+    uint32_t n = res.n_dev < res.n_ref ? res.n_dev : res.n_ref;
+    for (uint32_t i = 0; i < n; i++)
+        if (dev[i].frame != ref[i].frame || memcmp(&dev[i].f, &ref[i].f, sizeof(dev[i].f)))
+        {
+            if (res.mismatches++ < 3)
+                printf("  mismatch report %u (frame %u/%u): flags %02x/%02x f0 %u/%u score %d/%d az %d/%d\n", i,
+                       dev[i].frame, ref[i].frame, dev[i].f.flags, ref[i].f.flags, dev[i].f.f0_q4,
+                       ref[i].f.f0_q4, dev[i].f.score_q8, ref[i].f.score_q8, dev[i].f.az_deg, ref[i].f.az_deg);
+        }
+    if (res.n_dev + 1 < res.n_ref) res.mismatches++;
+
+    // Behaviour, from the device's reports
+    for (uint32_t i = 0; i < res.n_dev; i++)
+    {
+        const detect_features_t *f = &dev[i].f;
+        double t = (double)dev[i].frame / FS;
+        if (f->flags & DETECT_ONSET)
+        {
+            res.onsets++;
+            if (sc->f0 <= 0 || t < sc->on_s) res.early++;
+            else if (res.onsets == 1) res.onset_s = t - sc->on_s;
+        }
+        if (f->flags & DETECT_RELEASE)
+        {
+            res.releases++;
+            res.release_s = t - sc->off_s;
+        }
+        if (sc->f0 <= 0 || !(f->flags & DETECT_ACTIVE) || t < sc->on_s + 0.5 || t > sc->off_s) continue;
+        double f0 = sc->f0 * (1 + 0.01 * sin(2 * M_PI * 0.3 * t));     // d/dt rotor_phase() / 2 pi
+        double ferr = fabs(f->f0_q4 / 16.0 - f0) / f0;
+        res.active++;
+        res.f0_err_sum += ferr;
+        if (ferr <= F0_TOL) res.f0_ok++;
+        if (f->flags & DETECT_DOA)
+        {
+            double e = az_diff(f->az_deg, sc->az);
+            res.doa++;
+            res.az_err_sum += e;
+            if (e <= AZ_TOL_DEG) res.az_ok++;
+        }
+    }
+    return res;
+}
+
+// ---------- Benchmark ----------
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define BENCH_S         10
+#define BENCH_PASSES    5               // per packet, the fastest pass: no preemption or cold caches
+
+static int32_t  bench_in[BENCH_S * FS * N_MICS];
+static uint64_t bench_best[BENCH_S * 1000];
+
+static void bench(uint32_t rate)
+{
+    // Rotor present from 1 s on, so every frame after the onset runs the DOA
+    static const scenario_t sc = { "bench", BENCH_S, 150, 45, 20, -50, 1, BENCH_S, 0, 0, 0 };
+    gen_t g;
+    rng = 3;
+    gen_init(&g, &sc, rate);
+    uint32_t total = BENCH_S * rate, per_ms = rate / 1000, reports = 0;
+    gen_frames(&g, bench_in, total);
+
+    double ns = INFINITY;
+    for (uint32_t pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        detect_init(&det, mics, N_MICS, rate);
+        reports = 0;
+        double t0 = now_ns();
+        for (uint32_t f = 0, i = 0; f < total; f += per_ms, i++)
+        {
+#ifdef HAVE_TSC
+            uint64_t c0 = __rdtsc();
+#endif
+            reports += detect_process(&det, bench_in + f * N_MICS, N_MICS, per_ms, dev);
+#ifdef HAVE_TSC
+            uint64_t c = __rdtsc() - c0;
+            if (!pass || c < bench_best[i]) bench_best[i] = c;
+#endif
+        }
+        ns = fmin(ns, (now_ns() - t0) / total);
+    }
+    uint64_t sum = 0, worst = 0;
+    for (uint32_t i = 0; i < BENCH_S * 1000; i++)
+    {
+        sum += bench_best[i];
+        if (bench_best[i] > worst) worst = bench_best[i];
+    }
+    printf("%6u  %4u  %9.1f  %8.1f  %15llu  %7u  %7.2f\n", rate, N_MICS, (double)sum / total, ns,
+           (unsigned long long)worst, reports, reports * (double)(sizeof(detect_features_t) + 20) / BENCH_S / 1e3);
+}
+
+int main(void)
+{
+    ref_tables();
+    srand(1);
+    int fail = 0;
+
+    // Device constants against their double-precision definition
+    detect_init(&det, mics, N_MICS, FS);
+    bool tables_ok = !memcmp(det.sin, ref_sin, sizeof(ref_sin)) && !memcmp(det.win, ref_win, sizeof(ref_win));
+    for (uint32_t d = 0; d < DETECT_N_DIRS; d++)
+        tables_ok = tables_ok && !memcmp(det.adv[d], ref_adv[d], sizeof(ref_adv[d]));
+    printf("tables     sine, window, steering (%u directions x %u mics): %s\n", DETECT_N_DIRS, N_MICS,
+           tables_ok ? "match" : "MISMATCH");
+    fail |= !tables_ok;
+
+    printf("\nscenario       reports  bit-exact  onsets  false  onset[s]  release[s]  f0 ok  f0 err  az ok  az err\n");
+    for (uint32_t s = 0; s < N_SCENARIOS; s++)
+    {
+        const scenario_t *sc = &scenarios[s];
+        result_t r = run(sc);
+        bool rotor = sc->f0 > 0;
+        bool ok = !r.mismatches && !r.early &&
+                  (!rotor || (r.onsets == 1 && r.onset_s <= ONSET_MAX_S && r.releases == 1 &&
+                              r.release_s <= RELEASE_MAX_S && r.active && r.f0_ok * 10 >= r.active * 9 &&
+                              r.doa && r.az_ok * 10 >= r.doa * 9));
+        fail |= !ok;
+        printf("%-14s %7u  %9s  %6u  %5u", sc->name, r.n_dev, r.mismatches ? "NO" : "yes", r.onsets, r.early);
+        if (rotor)
+            printf("  %8.2f  %10.2f  %4.0f%%  %5.1f%%  %4.0f%%  %5.1f", r.onset_s, r.release_s,
+                   r.active ? 100.0 * r.f0_ok / r.active : 0, r.active ? 100 * r.f0_err_sum / r.active : 0,
+                   r.doa ? 100.0 * r.az_ok / r.doa : 0, r.doa ? r.az_err_sum / r.doa : 0);
+        printf("%s\n", ok ? "" : "  FAIL");
+    }
+    printf("\nrotor: -60 dBFS self-noise per mic; onset within %.1f s, release within %.1f s of the rotor\n"
+           "stopping, f0 within %.0f%% and azimuth within %u deg in 90%% of the active frames\n",
+           ONSET_MAX_S, RELEASE_MAX_S, F0_TOL * 100, AZ_TOL_DEG);
+
+    printf("\n  rate  mics  cyc/frame  ns/frame  worst cyc/packet  reports  kB/s out\n");
+    bench(48000);
+    bench(24000);
+    bench(16000);
+    bench(8000);
+    printf("\nkB/s out: report records (vstream.h) against %.0f kB/s of 24-bit PCM at 48 kHz\n",
+           FS * N_MICS * 3 / 1e3);
+    return fail;
+}
@@ -0,0 +1,262 @@
+// kernels_ref.c — host equivalence test of the sample kernels' C and DSP-extension versions
+//
+// Off the M33, dsp.h builds the _dsp kernels on C models of SMLAD/SMLADX/SSAT, so the
+// host runs both versions of dc_remove, apply_gain, pcm_pack, decim_process and
+// beam_process on the same input and checks their output and state bit for bit. The
+// inputs are mic-like signals (24 bits, tones over noise and DC), full-scale 32-bit noise
+// and the extremes. They come in 47/48/49-frame packets and odd sizes either side of the
+// kernels' blocks, for every channel count up to the kernels' limits, every sample
+// width and output alignment, and gains that saturate. A mismatch prints the first
+// differing sample.
+
+#include "samples.h"
+#include "decimate.h"
+#include "beamform.h"
+#include "array_config.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FS              48000
+#define MAX_CH          16
+#define N_FRAMES        4800                // 100 ms
+#define N_SIGNALS       3
+#define PACK_GUARD      8                   // bytes past the packed samples that must stay untouched
+
+static const char *const signal_names[N_SIGNALS] = { "mic", "full-scale", "extremes" };
+
+static const beam_mic_t mics[ARRAY_N_MICS] = ARRAY_MIC_POSITIONS;
+static const beam_dir_t dirs[BEAM_N_BEAMS] = BEAM_DIRECTIONS;
+
+static int32_t in[N_FRAMES * MAX_CH];
+static int32_t out_c[N_FRAMES * MAX_CH];
+static int32_t out_dsp[N_FRAMES * MAX_CH];
+static uint8_t pack_c[N_FRAMES * MAX_CH * 4 + 4 + PACK_GUARD];
+static uint8_t pack_dsp[N_FRAMES * MAX_CH * 4 + 4 + PACK_GUARD];
+
+static uint32_t rng = 1;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// ---------- Inputs ----------
+static void make_signal(uint32_t kind, uint32_t n_ch)
+{
+    static const int32_t extremes[] = {
+        INT32_MIN, INT32_MIN + 1, -0x40000001, -0x40000000, -1, 0, 1, 0x3FFFFFFF, 0x40000000, INT32_MAX,
+    };
+    for (uint32_t f = 0; f < N_FRAMES; f++)
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            int32_t *x = &in[f * n_ch + c];
+            if (kind == 0)
+            {
+                // Tone per channel at -8 dBFS, noise and a DC offset; the mic's 24 bits
+                double v = 0.4 * sin(2 * M_PI * (150.0 + 310.0 * c) * f / FS) + 0.01 * c - 0.05;
+                *x = (int32_t)(v * 2147483648.0 + (int32_t)(rand32() >> 12) - (1 << 19)) & ~0xFF;
+            }
+            else if (kind == 1)
+                *x = (int32_t)rand32();
+            else
+                *x = extremes[rand32() % (sizeof(extremes) / sizeof(extremes[0]))];
+        }
+}
+
+// Packet sizes: the USB path's 47/48/49, then odd ones either side of the kernels' blocks
+static uint32_t packet(uint32_t k)
+{
+    static const uint32_t sizes[] = { 48, 47, 49, 48, 1, 0, 63, 64, 65, 100, 2, 17, 130 };
+    return sizes[k % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+// ---------- Checks ----------
+typedef struct {
+    const char *name;
+    uint64_t    cases;
+    uint64_t    samples;
+    uint64_t    mismatches;
+} result_t;
+
+static bool same(result_t *r, const char *what, const int32_t *a, const int32_t *b, uint32_t n)
+{
+    r->samples += n;
+    for (uint32_t i = 0; i < n; i++)
+        if (a[i] != b[i])
+        {
+            if (!r->mismatches++)
+                printf("  %s: %s differs at %u: C %d, DSP %d\n", r->name, what, i, a[i], b[i]);
+            return false;
+        }
+    return true;
+}
+
+static void same_state(result_t *r, const char *what, const void *a, const void *b, size_t bytes)
+{
+    if (memcmp(a, b, bytes) && !r->mismatches++)
+        printf("  %s: %s state differs\n", r->name, what);
+}
+
+// ---------- Kernels ----------
+static void check_dc(result_t *r, uint32_t sig)
+{
+    for (uint32_t n_ch = 1; n_ch <= MAX_CH; n_ch++, r->cases++)
+    {
+        make_signal(sig, n_ch);
+        memcpy(out_c, in, sizeof(int32_t) * N_FRAMES * n_ch);
+        memcpy(out_dsp, in, sizeof(int32_t) * N_FRAMES * n_ch);
+        int32_t mean_c[MAX_CH] = { 0 }, mean_dsp[MAX_CH] = { 0 };
+        for (uint32_t f = 0, k = 0; f < N_FRAMES; k++)
+        {
+            uint32_t n = packet(k) < N_FRAMES - f ? packet(k) : N_FRAMES - f;
+            dc_remove_c(&out_c[f * n_ch], n, n_ch, mean_c);
+            dc_remove_dsp(&out_dsp[f * n_ch], n, n_ch, mean_dsp);
+            f += n;
+        }
+        same(r, "output", out_c, out_dsp, N_FRAMES * n_ch);
+        same(r, "mean", mean_c, mean_dsp, n_ch);
+    }
+}
+
+static void check_gain(result_t *r, uint32_t sig)
+{
+    // Unity, mute, inversion, fine steps, boosts that saturate, the int32 extremes
+    static const int32_t gains[] = {
+        1 << GAIN_Q, 0, -(1 << GAIN_Q), 1, 4097, 2048, 3 << GAIN_Q, 64 << GAIN_Q, -(1 << 20), INT32_MAX, INT32_MIN,
+    };
+    uint32_t n_gains = sizeof(gains) / sizeof(gains[0]);
+    for (uint32_t n_ch = 1; n_ch <= MAX_CH; n_ch++)
+        for (uint32_t g0 = 0; g0 < n_gains; g0++, r->cases++)
+        {
+            int32_t gain[MAX_CH];
+            for (uint32_t c = 0; c < n_ch; c++)
+                gain[c] = gains[(g0 + c) % n_gains];
+            make_signal(sig, n_ch);
+            memcpy(out_c, in, sizeof(int32_t) * N_FRAMES * n_ch);
+            memcpy(out_dsp, in, sizeof(int32_t) * N_FRAMES * n_ch);
+            for (uint32_t f = 0, k = 0; f < N_FRAMES; k++)
+            {
+                uint32_t n = packet(k) < N_FRAMES - f ? packet(k) : N_FRAMES - f;
+                apply_gain_c(&out_c[f * n_ch], n, n_ch, gain);
+                apply_gain_dsp(&out_dsp[f * n_ch], n, n_ch, gain);
+                f += n;
+            }
+            same(r, "output", out_c, out_dsp, N_FRAMES * n_ch);
+        }
+}
+
+static void check_pack(result_t *r, uint32_t sig)
+{
+    make_signal(sig, MAX_CH);
+    for (uint32_t bytes = 2; bytes <= 4; bytes++)
+        for (uint32_t n = 0; n <= 2 * 49 * MAX_CH; n = n < 80 ? n + 1 : n + 49)
+            for (uint32_t align = 0; align < 4; align++, r->cases++)
+            {
+                uint32_t len = n * bytes + PACK_GUARD;
+                memset(pack_c, 0xA5, align + len);
+                memset(pack_dsp, 0xA5, align + len);
+                pcm_pack_c(in, pack_c + align, n, bytes);
+                pcm_pack_dsp(in, pack_dsp + align, n, bytes);
+                r->samples += n;
+                if (memcmp(pack_c, pack_dsp, align + len) && !r->mismatches++)
+                    printf("  %s: %u samples of %u bytes at offset %u differ\n", r->name, n, bytes, align);
+            }
+}
+
+static void check_decim(result_t *r, uint32_t sig)
+{
+    static const uint32_t factors[] = { 2, 3, 6 };
+    static decimator_t d_c, d_dsp;
+    for (uint32_t fi = 0; fi < sizeof(factors) / sizeof(factors[0]); fi++)
+        for (uint32_t n_ch = 1; n_ch <= DECIM_MAX_CH; n_ch++, r->cases++)
+        {
+            // Input with a spare channel, as the firmware's mic buffer can have
+            uint32_t stride = n_ch < MAX_CH ? n_ch + 1 : n_ch;
+            make_signal(sig, stride);
+            decim_init(&d_c, factors[fi], n_ch);
+            decim_init(&d_dsp, factors[fi], n_ch);
+            uint32_t o_c = 0, o_dsp = 0;
+            for (uint32_t f = 0, k = 0; f < N_FRAMES; k++)
+            {
+                uint32_t n = packet(k) < N_FRAMES - f ? packet(k) : N_FRAMES - f;
+                o_c += decim_process_c(&d_c, &in[f * stride], stride, &out_c[o_c * n_ch], n_ch, n);
+                o_dsp += decim_process_dsp(&d_dsp, &in[f * stride], stride, &out_dsp[o_dsp * n_ch], n_ch, n);
+                f += n;
+            }
+            if (o_c != o_dsp && !r->mismatches++)
+                printf("  %s: M = %u: %u outputs in C, %u in DSP\n", r->name, factors[fi], o_c, o_dsp);
+            same(r, "output", out_c, out_dsp, o_c * n_ch);
+            same_state(r, "decimator", &d_c, &d_dsp, sizeof(d_c));
+        }
+}
+
+static void check_beam(result_t *r, uint32_t sig)
+{
+    static const uint32_t rates[] = { 48000, 32000, 24000, 16000, 8000 };
+    static beamformer_t b_c, b_dsp;
+    uint32_t stride = ARRAY_N_MICS + BEAM_N_BEAMS;      // mics then beams, as BEAM_OUTPUT_APPEND
+    make_signal(sig, ARRAY_N_MICS);
+    for (uint32_t ri = 0; ri < sizeof(rates) / sizeof(rates[0]); ri++)
+        for (uint32_t n_beams = 1; n_beams <= BEAM_N_BEAMS; n_beams++, r->cases++)
+        {
+            if (beam_init(&b_c, mics, ARRAY_N_MICS, dirs, n_beams, rates[ri]) != 0 ||
+                beam_init(&b_dsp, mics, ARRAY_N_MICS, dirs, n_beams, rates[ri]) != 0)
+            {
+                if (!r->mismatches++) printf("  %s: beam_init failed at %u Hz\n", r->name, rates[ri]);
+                continue;
+            }
+            memset(out_c, 0, sizeof(int32_t) * N_FRAMES * stride);
+            memset(out_dsp, 0, sizeof(int32_t) * N_FRAMES * stride);
+            for (uint32_t f = 0, k = 0; f < N_FRAMES; k++)
+            {
+                uint32_t n = packet(k) < N_FRAMES - f ? packet(k) : N_FRAMES - f;
+                beam_process_c(&b_c, &in[f * ARRAY_N_MICS], ARRAY_N_MICS, &out_c[f * stride], stride,
+                               ARRAY_N_MICS, n);
+                beam_process_dsp(&b_dsp, &in[f * ARRAY_N_MICS], ARRAY_N_MICS, &out_dsp[f * stride], stride,
+                                 ARRAY_N_MICS, n);
+                f += n;
+            }
+            same(r, "output", out_c, out_dsp, N_FRAMES * stride);
+            same_state(r, "beamformer history", b_c.lin_hi, b_dsp.lin_hi, sizeof(b_c.lin_hi));
+            same_state(r, "beamformer history", b_c.lin_lo, b_dsp.lin_lo, sizeof(b_c.lin_lo));
+        }
+}
+
+int main(void)
+{
+    static void (*const checks[])(result_t *, uint32_t) = {
+        check_dc, check_gain, check_pack, check_decim, check_beam,
+    };
+    result_t results[] = {
+        { .name = "dc_remove" }, { .name = "apply_gain" }, { .name = "pcm_pack" },
+        { .name = "decim_process" }, { .name = "beam_process" },
+    };
+    uint32_t n_kernels = sizeof(results) / sizeof(results[0]);
+
+    printf("kernels: %s by default on this target (DSP_KERNELS %d, DSP extension %s)\n\n",
+           DSP_KERNELS ? "_dsp" : "_c", DSP_KERNELS, DSP_HW ? "in hardware" : "modelled in C");
+    for (uint32_t k = 0; k < n_kernels; k++)
+        for (uint32_t s = 0; s < N_SIGNALS; s++)
+            checks[k](&results[k], s);
+
+    int fail = 0;
+    printf("\nkernel          cases    samples  bit-exact (signals:");
+    for (uint32_t s = 0; s < N_SIGNALS; s++)
+        printf(" %s", signal_names[s]);
+    printf(")\n");
+    for (uint32_t k = 0; k < n_kernels; k++)
+    {
+        const result_t *r = &results[k];
+        printf("%-13s  %6llu  %9llu  %s\n", r->name, (unsigned long long)r->cases,
+               (unsigned long long)r->samples, r->mismatches ? "NO" : "yes");
+        if (r->mismatches || !r->cases) fail = 1;
+    }
+    printf("\nresult     %s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
@@ -0,0 +1,206 @@
+// lossless_bench.c — compression ratio and encode cost of lossless.c on array-like signals
+//
+// Synthesises 1 ms blocks (48 frames at 48 kHz, as the bulk stream sends them) for
+// circular arrays of 6..16 mics, radius 50 mm: sources arrive as plane waves with
+// per-mic delays on top of per-mic self-noise. Every block is decoded again and must
+// match bit for bit. Reports the ratio against PCM (payload only and with the
+// vstream.h block header), how many channels fit a Full-Speed bulk pipe at that
+// ratio, and host cycles / ns per encoded sample.
+
+#include "lossless.h"
+#include "vstream.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define FS              48000
+#define BLOCK           48                  // frames per block (1 ms)
+#define N_FRAMES        (2 * FS)
+#define MAX_CH          LOSSLESS_MAX_CHANNELS
+#define RADIUS_M        0.05
+#define SOUND_SPEED     343.0
+#define BULK_BYTES_S    1000000.0           // usable Full-Speed bulk, conservatively
+#define MAX_DELAY       16                  // samples; radius / c at 48 kHz is ~7
+
+static int32_t in[N_FRAMES * MAX_CH];
+static int32_t dec[BLOCK * MAX_CH];
+static uint8_t coded[LOSSLESS_MAX_BYTES(MAX_CH, BLOCK, 24)];
+
+// ---------- Signals ----------
+static uint32_t rng = 1;
+
+static double uniform(void)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return ((rng >> 8) + 0.5) / 16777216.0;
+}
+
+static double gauss(void)
+{
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+static double dbfs(double db) { return pow(10, db / 20); }
+
+typedef enum { SIG_FLOOR, SIG_SPEECH, SIG_MUSIC, SIG_WHITE } signal_t;
+
+static const char *const signal_names[] = {
+    "room floor", "speech", "music", "white -20",
+};
+
+// Arrival advance of a plane wave from azimuth az at mic m of n, in samples
+static double advance(uint32_t m, uint32_t n, double az)
+{
+    double phi = 2 * M_PI * m / n;
+    return RADIUS_M * cos(phi - az) / SOUND_SPEED * FS;
+}
+
+// Low-passed noise source with integer per-mic delays
+static void add_noise_source(uint32_t n_ch, double az, double level, double pole)
+{
+    static double src[N_FRAMES + 2 * MAX_DELAY];
+    double y = 0, g = level * sqrt(1 - pole * pole) / (1 - pole) * (1 - pole);
+    for (uint32_t i = 0; i < N_FRAMES + 2 * MAX_DELAY; i++)
+    {
+        y = pole * y + (1 - pole) * gauss();
+        src[i] = y * g / sqrt((1 - pole) / (1 + pole));
+    }
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        int32_t d = (int32_t)lround(advance(c, n_ch, az));
+        for (uint32_t i = 0; i < N_FRAMES; i++)
+            in[i * n_ch + c] += (int32_t)(src[i + MAX_DELAY + d] * 2147483648.0);
+    }
+}
+
+// Voiced source: f0 with harmonics falling 6 dB/oct, 4 Hz syllable envelope, exact delays
+static void add_voice(uint32_t n_ch, double az, double level, double f0)
+{
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        double adv = advance(c, n_ch, az);
+        for (uint32_t i = 0; i < N_FRAMES; i++)
+        {
+            double t = (i + adv) / FS, v = 0;
+            for (int h = 1; h <= 20 && h * f0 < FS / 2; h++)
+                v += sin(2 * M_PI * h * f0 * t + h) / h;
+            double env = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+            in[i * n_ch + c] += (int32_t)(level * 0.5 * env * env * v * 2147483648.0);
+        }
+    }
+}
+
+static void add_self_noise(uint32_t n_ch, double level)
+{
+    for (uint32_t i = 0; i < N_FRAMES * n_ch; i++)
+        in[i] += (int32_t)(level * gauss() * 2147483648.0);
+}
+
+static void synth(signal_t sig, uint32_t n_ch)
+{
+    memset(in, 0, sizeof(in[0]) * N_FRAMES * n_ch);
+    rng = 12345;
+    switch (sig)
+    {
+    case SIG_FLOOR:
+        add_noise_source(n_ch, 0.7, dbfs(-65), 0.99);
+        break;
+    case SIG_SPEECH:
+        add_noise_source(n_ch, 0.7, dbfs(-65), 0.99);
+        add_voice(n_ch, 0.5, dbfs(-30), 130);
+        break;
+    case SIG_MUSIC:
+        add_noise_source(n_ch, 0.7, dbfs(-30), 0.95);
+        add_noise_source(n_ch, 2.5, dbfs(-30), 0.9);
+        add_voice(n_ch, 4.0, dbfs(-20), 220);
+        break;
+    case SIG_WHITE:
+        add_self_noise(n_ch, dbfs(-20));
+        break;
+    }
+    add_self_noise(n_ch, dbfs(-90));                 // mic self-noise, independent per mic
+    for (uint32_t i = 0; i < N_FRAMES * n_ch; i++)
+        in[i] &= ~0xFF;                             // 24-bit mics, left-justified
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static const uint32_t channels[] = { 6, 12, 16 };
+    static const uint32_t widths[] = { 16, 24 };
+    int fail = 0;
+
+    printf("signal       ch  bits  ratio  +header  kB/s   ch/bulk  roundtrip  cyc/sample  ns/sample\n");
+
+    for (uint32_t s = 0; s <= SIG_WHITE; s++)
+        for (uint32_t ci = 0; ci < sizeof(channels) / sizeof(channels[0]); ci++)
+        {
+            uint32_t n_ch = channels[ci];
+            synth((signal_t)s, n_ch);
+
+            for (uint32_t wi = 0; wi < sizeof(widths) / sizeof(widths[0]); wi++)
+            {
+                uint32_t bits = widths[wi];
+                uint64_t payload = 0, samples = 0;
+                uint32_t mismatches = 0;
+
+                // Ratio and round trip
+                for (uint32_t f = 0; f + BLOCK <= N_FRAMES; f += BLOCK)
+                {
+                    const int32_t *blk = &in[f * n_ch];
+                    uint32_t len = lossless_encode(blk, n_ch, BLOCK, bits, coded, sizeof(coded));
+                    if (!len || lossless_decode(coded, len, n_ch, BLOCK, bits, dec) != len)
+                    {
+                        mismatches++;
+                        continue;
+                    }
+                    for (uint32_t i = 0; i < BLOCK * n_ch; i++)
+                        if (dec[i] != blk[i] >> (32 - bits)) { mismatches++; break; }
+                    payload += len;
+                    samples += BLOCK * n_ch;
+                }
+                uint32_t blocks = N_FRAMES / BLOCK;
+                double raw = (double)samples * bits / 8;
+                double with_hdr = payload + (double)blocks * sizeof(vstream_block_t);
+                double bytes_s = with_hdr / ((double)N_FRAMES / FS);
+
+                // Timing: encode only, whole signal, 5 passes
+                uint32_t reps = 5;
+                double t0 = now_ns();
+#ifdef HAVE_TSC
+                uint64_t c0 = __rdtsc();
+#endif
+                for (uint32_t r = 0; r < reps; r++)
+                    for (uint32_t f = 0; f + BLOCK <= N_FRAMES; f += BLOCK)
+                        lossless_encode(&in[f * n_ch], n_ch, BLOCK, bits, coded, sizeof(coded));
+#ifdef HAVE_TSC
+                double cyc = (double)(__rdtsc() - c0) / (reps * samples);
+#else
+                double cyc = 0;
+#endif
+                double ns = (now_ns() - t0) / (reps * samples);
+
+                printf("%-11s  %2u  %4u  %5.2f  %7.2f  %5.0f  %7.0f  %9s  %10.1f  %9.2f\n",
+                       signal_names[s], n_ch, bits, raw / payload, raw / with_hdr, bytes_s / 1000,
+                       floor(BULK_BYTES_S / (bytes_s / n_ch)), mismatches ? "FAIL" : "ok", cyc, ns);
+                if (mismatches) fail = 1;
+            }
+        }
+
+    printf("\nratio = PCM bytes / coded bytes; +header includes the %zu-byte vstream block header;\n"
+           "ch/bulk = channels at this ratio in %.0f kB/s of Full-Speed bulk\n",
+           sizeof(vstream_block_t), BULK_BYTES_S / 1000);
+    return fail;
+}
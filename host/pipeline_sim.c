@@ -0,0 +1,791 @@
+// pipeline_sim.c — runs the real firmware on simulated hardware and checks the USB stream
+//
+// main.c, capture.c, pipeline.c, audio_ctrl.c, usb_descriptors.c and the DSP modules
+// are built unchanged against host/sim. Synthetic I2S frames (with clock drift and
+// edge jitter) go through the PIO/DMA model into the capture ring; both cores run
+// as coroutines; a simulated host enumerates, selects the format and collects one
+// IN packet per SOF. Every sample carries its channel and frame number, so the
+// stream is checked sample by sample, and the report covers per-packet processing
+// time, ring/queue occupancy, drops, latency and the delivered rate. Telemetry
+// snapshots are read over the vendor interface at warm-up and at the end and checked
+// against what the simulated host saw (--telemetry prints them). --bulk 1 starts the
+// vendor bulk stream instead of an audio alt setting and runs the same checks on the
+// decoded lossless blocks; --bulk-bw limits what the host reads per frame, --bulk-raw
+// saves the stream in vstream_rec's raw format. --stamps 1 asks for SOF-stamped blocks
+// and checks every stamp against the frames the PIO had clocked out at that SOF.
+//
+// Several runs make devices on one simulated bus for vstream_merge: --boot-ms puts
+// this device's boot that far into bus time (USB frame number and test signal follow),
+// --bulk-start-ms delays START, and --source tone feeds every channel the same test
+// tones of bus time instead of the numbered pattern (so samples are not checked).
+// --sof-latency-us runs core 0 up to that long (uniform, at most 100) after each SOF,
+// as tud_task does on the board, while the I2S frames keep coming.
+//
+// --detect 1 starts the bulk stream in event mode. With --source drone the mics hear
+// self-noise and, from 40% to 70% of the run, a rotor as a plane wave (DRONE_* below):
+// there must be one detection, starting and ending in time, with the rotor's f0 and
+// direction, audio from before the rotor starts up to the release, and no audio outside it.
+// Formats whose pre-trigger ring cannot cover the onset refuse START (pipeline_detect_fits()).
+//
+//   pipeline_sim [--seconds S] [--ppm P] [--jitter-ns J] [--rate HZ] [--bits 16|24]
+//                [--stall-every MS --stall-us US] [--preempt N] [--seed N] [--telemetry 1]
+//                [--bulk 1 [--bulk-bw BYTES_PER_MS] [--bulk-raw FILE] [--stamps 1]
+//                 [--bulk-start-ms MS] [--detect 1]] [--boot-ms MS] [--source pattern|tone|drone]
+//                [--sof-latency-us US]
+
+#include "sim.h"
+#include "capture.h"
+#include "pipeline.h"
+#include "tusb.h"
+#include "hardware/clocks.h"
+#include "telemetry_decode.h"
+#include "vstream_decode.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WARMUP_NS           1000000000ull
+#define PUSH_HIST           65536           // I2S frame timestamps kept for latency
+#define SOF_HIST            4096            // frames clocked out at each SOF, for the stamps
+#define PPM_TOLERANCE       5.0             // plus two USB frames over the window (coarse at low rates)
+#define PPM_MIN_WINDOW_S    5.0             // the drift servo needs a few windows to settle
+#define DRIFT_PPM_TOLERANCE 10.0            // drift_ppm(): one frame per window is ~20 ppm, IIR 1/8
+#define DRIFT_PPM_PER_US    0.5             // a late SOF callback moves a ~1 s window by 1 ppm/us, IIR halves it
+#define SOF_LATENCY_MAX_US  100             // the drift servo reads its frame counts there too
+#define BULK_BW_FS          (19 * 64)       // bytes per frame a Full-Speed host can read at best
+#define DRONE_F0            150.0           // Hz, 12 harmonics falling 3 dB per octave
+#define DRONE_AZ            120.0
+#define DRONE_EL            20.0
+#define DRONE_DBFS          -60.0           // fundamental; self-noise is DRONE_DBFS RMS too
+#define DRONE_ON            0.4             // of the run
+#define DRONE_OFF           0.7
+#define DETECT_ONSET_MAX_S  0.5
+#define DETECT_RELEASE_MAX_S 1.5            // the hold, plus the level decay
+#define DETECT_AZ_TOL       15.0
+
+int firmware_main(void);                    // main.c, renamed for the simulation build
+
+// ---------- Options ----------
+static double   opt_seconds  = 10;
+static double   opt_ppm      = 100;
+static double   opt_jitter   = 2000;        // ns RMS on every I2S frame edge
+static uint32_t opt_rate     = AUDIO_DEFAULT_SAMPLE_RATE;
+static uint32_t opt_bits     = 24;
+static uint32_t opt_stall_ms = 0;
+static uint32_t opt_stall_us = 0;
+static uint32_t opt_preempt  = 2;
+static uint32_t opt_seed     = 1;
+static bool     opt_telemetry = false;
+static bool     opt_bulk     = false;
+static uint32_t opt_bulk_bw  = BULK_BW_FS;
+static const char *opt_bulk_raw = NULL;
+static bool     opt_stamps   = false;
+static uint32_t opt_bulk_start_ms = 0;
+static uint32_t opt_boot_ms  = 0;
+static uint32_t opt_sof_latency_us = 0;     // max, uniform: the SOF callback runs that late
+static bool     opt_detect   = false;
+static const char *opt_source = "pattern";
+
+// ---------- Synthetic source ----------
+// Top 16 bits: bus channel (4) + frame bits 0..11; low 8 bits: frame bits 12..19.
+static uint32_t pattern(uint32_t ch, uint32_t frame)
+{
+    return (ch & 15u) << 20 | (frame & 0xFFFu) << 8 | (frame >> 12 & 0xFFu);
+}
+
+// Bus channel behind each mic channel (TDM: the slot map; past the bus = silence)
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+static const uint8_t bus_map[PIPELINE_N_MICS] = TDM_CHANNEL_MAP;
+#define BUS_CHANNEL(c)      bus_map[c]
+#define BUS_N_CHANNELS      TDM_N_BUS_CHANNELS
+#else
+#define BUS_CHANNEL(c)      (c)
+#define BUS_N_CHANNELS      I2S3_N_CHANNELS
+#endif
+
+// Test tones of bus time, the same on every channel (vstream_merge --check 1000)
+static uint32_t tone(uint32_t ch, uint32_t frame)
+{
+    (void)ch; (void)frame;
+    double t = (double)sim_now_ns() * 1e-9 + opt_boot_ms * 1e-3;
+    double v = 0.25 * sin(2 * M_PI * 1000 * t) + 0.15 * sin(2 * M_PI * 313 * t + 1) +
+               0.10 * sin(2 * M_PI * 2333 * t + 2) + 0.05 * sin(2 * M_PI * 4441 * t + 3);
+    return (uint32_t)lrint(v * 8388607.0) & 0xFFFFFFu;
+}
+
+// Rotor plus per-mic noise (--source drone): each mic hears the rotor's phase at its
+// arrival time, per the array geometry the firmware's DOA steers with
+static const beam_mic_t drone_mics[PIPELINE_N_MICS] = ARRAY_MIC_POSITIONS;
+static double           drone_adv[BUS_N_CHANNELS];  // arrival advance per bus channel, s
+static int32_t          drone_mic[BUS_N_CHANNELS];  // mic behind it, -1 = none
+
+static double rad(double deg) { return deg * M_PI / 180; }
+static double gauss(void);
+
+static void drone_init(void)
+{
+    for (uint32_t b = 0; b < BUS_N_CHANNELS; b++)
+        drone_mic[b] = -1;
+    for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+        if (BUS_CHANNEL(c) < BUS_N_CHANNELS)
+        {
+            const beam_mic_t *m = &drone_mics[c];
+            drone_mic[BUS_CHANNEL(c)] = (int32_t)c;
+            drone_adv[BUS_CHANNEL(c)] = (m->x * cos(rad(DRONE_EL)) * cos(rad(DRONE_AZ)) +
+                                         m->y * cos(rad(DRONE_EL)) * sin(rad(DRONE_AZ)) +
+                                         m->z * sin(rad(DRONE_EL))) / BEAM_SOUND_SPEED;
+        }
+}
+
+static uint32_t drone(uint32_t ch, uint32_t frame)
+{
+    (void)frame;
+    if (ch >= BUS_N_CHANNELS || drone_mic[ch] < 0) return 0;
+    double t = (double)sim_now_ns() * 1e-9, a = pow(10, DRONE_DBFS / 20), v = a * gauss();
+    if (t >= DRONE_ON * opt_seconds && t < DRONE_OFF * opt_seconds)
+    {
+        double p = 2 * M_PI * DRONE_F0 * (t + drone_adv[ch]);
+        for (uint32_t h = 1; h <= 12; h++)
+            v += a / sqrt(h) * sin(h * p + h);
+    }
+    return (uint32_t)lrint(v * 8388607.0) & 0xFFFFFFu;
+}
+
+static uint32_t expect(uint32_t c, uint32_t frame)
+{
+    return BUS_CHANNEL(c) < BUS_N_CHANNELS ? pattern(BUS_CHANNEL(c), frame) : 0;
+}
+
+static uint64_t push_ns[PUSH_HIST];
+
+// ---------- Stream checker ----------
+typedef struct {
+    uint64_t packets, frames, silence_packets;
+    uint32_t size_hist[4];                  // nominal - 1, nominal, nominal + 1, other
+    uint64_t samples, bad_samples;
+    uint64_t gaps, lost_frames, repeats, silence_frames;
+    int64_t  prev_frame;
+    double   lat_min, lat_max, lat_sum;
+    uint64_t lat_n;
+    uint64_t win_frames;                    // USB frames delivered after warm-up
+} check_t;
+
+static check_t  chk = { .prev_frame = -1, .lat_min = 1e18 };
+static uint32_t usb_bytes, usb_nominal;
+static uint32_t ref_ch;                     // first mic channel with a bus channel behind it
+static bool     sample_check;
+static bool     tone_source;                // --source tone: every channel crosses zero together
+static bool     drone_source;               // --source drone
+static bool     warm;
+
+static uint32_t rd_sample(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (uint32_t b = 0; b < usb_bytes; b++)
+        v |= (uint32_t)p[b] << (8 * b);
+    return v;
+}
+
+// One USB frame: the mic samples as sent (usb_bytes wide). Returns false if the frame
+// is silent; *frame is its I2S frame number, or -1 if the stream is not sample-checked.
+static bool check_frame(const uint32_t *v, int64_t *frame)
+{
+    uint32_t shift = 24 - 8 * usb_bytes;
+    // What survives the bus (16-bit TDM slots carry the top 16 bits) and the USB depth
+    uint32_t bus_bits = CAPTURE_DATA_BITS < 24 ? CAPTURE_DATA_BITS : 24;
+    uint32_t keep = 0xFFFFFFu << (24 - bus_bits) & 0xFFFFFFu;
+    bool     wide = usb_bytes >= 3 && bus_bits >= 24;
+    uint32_t idx_mask = (1u << (wide ? 20 : 12)) - 1;
+
+    *frame = -1;
+    bool silent = true;
+    for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+        if (v[c]) silent = false;
+    if (silent)
+    {
+        if (warm && !tone_source) chk.silence_frames++;
+        return false;
+    }
+    if (!sample_check) return true;
+
+    // Frame number from the reference channel, widened to the most recent frame with those bits
+    uint32_t r  = v[ref_ch] << shift;
+    uint32_t lo = (r >> 8 & 0xFFFu) | (wide ? (r & 0xFFu) << 12 : 0);
+    uint32_t last = sim_pio_frames() - 1;
+    int64_t  full = (int64_t)last - ((last - lo) & idx_mask);
+
+    for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+    {
+        chk.samples++;
+        if (v[c] != (expect(c, (uint32_t)full) & keep) >> shift)
+            chk.bad_samples++;
+    }
+
+    if (chk.prev_frame >= 0 && warm)
+    {
+        if (full > chk.prev_frame + 1) { chk.gaps++; chk.lost_frames += (uint64_t)(full - chk.prev_frame - 1); }
+        else if (full <= chk.prev_frame) chk.repeats++;
+    }
+    chk.prev_frame = full;
+
+    double lat = (double)(sim_now_ns() - push_ns[full % PUSH_HIST]) / 1000.0;
+    if (lat < chk.lat_min) chk.lat_min = lat;
+    if (lat > chk.lat_max) chk.lat_max = lat;
+    chk.lat_sum += lat;
+    chk.lat_n++;
+    *frame = full;
+    return true;
+}
+
+static void count_packet(uint32_t n)
+{
+    chk.packets++;
+    chk.frames += n;
+    if (warm) chk.win_frames += n;
+    chk.size_hist[n == usb_nominal - 1 ? 0 : n == usb_nominal ? 1 : n == usb_nominal + 1 ? 2 : 3]++;
+}
+
+// Iso IN packet
+static void on_packet(const uint8_t *data, uint16_t len)
+{
+    uint32_t frame_bytes = PIPELINE_N_CHANNELS * usb_bytes;
+    uint32_t n = len / frame_bytes;
+    count_packet(n);
+
+    bool all_silent = true;
+    for (uint32_t f = 0; f < n; f++)
+    {
+        uint32_t v[PIPELINE_N_MICS];
+        int64_t  full;
+        for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+            v[c] = rd_sample(data + f * frame_bytes + c * usb_bytes);
+        if (check_frame(v, &full)) all_silent = false;
+    }
+    if (all_silent) chk.silence_packets++;
+}
+
+// ---------- Event mode ----------
+// Reports are one per analysed frame; the first audio block must come from before the
+// rotor started, and the audio must stop after the release.
+static uint64_t ev_onsets, ev_releases, ev_doa, ev_doa_ok, ev_f0_ok, ev_active;
+static int64_t  ev_onset_frame = -1, ev_release_frame = -1;
+static int64_t  ev_first_audio = -1, ev_last_audio = -1;    // stream frames
+static uint32_t ev_report_frames;                           // per report
+static double   ev_start_s;                                 // bus time of START: stream frame 0
+
+static double ev_time(int64_t frame)
+{
+    return ev_start_s + (double)frame / opt_rate;
+}
+
+static void on_report(void *ctx, const vstream_block_t *h, const detect_features_t *f)
+{
+    (void)ctx;
+    ev_report_frames = h->n_frames;
+    if (f->flags & DETECT_ONSET && ev_onsets++ == 0) ev_onset_frame = h->frame;
+    if (f->flags & DETECT_RELEASE && ev_releases++ == 0) ev_release_frame = h->frame;
+    double t = ev_time(h->frame);
+    if (!(f->flags & DETECT_ACTIVE) || t < DRONE_ON * opt_seconds + 0.5 || t > DRONE_OFF * opt_seconds) return;
+    ev_active++;
+    if (fabs(f->f0_q4 / 16.0 - DRONE_F0) <= 0.03 * DRONE_F0) ev_f0_ok++;
+    if (f->flags & DETECT_DOA)
+    {
+        double d = fabs(remainder(f->az_deg - DRONE_AZ, 360));
+        ev_doa++;
+        if (d <= DETECT_AZ_TOL) ev_doa_ok++;
+    }
+}
+
+// ---------- Bulk stream ----------
+// Decoded blocks go through the same frame check; on top, the block header's frame
+// number must stay a fixed offset from the I2S frame number the samples carry, across
+// any frames the device skipped. A stamp's SOF position must be the number of frames
+// the PIO had clocked out at that SOF, in the same stream numbering.
+static vstream_decoder_t vdec;
+static int64_t           blk_offset = INT64_MIN;
+static uint64_t          blk_misplaced;         // blocks whose header frame disagrees
+static uint64_t          blk_header_bad;        // channels/bits/size not what was started
+static uint32_t          sof_frames[SOF_HIST];  // sim_pio_frames() when core 0 took SOF n
+static uint64_t          sofs;                  // since boot
+static uint64_t          sofs_taken;            // by core 0 (later, with --sof-latency-us)
+static uint64_t          stamps_checked, stamps_bad;
+
+// off: this block's I2S frame minus header frame (an underrun's padding moves it)
+static void check_stamp(const vstream_block_t *h, const vstream_stamp_t *st, int64_t off)
+{
+    // The firmware extends the first frame number it sees, (boot + 1) & 0x7FF, by one per SOF
+    uint64_t n = st->sof - (((opt_boot_ms + 1) & 0x7FFu) - 1);
+    if (!sample_check || off == INT64_MIN || n > sofs_taken || sofs_taken - n >= SOF_HIST) return;
+    double pos = (double)h->frame + st->pos_q8 / 256.0;
+    double truth = (double)sof_frames[n % SOF_HIST] - (double)off;
+    stamps_checked++;
+    if (fabs(pos - truth) > 1.0 / 256) stamps_bad++;
+}
+
+static void on_sof_taken(void)
+{
+    sof_frames[++sofs_taken % SOF_HIST] = sim_pio_frames();
+}
+
+static void on_block(void *ctx, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                     const int32_t *s, uint32_t lost)
+{
+    (void)ctx; (void)lost;
+    if (h->n_channels != PIPELINE_N_CHANNELS || h->bits != 8 * usb_bytes) { blk_header_bad++; return; }
+    count_packet(h->n_frames);
+    if (ev_first_audio < 0) ev_first_audio = h->frame;
+    ev_last_audio = h->frame + h->n_frames;
+
+    // Event mode sends the pre-trigger late: start-up padding is judged by when it was
+    // captured, not when it arrives
+    bool was_warm = warm;
+    if (opt_detect && h->frame < (uint64_t)opt_rate * WARMUP_NS / 1000000000ull) warm = false;
+
+    bool all_silent = true, misplaced = false;
+    int64_t first_off = INT64_MIN;
+    uint32_t mask = (1u << h->bits) - 1;
+    for (uint32_t f = 0; f < h->n_frames; f++)
+    {
+        uint32_t v[PIPELINE_N_MICS];
+        int64_t  full;
+        for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+            v[c] = (uint32_t)s[f * h->n_channels + c] & mask;
+        if (!check_frame(v, &full)) continue;
+        all_silent = false;
+        if (full < 0) continue;
+
+        int64_t off = full - (int64_t)(h->frame + f);
+        if (first_off == INT64_MIN) first_off = off;
+        if (blk_offset == INT64_MIN) blk_offset = off;
+        if (off != blk_offset) misplaced = true;
+    }
+    warm = was_warm;
+    if (all_silent) chk.silence_packets++;
+    if (misplaced) blk_misplaced++;
+    if (stamp) check_stamp(h, stamp, first_off);
+}
+
+static FILE *bulk_raw;
+
+static void on_bulk(const uint8_t *data, uint16_t len)
+{
+    if (bulk_raw) fwrite(data, 1, len, bulk_raw);
+    vstream_decoder_feed(&vdec, data, len);
+}
+
+// ---------- Occupancy ----------
+typedef struct { uint32_t min, max; double sum; uint64_t n; } occ_t;
+
+static void occ_add(occ_t *o, uint32_t v)
+{
+    if (!o->n || v < o->min) o->min = v;
+    if (!o->n || v > o->max) o->max = v;
+    o->sum += v;
+    o->n++;
+}
+
+// ---------- Jitter ----------
+static uint32_t rng = 1;
+
+static double uniform(void)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return ((rng >> 8) + 0.5) / 16777216.0;
+}
+
+static double gauss(void)
+{
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: pipeline_sim [--seconds S] [--ppm P] [--jitter-ns J] [--rate HZ] [--bits 16|24]\n"
+                    "                    [--stall-every MS --stall-us US] [--preempt N] [--seed N] [--telemetry 1]\n"
+                    "                    [--bulk 1 [--bulk-bw BYTES_PER_MS] [--bulk-raw FILE] [--stamps 1]\n"
+                    "                     [--bulk-start-ms MS] [--detect 1]] [--boot-ms MS] [--source pattern|tone|drone]\n"
+                    "                    [--sof-latency-us US]\n");
+    exit(1);
+}
+
+static void parse(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) usage();
+        const char *k = argv[i], *v = argv[++i];
+        if      (!strcmp(k, "--seconds"))     opt_seconds  = atof(v);
+        else if (!strcmp(k, "--ppm"))         opt_ppm      = atof(v);
+        else if (!strcmp(k, "--jitter-ns"))   opt_jitter   = atof(v);
+        else if (!strcmp(k, "--rate"))        opt_rate     = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--bits"))        opt_bits     = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--stall-every")) opt_stall_ms = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--stall-us"))    opt_stall_us = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--preempt"))     opt_preempt  = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--seed"))        opt_seed     = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--telemetry"))   opt_telemetry = atoi(v) != 0;
+        else if (!strcmp(k, "--bulk"))        opt_bulk     = atoi(v) != 0;
+        else if (!strcmp(k, "--bulk-bw"))     opt_bulk_bw  = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--bulk-raw"))    opt_bulk_raw = v;
+        else if (!strcmp(k, "--stamps"))      opt_stamps   = atoi(v) != 0;
+        else if (!strcmp(k, "--bulk-start-ms")) opt_bulk_start_ms = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--boot-ms"))     opt_boot_ms  = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--source"))      opt_source   = v;
+        else if (!strcmp(k, "--sof-latency-us")) opt_sof_latency_us = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--detect"))      opt_detect   = atoi(v) != 0;
+        else usage();
+    }
+    if (opt_bits != 16 && opt_bits != 24) usage();
+    if (strcmp(opt_source, "pattern") && strcmp(opt_source, "tone") && strcmp(opt_source, "drone")) usage();
+    if (opt_detect && !opt_bulk) usage();
+    if (opt_bulk_start_ms * 1e-3 + 1 > opt_seconds) usage();
+    if (opt_sof_latency_us > SOF_LATENCY_MAX_US) usage();
+}
+
+static void core0_entry(void)
+{
+    firmware_main();
+}
+
+static bool snapshot(telemetry_snapshot_t *t)
+{
+    uint8_t buf[1024];
+    int n = sim_usb_vendor_in(TELEMETRY_REQ_SNAPSHOT, buf, sizeof(buf));
+    return n >= 0 && telemetry_decode(buf, n, t) == 0;
+}
+
+static bool stream_info(vstream_info_t *v)
+{
+    return sim_usb_vendor_in(VSTREAM_REQ_INFO, v, sizeof(*v)) == (int)sizeof(*v);
+}
+
+static double us(double cycles)
+{
+    return cycles * 1e6 / SIM_CLK_SYS_HZ;
+}
+
+int main(int argc, char **argv)
+{
+    parse(argc, argv);
+    rng = opt_seed;
+    sim_set_preempt(PIPELINE_DUAL_CORE ? opt_preempt : 0, opt_seed);
+    tone_source = !strcmp(opt_source, "tone");
+    drone_source = !strcmp(opt_source, "drone");
+    if (drone_source) drone_init();
+    sim_pio_set_source(drone_source ? drone : tone_source ? tone : pattern);
+    sim_usb_set_frame(opt_boot_ms);
+    sim_usb_set_packet_sink(on_packet);
+    vstream_decoder_init(&vdec, on_block, NULL);
+    vdec.report_fn = on_report;
+    sim_usb_set_bulk_sink(on_bulk, opt_bulk_bw);
+    sim_usb_set_sof_hook(on_sof_taken);
+
+    // Boot: core0 runs main() up to its first tud_task()
+    sim_core0_start(core0_entry);
+    sim_run_core(0);
+    pipeline_set_stages(PIPELINE_STAGES_REQUIRED);      // raw samples reach USB untouched
+
+    // Enumerate and select the format
+    if (sim_usb_mount() != 0)
+    {
+        fprintf(stderr, "descriptor check failed\n");
+        return 1;
+    }
+    uint32_t rates[8], n_rates = sim_usb_get_rates(rates, 8);
+    uint8_t alt = opt_bits == 16 ? AUDIO_ALT_16BIT : AUDIO_ALT_24BIT;
+    usb_bytes = opt_bulk ? opt_bits / 8 : sim_usb_alt_bytes(alt);
+    if (!usb_bytes)
+    {
+        fprintf(stderr, "no %u-bit alt setting: %u channels exceed an iso packet, use --bulk 1\n",
+                opt_bits, PIPELINE_N_CHANNELS);
+        return 1;
+    }
+    while (ref_ch + 1 < PIPELINE_N_MICS && BUS_CHANNEL(ref_ch) >= BUS_N_CHANNELS) ref_ch++;
+    usb_nominal = opt_rate / 1000;
+    sample_check = !tone_source && !drone_source && AUDIO_CAPTURE_RATE(opt_rate) == opt_rate;
+    if (opt_rate != AUDIO_DEFAULT_SAMPLE_RATE) sim_usb_set_rate(opt_rate);
+    uint64_t start_ns = opt_bulk ? opt_bulk_start_ms * 1000000ull : 0;
+    ev_start_s = start_ns * 1e-9;
+    bool     started = !opt_bulk;
+    if (opt_bulk)
+        printf("config     %u Hz, %u-bit lossless%s%s over vendor bulk (host reads <= %u B/ms), %u ch, %s core, %.1f s\n",
+               opt_rate, opt_bits, opt_stamps ? " SOF-stamped" : "", opt_detect ? " event mode" : "", opt_bulk_bw,
+               PIPELINE_N_CHANNELS,
+               PIPELINE_DUAL_CORE ? "dual" : "single", opt_seconds);
+    else
+    {
+        sim_usb_set_alt(alt);
+        printf("config     %u Hz, %u-bit (alt %u, wMaxPacketSize %u), %u ch, %s core, %.1f s\n",
+               opt_rate, opt_bits, alt, sim_usb_ep_size(alt), PIPELINE_N_CHANNELS,
+               PIPELINE_DUAL_CORE ? "dual" : "single", opt_seconds);
+    }
+    printf("clock      %+.1f ppm crystal, %.0f ns RMS edge jitter", opt_ppm, opt_jitter);
+    if (opt_stall_ms) printf(", core1 stalls %u us every %u ms", opt_stall_us, opt_stall_ms);
+    if (opt_boot_ms || start_ns) printf(", boot at bus time %u ms, START at +%u ms", opt_boot_ms, opt_bulk_start_ms);
+    if (drone_source)
+        printf(", rotor %.0f Hz from az %.0f el %.0f at %.1f .. %.1f s", DRONE_F0, DRONE_AZ, DRONE_EL,
+               DRONE_ON * opt_seconds, DRONE_OFF * opt_seconds);
+    else if (tone_source) printf(", test tones");
+    if (opt_sof_latency_us) printf(", SOF handled 0..%u us late", opt_sof_latency_us);
+    printf("\nrates      ");
+    for (uint32_t i = 0; i < n_rates; i++) printf("%u ", rates[i]);
+    printf("(GET RANGE)\n");
+
+    // ---------- Event loop: I2S frame edges and SOFs in time order ----------
+    uint64_t end_ns = (uint64_t)(opt_seconds * 1e9);
+    uint64_t sof_ns = 1000000;
+    uint64_t svc_ns = 0;                                // core 0 handles the last SOF then
+    bool     svc_pending = false;
+    double   frame_base = 0;
+    bool     pio_was_running = false;
+    double   fs_true = 0;
+    double   jit = NAN;                                 // next frame edge's
+    occ_t    occ_ring = { 0 }, occ_queue = { 0 };
+    uint32_t buffered_warm = 0, decim = AUDIO_CAPTURE_RATE(opt_rate) / opt_rate;
+    capture_stats_t cap_warm = { 0 };
+    uint32_t fifo_warm = 0, empty_warm = 0;
+    uint64_t packets_warm = 0, sofs_warm = 0;
+    telemetry_snapshot_t tel_warm, tel_end;
+    bool     tel_ok = true;
+
+    while (sim_now_ns() < end_ns || svc_pending)
+    {
+        if (sim_pio_running() && !pio_was_running)
+            frame_base = (double)sim_now_ns();          // (re)started: bus clock restarts
+        pio_was_running = sim_pio_running();
+        fs_true = sim_pio_sample_rate() * (1 + opt_ppm * 1e-6);
+        double period = 1e9 / fs_true;
+
+        if (isnan(jit))                                 // once per edge, whatever comes first
+        {
+            jit = opt_jitter * gauss();
+            if (jit >  period / 3) jit =  period / 3;
+            if (jit < -period / 3) jit = -period / 3;
+        }
+        double t_frame = sim_pio_running() ? frame_base + period + jit : 1e30;
+
+        if (t_frame < (double)(svc_pending ? svc_ns : sof_ns))
+        {
+            frame_base += period;
+            jit = NAN;
+            sim_set_time_ns((uint64_t)t_frame);
+            push_ns[sim_pio_frames() % PUSH_HIST] = sim_now_ns();
+            sim_pio_clock_frame();
+        }
+        else if (!svc_pending)
+        {
+            sim_set_time_ns(sof_ns);
+            sof_ns += 1000000;
+            sofs++;
+            occ_add(&occ_ring, capture_fill());
+            occ_add(&occ_queue, pipeline_queued());
+            if (!started && sim_now_ns() >= start_ns)
+            {
+                started = true;
+                sim_usb_vendor_out(VSTREAM_REQ_START, (uint16_t)(usb_bytes | (opt_stamps ? VSTREAM_START_STAMPED : 0) |
+                                                                 (opt_detect ? VSTREAM_START_DETECT : 0)));
+                vstream_info_t vi;
+                if (opt_bulk_raw && stream_info(&vi) && (bulk_raw = fopen(opt_bulk_raw, "wb")))
+                    fwrite(&vi, sizeof(vi), 1, bulk_raw);
+            }
+            sim_usb_sof();
+            svc_ns = sim_now_ns() + (opt_sof_latency_us ? (uint64_t)(uniform() * opt_sof_latency_us * 1000) : 0);
+            svc_pending = true;
+        }
+        else
+            sim_set_time_ns(svc_ns);
+
+        if (svc_pending && svc_ns <= sim_now_ns())
+        {
+            svc_pending = false;
+            sim_run_core(0);
+
+            if (!warm && sim_now_ns() >= start_ns + WARMUP_NS)
+            {
+                warm = true;
+                buffered_warm = capture_fill() + pipeline_queued() * capture_frames_per_packet();
+                cap_warm = capture_stats;
+                fifo_warm = sim_pio_fifo_overflows();
+                empty_warm = pipeline_stats.queue_empty;
+                packets_warm = chk.packets;
+                sofs_warm = sofs;
+                tel_ok = snapshot(&tel_warm);
+                chk.prev_frame = -1;
+                blk_offset = INT64_MIN;             // start-up padding may have moved it
+                blk_misplaced = 0;
+            }
+        }
+
+        bool stalled = opt_stall_ms &&
+                       sim_now_ns() % (opt_stall_ms * 1000000ull) < opt_stall_us * 1000ull;
+        if (!stalled) sim_run_core(1);
+    }
+
+    // ---------- Report ----------
+    uint32_t buffered_end = capture_fill() + pipeline_queued() * capture_frames_per_packet();
+    double   win_s = (double)(end_ns - start_ns - WARMUP_NS) / 1e9;
+    double   delivered = (chk.win_frames + ((double)buffered_end - buffered_warm) / decim) / win_s;
+    double   ppm_meas = (delivered / opt_rate - 1) * 1e6;
+    double   ppm_true = (fs_true / decim / opt_rate - 1) * 1e6;
+
+    uint32_t overruns  = capture_stats.overruns - cap_warm.overruns;
+    uint32_t underruns = capture_stats.underruns - cap_warm.underruns;
+    uint32_t fifo_lost = sim_pio_fifo_overflows() - fifo_warm;
+    uint32_t empty     = pipeline_stats.queue_empty - empty_warm;
+
+    printf("\nstream     %llu packets, %llu frames; sizes %u/%u/%u frames: %u/%u/%u, other %u; %llu silent packets\n",
+           (unsigned long long)chk.packets, (unsigned long long)chk.frames,
+           usb_nominal - 1, usb_nominal, usb_nominal + 1,
+           chk.size_hist[0], chk.size_hist[1], chk.size_hist[2], chk.size_hist[3],
+           (unsigned long long)chk.silence_packets);
+    if (sample_check)
+        printf("check      %llu samples, %llu bad; after warm-up: %llu gaps (%llu frames lost), %llu repeats, %llu silent frames\n",
+               (unsigned long long)chk.samples, (unsigned long long)chk.bad_samples,
+               (unsigned long long)chk.gaps, (unsigned long long)chk.lost_frames,
+               (unsigned long long)chk.repeats, (unsigned long long)chk.silence_frames);
+    else if (tone_source)
+        printf("check      not sample-checked (test tones)\n");
+    else if (drone_source)
+        printf("check      not sample-checked (rotor and noise)\n");
+    else
+        printf("check      not sample-checked (decimated x%u); %llu silent frames after warm-up\n",
+               decim, (unsigned long long)chk.silence_frames);
+    printf("ring fill  min %u  avg %.1f  max %u frames (target %u, ring %u)\n",
+           occ_ring.min, occ_ring.sum / occ_ring.n, occ_ring.max,
+           capture_target_fill(), 2 * capture_target_fill());
+    printf("queue      min %u  avg %.2f  max %u packets (of %u)\n",
+           occ_queue.min, occ_queue.sum / occ_queue.n, occ_queue.max, PIPELINE_DUAL_CORE ? PIPELINE_QUEUE_PACKETS : 0);
+    printf("drops      PIO FIFO overflow %u words, capture overruns %u, underruns %u, IN with empty queue %u\n",
+           fifo_lost, overruns, underruns, empty);
+    printf("timing     per packet, host time [us]: ");
+    for (uint32_t s = 0; s < PIPELINE_N_STAGES; s++)
+        printf("%s %.2f/%.2f  ", pipeline_stage_names[s],
+               us(pipeline_stats.stage[s].avg), us(pipeline_stats.stage[s].max));
+    printf("\n           total avg %.2f max %.2f of %.0f budget\n",
+           us(pipeline_stats.total.avg), us(pipeline_stats.total.max), us(pipeline_stats.budget));
+    if (chk.lat_n)
+        printf("latency    I2S frame -> USB packet min %.0f avg %.0f max %.0f us\n",
+               chk.lat_min, chk.lat_sum / chk.lat_n, chk.lat_max);
+    bool rate_checked = win_s >= PPM_MIN_WINDOW_S && !opt_detect;
+    double ppm_tol = PPM_TOLERANCE + 2e6 / (opt_rate * win_s);
+    printf("rate       bus %+.1f ppm vs USB, delivered %+.1f ppm%s\n", ppm_true, ppm_meas,
+           rate_checked ? "" : opt_detect ? " (not checked: event mode)" : " (not checked: run >= 6 s)");
+
+    // Telemetry must agree with what the host saw over the same window
+    telemetry_names_t names;
+    uint8_t nbuf[256];
+    telemetry_decode_names(nbuf, sim_usb_vendor_in(TELEMETRY_REQ_STAGE_NAMES, nbuf, sizeof(nbuf)), &names);
+    tel_ok = tel_ok && snapshot(&tel_end);
+    if (tel_ok)
+    {
+        uint32_t d_frames = tel_end.frames - tel_warm.frames;
+        uint32_t d_blocks = tel_end.dma_blocks - tel_warm.dma_blocks;
+        uint32_t fpp = capture_frames_per_packet();
+        double   ppm_cap = (fs_true / AUDIO_CAPTURE_RATE(opt_rate) - 1) * 1e6;
+        double   drift_tol = DRIFT_PPM_TOLERANCE + DRIFT_PPM_PER_US * opt_sof_latency_us;
+        uint64_t in_packets = opt_bulk ? 0 : chk.packets - packets_warm;
+        tel_ok = tel_end.in_packets - tel_warm.in_packets == in_packets &&
+                 tel_end.sofs - tel_warm.sofs == sofs - sofs_warm &&
+                 tel_end.in_empty - tel_warm.in_empty == empty &&
+                 tel_end.overruns - tel_warm.overruns == overruns &&
+                 tel_end.in_late == 0 && tel_end.in_missed == 0 &&
+                 d_blocks * fpp <= d_frames + fpp && d_frames <= (d_blocks + 1) * fpp &&
+                 tel_end.packets == pipeline_stats.packets &&
+                 (!rate_checked || fabs(tel_end.drift_ppm - ppm_cap) < drift_tol);
+        printf("telemetry  %u IN packets, %u SOFs, %u DMA blocks, drift %+d ppm over the window: %s\n",
+               tel_end.in_packets - tel_warm.in_packets, tel_end.sofs - tel_warm.sofs, d_blocks,
+               tel_end.drift_ppm, tel_ok ? "consistent" : "MISMATCH");
+        if (opt_telemetry)
+        {
+            printf("\n");
+            telemetry_print(stdout, &tel_end, &tel_warm, &names);
+        }
+    }
+    else
+        printf("telemetry  snapshot request failed\n");
+
+    // Bulk: every block decodes, nothing is lost between the FIFO and the host, and
+    // the device's byte count matches what was read plus what is still in flight
+    bool stress = opt_stall_ms != 0 || (opt_bulk && opt_bulk_bw < BULK_BW_FS);
+    bool bulk_ok = true;
+    if (opt_bulk)
+    {
+        const vstream_stats_t *b = &vdec.stats;
+        vstream_info_t vi;
+        bulk_ok = sim_usb_vendor_out_ok() && stream_info(&vi) && vi.running &&
+                  (uint32_t)(vi.bytes - b->bytes) == sim_usb_bulk_pending() + vdec.len &&
+                  b->seq_gaps == 0 && b->resyncs == 0 && b->bad_blocks == 0 &&
+                  blk_misplaced == 0 && blk_header_bad == 0 &&
+                  (stress || (b->frame_gaps == 0 && vi.stalls == 0));
+        printf("bulk       %llu blocks, %.2fx (%llu of %llu PCM bytes); gaps: %llu seq, %llu frame (%llu frames); "
+               "%llu resyncs, %llu bad, %llu misplaced\n",
+               (unsigned long long)b->blocks, b->bytes ? (double)b->raw_bytes / b->bytes : 0,
+               (unsigned long long)b->bytes, (unsigned long long)b->raw_bytes,
+               (unsigned long long)b->seq_gaps, (unsigned long long)b->frame_gaps,
+               (unsigned long long)b->lost_frames, (unsigned long long)b->resyncs,
+               (unsigned long long)b->bad_blocks, (unsigned long long)blk_misplaced);
+        if (sim_usb_vendor_out_ok() && stream_info(&vi))
+            printf("           device: %u blocks, %u stalls, %u bytes in flight: %s\n", vi.blocks, vi.stalls,
+                   sim_usb_bulk_pending() + vdec.len, bulk_ok ? "consistent" : "MISMATCH");
+        else
+            printf("           START or INFO request stalled\n");
+
+        // Stamps: on every block (the first may beat the first SOF after START), and exact
+        if (opt_stamps)
+        {
+            bool stamps_ok = b->stamped + 1 >= b->blocks && stamps_bad == 0 && (!sample_check || stamps_checked);
+            printf("stamps     %llu of %llu blocks; %llu SOF positions checked against the PIO, %llu off\n",
+                   (unsigned long long)b->stamped, (unsigned long long)b->blocks,
+                   (unsigned long long)stamps_checked, (unsigned long long)stamps_bad);
+            bulk_ok = bulk_ok && stamps_ok;
+        }
+        else
+            bulk_ok = bulk_ok && b->stamped == 0;
+    }
+
+    // Event mode: a report per analysed frame; with the rotor, one detection of it in
+    // time, and audio from before its onset to after its release only
+    if (opt_detect)
+    {
+        const vstream_stats_t *b = &vdec.stats;
+        double run_s = opt_seconds - ev_start_s, on_s = DRONE_ON * opt_seconds, off_s = DRONE_OFF * opt_seconds;
+        double expect = ev_report_frames ? run_s * opt_rate / ev_report_frames : 0;
+        bool   ev_ok = b->reports + 3 >= expect && b->reports <= expect + 1 && b->report_gaps == 0;
+        printf("events     %llu reports (%.0f expected), %llu missing; %.0f B/s, raw PCM would be %.0f B/s\n",
+               (unsigned long long)b->reports, expect, (unsigned long long)b->report_gaps,
+               b->reports * (double)VSTREAM_REPORT_BYTES / run_s, opt_rate * PIPELINE_N_CHANNELS * usb_bytes * 1.0);
+        if (!sim_usb_vendor_out_ok())
+        {
+            ev_ok = false;
+            printf("           START refused: event mode does not take %u Hz / %u-bit here\n", opt_rate, 8 * usb_bytes);
+        }
+        else if (drone_source)
+        {
+            double onset = ev_time(ev_onset_frame), release = ev_time(ev_release_frame);
+            double from = ev_time(ev_first_audio), to = ev_time(ev_last_audio);
+            ev_ok = ev_ok && ev_onsets == 1 && onset >= on_s && onset <= on_s + DETECT_ONSET_MAX_S &&
+                    ev_releases == 1 && release >= off_s && release <= off_s + DETECT_RELEASE_MAX_S &&
+                    ev_active && ev_f0_ok * 10 >= ev_active * 9 && ev_doa && ev_doa_ok * 10 >= ev_doa * 9 &&
+                    ev_first_audio >= 0 && from < on_s &&
+                    to < opt_seconds - 0.5 && (stress || b->frame_gaps == 0);
+            printf("           rotor %.2f .. %.2f s: onset %+.3f s, release %+.3f s; f0 within 3%% in %llu of %llu, "
+                   "az within %.0f deg in %llu of %llu\n",
+                   on_s, off_s, onset - on_s, release - off_s, (unsigned long long)ev_f0_ok,
+                   (unsigned long long)ev_active, DETECT_AZ_TOL, (unsigned long long)ev_doa_ok,
+                   (unsigned long long)ev_doa);
+            printf("           audio %.3f .. %.3f s (%.3f s pre-trigger before the rotor, %.3f s before the onset "
+                   "report): %s\n", from, to, on_s - from, onset - from, ev_ok ? "consistent" : "MISMATCH");
+        }
+        bulk_ok = bulk_ok && ev_ok;
+    }
+
+    if (bulk_raw) fclose(bulk_raw);
+
+    bool ok = chk.bad_samples == 0 && chk.repeats == 0 && chk.size_hist[3] == 0 && tel_ok && bulk_ok &&
+              (stress || (chk.gaps == 0 && chk.silence_frames == 0 && fifo_lost == 0 &&
+                          overruns == 0 && underruns == 0 && empty == 0 &&
+                          (!rate_checked || fabs(ppm_meas - ppm_true) < ppm_tol)));
+    printf("\nresult     %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+// hardware/clocks.h — host simulation stand-in
+
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+#define SIM_CLK_SYS_HZ          125000000u
+
+enum clock_index { clk_sys };
+
+static inline uint32_t clock_get_hz(enum clock_index clk) { (void)clk; return SIM_CLK_SYS_HZ; }
+
+#endif // SIM_HARDWARE_CLOCKS_H
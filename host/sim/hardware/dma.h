@@ -0,0 +1,79 @@
+// hardware/dma.h — host simulation stand-in
+//
+// Register-level model of the channels capture.c uses: paced transfers on a DREQ,
+// unpaced (DREQ_FORCE) channels run to completion when triggered, chaining, read/write
+// address rings, and the AL2 write-address trigger alias. Addresses are 32-bit like the
+// RP2040's, so the simulation is linked without PIE to keep its data below 4 GiB.
+
+#ifndef SIM_HARDWARE_DMA_H
+#define SIM_HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS        12
+#define DREQ_FORCE              0x3f
+
+typedef struct {
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al1_ctrl;
+    volatile uint32_t al1_read_addr;
+    volatile uint32_t al1_write_addr;
+    volatile uint32_t al1_transfer_count_trig;
+    volatile uint32_t al2_ctrl;
+    volatile uint32_t al2_transfer_count;
+    volatile uint32_t al2_read_addr;
+    volatile uint32_t al2_write_addr_trig;
+    volatile uint32_t al3_ctrl;
+    volatile uint32_t al3_write_addr;
+    volatile uint32_t al3_transfer_count;
+    volatile uint32_t al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+} dma_hw_t;
+
+extern dma_hw_t sim_dma;
+#define dma_hw      (&sim_dma)
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool     read_incr;
+    bool     write_incr;
+    uint     dreq;
+    uint     chain_to;
+    uint     ring_bits;         // 0 = no ring
+    bool     ring_write;
+} dma_channel_config;
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config c = { DMA_SIZE_32, true, false, DREQ_FORCE, channel, 0, false };
+    return c;
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->size = size; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_incr = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_incr = incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) { c->dreq = dreq; }
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) { c->chain_to = chain_to; }
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits)
+{
+    c->ring_write = write;
+    c->ring_bits = size_bits;
+}
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+
+#endif // SIM_HARDWARE_DMA_H
@@ -0,0 +1,78 @@
+// hardware/pio.h — host simulation stand-in
+//
+// Only what capture.c uses. Instructions are not executed: sim_hw.c models the data
+// layout of the bus program capture_config.h selects (i2s_rx3: 3 SD bits per BCLK,
+// autopush every 24 bits; tdm_rx: TDM_N_LINES bits per BCLK, autopush every 32) and
+// takes the bus rate from the SM clock divider.
+
+#ifndef SIM_HARDWARE_PIO_H
+#define SIM_HARDWARE_PIO_H
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    volatile uint32_t txf[4];
+    volatile uint32_t rxf[4];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio0;
+#define pio0        (&sim_pio0)
+
+typedef struct {
+    uint32_t clkdiv_q8;         // divider, 16.8 fixed point as in SMx_CLKDIV
+    bool     autopush;
+    uint     push_threshold;
+    bool     join_rx;
+} pio_sm_config;
+
+typedef struct {
+    const uint16_t *instructions;
+    uint8_t         length;
+    int8_t          origin;
+} pio_program_t;
+
+enum pio_src_dest { pio_pins, pio_x, pio_y, pio_null, pio_isr = 6, pio_osr };
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE, PIO_FIFO_JOIN_TX, PIO_FIFO_JOIN_RX };
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+static inline void pio_gpio_init(PIO pio, uint pin) { (void)pio; (void)pin; }
+static inline void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool out)
+{
+    (void)pio; (void)sm; (void)pin; (void)count; (void)out;
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint pin) { (void)c; (void)pin; }
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint pin) { (void)c; (void)pin; }
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool right, bool autopush, uint threshold)
+{
+    (void)right;
+    c->autopush = autopush;
+    c->push_threshold = threshold;
+}
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)
+{
+    c->join_rx = join == PIO_FIFO_JOIN_RX;
+}
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div)
+{
+    c->clkdiv_q8 = (uint32_t)(div * 256.0f);
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+static inline void pio_sm_restart(PIO pio, uint sm) { (void)pio; (void)sm; }
+static inline void pio_sm_clkdiv_restart(PIO pio, uint sm) { (void)pio; (void)sm; }
+static inline void pio_sm_exec(PIO pio, uint sm, uint instr) { (void)pio; (void)sm; (void)instr; }
+
+static inline uint pio_encode_set(enum pio_src_dest dest, uint value) { return 0xE000u | (uint)dest << 5 | value; }
+static inline uint pio_encode_jmp(uint addr) { return addr; }
+static inline uint pio_encode_in(enum pio_src_dest src, uint count) { return 0x4000u | (uint)src << 5 | (count & 31u); }
+static inline uint pio_encode_mov(enum pio_src_dest dest, enum pio_src_dest src) { return 0xA000u | (uint)dest << 5 | (uint)src; }
+
+// DREQ_PIO0_RX0 + sm, as on the RP2040
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { (void)pio; return (is_tx ? 0u : 4u) + sm; }
+
+#endif // SIM_HARDWARE_PIO_H
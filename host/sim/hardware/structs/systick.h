@@ -0,0 +1,21 @@
+// hardware/structs/systick.h — host simulation stand-in
+//
+// Every read of systick_hw refreshes cvr from the host clock, scaled to clk_sys, so
+// the pipeline's cycle accounting reports host time in clk_sys cycles.
+
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+} systick_hw_t;
+
+systick_hw_t *sim_systick(void);
+#define systick_hw  (sim_systick())
+
+#endif // SIM_HARDWARE_STRUCTS_SYSTICK_H
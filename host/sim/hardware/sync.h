@@ -0,0 +1,15 @@
+// hardware/sync.h — host simulation stand-in
+//
+// The barriers in the inter-core queue are where the other core may run (sim_preempt),
+// so every interleaving at those points gets exercised.
+
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include "pico/stdlib.h"
+
+void sim_preempt(void);
+
+static inline void __dmb(void) { sim_preempt(); }
+
+#endif // SIM_HARDWARE_SYNC_H
@@ -0,0 +1,19 @@
+// i2s_rx3.pio.h — host simulation stand-in for the pioasm output of pio/i2s_rx3.pio
+
+#ifndef SIM_I2S_RX3_PIO_H
+#define SIM_I2S_RX3_PIO_H
+
+#include "hardware/pio.h"
+
+#define i2s_rx3_offset_entry_point 11u
+
+extern const pio_program_t i2s_rx3_program;
+
+static inline pio_sm_config i2s_rx3_program_get_default_config(uint offset)
+{
+    (void)offset;
+    pio_sm_config c = { 256, false, 32, false };
+    return c;
+}
+
+#endif // SIM_I2S_RX3_PIO_H
@@ -0,0 +1,11 @@
+// pico/multicore.h — host simulation stand-in: core1 is a coroutine (see sim_hw.c)
+
+#ifndef SIM_PICO_MULTICORE_H
+#define SIM_PICO_MULTICORE_H
+
+#include "pico/stdlib.h"
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+#endif // SIM_PICO_MULTICORE_H
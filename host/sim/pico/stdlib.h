@@ -0,0 +1,31 @@
+// pico/stdlib.h — host simulation stand-in (see sim.h)
+
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;               // simulated microseconds
+
+#define PICO_DEFAULT_LED_PIN    25
+#define GPIO_OUT                1
+
+static inline void stdio_init_all(void) {}
+static inline void gpio_init(uint gpio) { (void)gpio; }
+static inline void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+static inline void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+static inline uint32_t time_us_32(void) { return (uint32_t)get_absolute_time(); }
+
+// Busy-wait hint: hands the simulated core back to the scheduler
+void tight_loop_contents(void);
+
+void panic(const char *fmt, ...) __attribute__((noreturn));
+
+#endif // SIM_PICO_STDLIB_H
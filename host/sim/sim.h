@@ -0,0 +1,59 @@
+// sim.h — host simulation of the RP2040 parts the firmware touches
+//
+// The real firmware sources (main.c, capture.c, pipeline.c, usb_descriptors.c, ...) are
+// compiled against the stand-in headers in this directory. Both cores run as coroutines
+// on simulated time; the harness drives I2S frames and USB SOFs in time order.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ---------- Time ----------
+uint64_t sim_now_ns(void);
+void     sim_set_time_ns(uint64_t t);
+
+// ---------- I2S / TDM source -> PIO RX FIFO -> DMA ----------
+// 24-bit sample of channel ch in bus frame `frame`: i2s_rx3 channel order (0..5), or
+// the TDM bus channel line * TDM_N_SLOTS + slot (capture_config.h).
+typedef uint32_t (*sim_sample_fn)(uint32_t ch, uint32_t frame);
+
+void     sim_pio_set_source(sim_sample_fn fn);
+bool     sim_pio_running(void);
+double   sim_pio_sample_rate(void);         // from the SM clock divider at SIM_CLK_SYS_HZ
+uint32_t sim_pio_frames(void);              // frames clocked out so far (next frame's index)
+void     sim_pio_clock_frame(void);         // one bus frame -> CAPTURE_WORDS_PER_FRAME FIFO words
+uint32_t sim_pio_fifo_overflows(void);      // words lost to a full RX FIFO (SM would stall)
+
+// ---------- Cores ----------
+void sim_core0_start(void (*entry)(void));
+void sim_run_core(uint32_t core);           // runs until the core yields (tight loop, tud_task)
+bool sim_core_alive(uint32_t core);
+void sim_set_preempt(uint32_t one_in_n, uint32_t seed);   // 0: never switch at barriers
+
+// ---------- USB host ----------
+typedef void (*sim_packet_fn)(const uint8_t *data, uint16_t len);
+typedef void (*sim_sof_fn)(void);
+
+int      sim_usb_mount(void);               // parses descriptors; 0, or -1 if inconsistent
+uint16_t sim_usb_ep_size(uint8_t alt);
+uint8_t  sim_usb_alt_bytes(uint8_t alt);
+void     sim_usb_set_packet_sink(sim_packet_fn fn);
+void     sim_usb_sof(void);                 // queued for the next tud_task()
+void     sim_usb_set_frame(uint32_t frame); // frame number of the last SOF (a bus up for a while)
+void     sim_usb_set_sof_hook(sim_sof_fn fn);   // called as core0 takes each SOF, before tud_sof_cb
+void     sim_usb_set_rate(uint32_t rate);
+void     sim_usb_set_alt(uint8_t alt);
+uint32_t sim_usb_get_rates(uint32_t *rates, uint32_t max);  // GET RANGE, call after mount
+// Vendor IN request to the vendor-specific interface; bytes returned, or -1 if stalled
+int      sim_usb_vendor_in(uint8_t request, void *buf, uint16_t max);
+// Vendor OUT request without data stage, queued for the next tud_task()
+void     sim_usb_vendor_out(uint8_t request, uint16_t value);
+bool     sim_usb_vendor_out_ok(void);               // outcome of the last one (false: stalled)
+// Vendor bulk IN: the host reads up to bytes_per_ms from the device FIFO every frame
+void     sim_usb_set_bulk_sink(sim_packet_fn fn, uint32_t bytes_per_ms);
+uint32_t sim_usb_bulk_pending(void);                // bytes written but not read yet
+void     sim_usb_task(void);
+
+#endif // SIM_H
@@ -0,0 +1,444 @@
+// sim_hw.c — simulated time, cores, PIO (i2s_rx3 / tdm_rx data path), DMA and SysTick
+
+#define _XOPEN_SOURCE 700
+#include "sim.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+#include "i2s_rx3.pio.h"
+#include "samples.h"
+#include "capture.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#define CORE_STACK_BYTES    (256 * 1024)
+#define FIFO_DEPTH_JOINED   8
+
+// ---------- Time ----------
+static uint64_t now_ns;
+
+uint64_t sim_now_ns(void)           { return now_ns; }
+void     sim_set_time_ns(uint64_t t) { now_ns = t; }
+
+absolute_time_t get_absolute_time(void)               { return now_ns / 1000; }
+absolute_time_t make_timeout_time_ms(uint32_t ms)     { return now_ns / 1000 + (uint64_t)ms * 1000; }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+
+void panic(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    exit(2);
+}
+
+// ---------- SysTick: host time in clk_sys cycles ----------
+static systick_hw_t systick;
+
+systick_hw_t *sim_systick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    systick.cvr = 0x00FFFFFFu - (uint32_t)(ns * (SIM_CLK_SYS_HZ / 1000000u) / 1000u & 0x00FFFFFFu);
+    return &systick;
+}
+
+// ---------- Cores (coroutines) ----------
+static ucontext_t sched_ctx;
+static ucontext_t core_ctx[2];
+static void      *core_stack[2];
+static void     (*core_entry[2])(void);
+static bool       core_alive[2];
+static int        cur_core = -1;
+static bool       preempted;
+static uint32_t   preempt_n;
+static uint32_t   preempt_rng = 1;
+
+static void core_trampoline(void)
+{
+    core_entry[cur_core]();
+    core_alive[cur_core] = false;       // returns to sched_ctx via uc_link
+}
+
+static void core_start(uint32_t core, void (*entry)(void))
+{
+    if (!core_stack[core]) core_stack[core] = malloc(CORE_STACK_BYTES);
+    getcontext(&core_ctx[core]);
+    core_ctx[core].uc_stack.ss_sp   = core_stack[core];
+    core_ctx[core].uc_stack.ss_size = CORE_STACK_BYTES;
+    core_ctx[core].uc_link          = &sched_ctx;
+    makecontext(&core_ctx[core], core_trampoline, 0);
+    core_entry[core] = entry;
+    core_alive[core] = true;
+}
+
+static void yield(void)
+{
+    if (cur_core >= 0) swapcontext(&core_ctx[cur_core], &sched_ctx);
+}
+
+static void run_once(uint32_t core)
+{
+    int prev = cur_core;
+    cur_core = (int)core;
+    swapcontext(&sched_ctx, &core_ctx[core]);
+    cur_core = prev;
+}
+
+void sim_core0_start(void (*entry)(void)) { core_start(0, entry); }
+bool sim_core_alive(uint32_t core)        { return core_alive[core]; }
+
+void sim_set_preempt(uint32_t one_in_n, uint32_t seed)
+{
+    preempt_n = one_in_n;
+    preempt_rng = seed ? seed : 1;
+}
+
+void sim_run_core(uint32_t core)
+{
+    while (core_alive[core])
+    {
+        preempted = false;
+        run_once(core);
+        if (!preempted) break;
+        // Switched at a barrier: let the other core run, then continue this one
+        if (core_alive[core ^ 1]) run_once(core ^ 1);
+    }
+}
+
+void sim_preempt(void)
+{
+    if (!preempt_n || cur_core < 0 || !core_alive[cur_core ^ 1]) return;
+    preempt_rng = preempt_rng * 1103515245u + 12345u;
+    if ((preempt_rng >> 16) % preempt_n) return;
+    preempted = true;
+    yield();
+}
+
+void tight_loop_contents(void)
+{
+    yield();
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+    core_start(1, entry);
+}
+
+void multicore_reset_core1(void)
+{
+    core_alive[1] = false;
+}
+
+// ---------- DMA ----------
+dma_hw_t sim_dma;
+
+static dma_channel_config dma_cfg[NUM_DMA_CHANNELS];
+static uint32_t           dma_reload[NUM_DMA_CHANNELS];
+static bool               dma_busy[NUM_DMA_CHANNELS];
+static uint32_t           dma_claimed;
+
+static uint32_t addr32(const volatile void *p)
+{
+    uintptr_t a = (uintptr_t)p;
+    if (a >> 32) panic("address %p does not fit the 32-bit bus model (build without PIE)", (void *)p);
+    return (uint32_t)a;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++)
+        if (!(dma_claimed & (1u << c)))
+        {
+            dma_claimed |= 1u << c;
+            return (int)c;
+        }
+    if (required) panic("no free DMA channel");
+    return -1;
+}
+
+static void dma_trigger(uint c);
+
+static uint32_t ring_step(uint32_t addr, uint32_t ring_bits)
+{
+    if (!ring_bits) return addr + 4;
+    uint32_t mask = (1u << ring_bits) - 1;
+    return (addr & ~mask) | ((addr + 4) & mask);
+}
+
+static uint32_t fifo_pop(void);
+static bool     is_rx_fifo(uint32_t addr);
+
+// One 32-bit transfer, then chaining / re-triggering as the hardware would
+static void dma_transfer(uint c)
+{
+    dma_channel_hw_t *ch = &sim_dma.ch[c];
+    const dma_channel_config *k = &dma_cfg[c];
+
+    uint32_t v = is_rx_fifo(ch->read_addr) ? fifo_pop()
+                                           : *(volatile uint32_t *)(uintptr_t)ch->read_addr;
+
+    // Writes into another channel's AL2 write-address trigger re-arm that channel
+    int retrig = -1;
+    for (uint t = 0; t < NUM_DMA_CHANNELS; t++)
+        if (ch->write_addr == addr32(&sim_dma.ch[t].al2_write_addr_trig))
+        {
+            sim_dma.ch[t].write_addr = v;
+            retrig = (int)t;
+        }
+    if (retrig < 0) *(volatile uint32_t *)(uintptr_t)ch->write_addr = v;
+
+    if (k->read_incr)  ch->read_addr  = ring_step(ch->read_addr,  k->ring_write ? 0 : k->ring_bits);
+    if (k->write_incr) ch->write_addr = ring_step(ch->write_addr, k->ring_write ? k->ring_bits : 0);
+    ch->transfer_count--;
+
+    if (retrig >= 0) dma_trigger((uint)retrig);
+
+    if (ch->transfer_count == 0)
+    {
+        dma_busy[c] = false;
+        if (k->chain_to != c) dma_trigger(k->chain_to);
+    }
+}
+
+static void dma_trigger(uint c)
+{
+    if (dma_cfg[c].size != DMA_SIZE_32) panic("DMA model: 32-bit transfers only");
+    sim_dma.ch[c].transfer_count = dma_reload[c];
+    dma_busy[c] = dma_reload[c] != 0;
+    if (dma_cfg[c].dreq == DREQ_FORCE)
+        while (dma_busy[c])
+            dma_transfer(c);
+}
+
+// Paced channels waiting on dreq take one word each while the source has data
+static void dma_dreq(uint dreq, uint32_t (*level)(void))
+{
+    for (uint c = 0; c < NUM_DMA_CHANNELS; c++)
+        while (dma_busy[c] && dma_cfg[c].dreq == dreq && level())
+            dma_transfer(c);
+}
+
+void dma_channel_configure(uint c, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma_cfg[c] = *config;
+    sim_dma.ch[c].write_addr = addr32(write_addr);
+    sim_dma.ch[c].read_addr  = addr32(read_addr);
+    dma_reload[c] = transfer_count;
+    sim_dma.ch[c].transfer_count = transfer_count;
+    if (trigger) dma_trigger(c);
+}
+
+void dma_channel_set_read_addr(uint c, const volatile void *read_addr, bool trigger)
+{
+    sim_dma.ch[c].read_addr = addr32(read_addr);
+    if (trigger) dma_trigger(c);
+}
+
+void dma_channel_set_write_addr(uint c, volatile void *write_addr, bool trigger)
+{
+    sim_dma.ch[c].write_addr = addr32(write_addr);
+    if (trigger) dma_trigger(c);
+}
+
+void dma_channel_set_trans_count(uint c, uint32_t trans_count, bool trigger)
+{
+    dma_reload[c] = trans_count;
+    if (trigger) dma_trigger(c);
+}
+
+void dma_channel_start(uint c)
+{
+    dma_trigger(c);
+}
+
+void dma_channel_abort(uint c)
+{
+    dma_busy[c] = false;
+}
+
+// ---------- PIO: i2s_rx3 / tdm_rx data path ----------
+pio_hw_t sim_pio0;
+const pio_program_t i2s_rx3_program = { NULL, 12, -1 };
+
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+#define BUS_PUSH_BITS   32
+#else
+#define BUS_PUSH_BITS   (8 * I2S3_N_LINES)
+#endif
+
+static pio_sm_config sm_cfg;
+static bool          sm_enabled;
+static uint          sm_index;
+static uint32_t      fifo[FIFO_DEPTH_JOINED];
+static uint32_t      fifo_head, fifo_count, fifo_overflows;
+static uint32_t      frames_out;
+static sim_sample_fn source;
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+    (void)pio;
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+    // The model shifts TDM_N_LINES bits per BCLK: the loaded `in` instructions must agree
+    for (uint i = 0; i < program->length; i++)
+    {
+        uint16_t op = program->instructions[i];
+        if ((op & 0xE000u) == 0x4000u && (op & 0x1Fu) != TDM_N_LINES)
+            panic("PIO model: tdm_rx `in` at %u shifts %u bits, not %u", i, op & 0x1Fu, TDM_N_LINES);
+    }
+#else
+    (void)program;
+#endif
+    return 0;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+    (void)pio; (void)initial_pc;
+    if (!config->autopush || config->push_threshold != BUS_PUSH_BITS)
+        panic("PIO model: the bus program needs autopush at %u bits", BUS_PUSH_BITS);
+    sm_cfg = *config;
+    sm_index = sm;
+    sm_enabled = false;
+    fifo_count = 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    (void)pio; (void)sm;
+    sm_enabled = enabled;
+}
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div)
+{
+    (void)pio; (void)sm;
+    sm_cfg.clkdiv_q8 = (uint32_t)(div * 256.0f);
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+    (void)pio; (void)sm;
+    fifo_count = 0;
+}
+
+static uint32_t fifo_level(void)
+{
+    return fifo_count;
+}
+
+static uint32_t fifo_pop(void)
+{
+    if (!fifo_count) return 0;
+    uint32_t v = fifo[fifo_head];
+    fifo_head = (fifo_head + 1) % FIFO_DEPTH_JOINED;
+    fifo_count--;
+    return v;
+}
+
+static bool is_rx_fifo(uint32_t addr)
+{
+    return addr == addr32(&sim_pio0.rxf[sm_index]);
+}
+
+static void fifo_push(uint32_t w)
+{
+    uint32_t depth = sm_cfg.join_rx ? FIFO_DEPTH_JOINED : FIFO_DEPTH_JOINED / 2;
+    if (fifo_count == depth)
+    {
+        fifo_overflows++;
+        return;
+    }
+    fifo[(fifo_head + fifo_count) % FIFO_DEPTH_JOINED] = w;
+    fifo_count++;
+    dma_dreq(pio_get_dreq(&sim_pio0, sm_index, false), fifo_level);
+}
+
+void sim_pio_set_source(sim_sample_fn fn) { source = fn; }
+bool sim_pio_running(void)                { return sm_enabled; }
+uint32_t sim_pio_frames(void)             { return frames_out; }
+uint32_t sim_pio_fifo_overflows(void)     { return fifo_overflows; }
+
+double sim_pio_sample_rate(void)
+{
+    // 2 instructions per BCLK
+    return (double)SIM_CLK_SYS_HZ * 256.0 / ((double)sm_cfg.clkdiv_q8 * CAPTURE_SM_CYCLES_PER_FRAME);
+}
+
+#if CAPTURE_BUS == CAPTURE_BUS_TDM
+static uint32_t noise_bit(void)
+{
+    static uint32_t lfsr = 0xACE1u;
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return lfsr & 1u;
+}
+
+void sim_pio_clock_frame(void)
+{
+    if (!sm_enabled) return;
+
+    // Line l, slot s carries bus channel l * TDM_N_SLOTS + s: 24 data bits MSB first (cut
+    // short by 16-bit slots), then noise to the end of the slot - TDM_DATA_BITS drops it.
+    uint32_t s[TDM_N_BUS_CHANNELS];
+    for (uint32_t c = 0; c < TDM_N_BUS_CHANNELS; c++)
+        s[c] = source ? source(c, frames_out) : 0;
+
+    uint32_t isr = 0, n = 0;
+    for (uint32_t bclk = 0; bclk < TDM_BCLKS_PER_FRAME; bclk++)
+    {
+        uint32_t slot = bclk / TDM_SLOT_BITS, bit = bclk % TDM_SLOT_BITS, pins = 0;
+        for (uint32_t l = 0; l < TDM_N_LINES; l++)
+        {
+            uint32_t b = bit < 24 ? (s[l * TDM_N_SLOTS + slot] >> (23 - bit)) & 1u : noise_bit();
+            pins |= b << l;
+        }
+        isr = (isr << TDM_N_LINES) | pins;          // in pins, TDM_N_LINES (shift left)
+        n += TDM_N_LINES;
+        if (n == 32)                                // autopush at 32 bits
+        {
+            fifo_push(isr);
+            isr = 0;
+            n = 0;
+        }
+    }
+    frames_out++;
+}
+#else
+void sim_pio_clock_frame(void)
+{
+    if (!sm_enabled) return;
+
+    // SD line l carries channel 2l in the left slot and 2l+1 in the right one:
+    // 24 data bits MSB first, then 8 BCLKs of high-Z (read as 0).
+    uint32_t s[I2S3_N_CHANNELS];
+    for (uint32_t c = 0; c < I2S3_N_CHANNELS; c++)
+        s[c] = source ? source(c, frames_out) : 0;
+
+    uint32_t isr = 0;
+    for (uint32_t bclk = 0; bclk < 64; bclk++)
+    {
+        uint32_t slot = bclk / 32, bit = bclk % 32, pins = 0;
+        for (uint32_t l = 0; l < I2S3_N_LINES; l++)
+            if (bit < 24) pins |= ((s[2 * l + slot] >> (23 - bit)) & 1u) << l;
+        isr = (isr << I2S3_N_LINES) | pins;         // in pins, 3 (shift left)
+        if (bclk % 8 == 7)                          // autopush at 24 bits
+        {
+            fifo_push(isr & 0x00FFFFFFu);
+            isr = 0;
+        }
+    }
+    frames_out++;
+}
+#endif
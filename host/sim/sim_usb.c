@@ -0,0 +1,287 @@
+// sim_usb.c — USB host + device stack stand-in
+//
+// Mount walks the configuration descriptor like a host would and checks it is
+// self-consistent. Control requests and SOFs are queued and delivered from
+// tud_task() on core0, in the order TinyUSB would call the firmware's callbacks.
+
+#include "sim.h"
+#include "tusb.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ALTS            8
+#define EP_ADDR_AUDIO_IN    0x81
+
+static bool          mounted;
+static bool          sof_enabled;
+static uint32_t      sof_frame;
+static uint32_t      sof_pending;
+static uint8_t       cur_alt;
+static uint16_t      ep_size[MAX_ALTS];
+static uint8_t       alt_bytes[MAX_ALTS];
+static sim_packet_fn sink;
+static sim_sof_fn    sof_hook;
+
+static bool          rate_pending;
+static uint32_t      rate_req;
+static bool          alt_pending;
+static uint8_t       alt_req;
+
+static uint8_t       ctrl_in[512];
+static uint16_t      ctrl_in_len;
+static uint8_t       vendor_itf = 0xFF;
+static bool          vendor_pending;
+static uint8_t       vendor_req;
+static uint16_t      vendor_value;
+static bool          vendor_ok;
+
+// Vendor bulk IN FIFO (CFG_TUD_VENDOR_TX_BUFSIZE), drained by the host once per frame
+static uint8_t       bulk_fifo[CFG_TUD_VENDOR_TX_BUFSIZE];
+static uint32_t      bulk_level;
+static uint32_t      bulk_per_ms;
+static sim_packet_fn bulk_sink;
+
+// ---------- Device API ----------
+void tusb_init(void)                    {}
+void tud_sof_cb_enable(bool enable)     { sof_enabled = enable; }
+bool tud_audio_n_mounted(uint8_t func)  { (void)func; return mounted; }
+
+uint16_t tud_audio_write(const void *data, uint16_t len)
+{
+    if (len > ep_size[cur_alt])
+    {
+        fprintf(stderr, "sim_usb: %u-byte packet exceeds wMaxPacketSize %u of alt %u\n",
+                len, ep_size[cur_alt], cur_alt);
+        len = ep_size[cur_alt];
+    }
+    if (sink) sink(data, len);
+    return len;
+}
+
+bool tud_audio_buffer_and_schedule_control_xfer(uint8_t rhport, tusb_control_request_t const *p_request,
+                                                void *data, uint16_t len)
+{
+    (void)rhport;
+    if (len > p_request->wLength) len = p_request->wLength;
+    if (len > sizeof(ctrl_in)) return false;
+    memcpy(ctrl_in, data, len);
+    ctrl_in_len = len;
+    return true;
+}
+
+bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len)
+{
+    return tud_audio_buffer_and_schedule_control_xfer(rhport, request, buffer, len);
+}
+
+bool tud_control_status(uint8_t rhport, tusb_control_request_t const *request)
+{
+    (void)rhport; (void)request;
+    return true;
+}
+
+bool tud_vendor_mounted(void)            { return mounted && vendor_itf != 0xFF; }
+uint32_t tud_vendor_write_available(void) { return sizeof(bulk_fifo) - bulk_level; }
+uint32_t tud_vendor_write_flush(void)     { return 0; }
+
+uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize)
+{
+    if (bufsize > tud_vendor_write_available()) bufsize = tud_vendor_write_available();
+    memcpy(&bulk_fifo[bulk_level], buffer, bufsize);
+    bulk_level += bufsize;
+    return bufsize;
+}
+
+void tud_task(void)
+{
+    sim_usb_task();
+    tight_loop_contents();
+}
+
+// ---------- Host side ----------
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t rd32(const uint8_t *p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+
+int sim_usb_mount(void)
+{
+    const uint8_t *dev = tud_descriptor_device_cb();
+    const uint8_t *cfg = tud_descriptor_configuration_cb(0);
+    if (dev[0] != sizeof(tusb_desc_device_t) || dev[1] != TUSB_DESC_DEVICE) return -1;
+    if (cfg[1] != TUSB_DESC_CONFIGURATION) return -1;
+
+    uint16_t total = rd16(&cfg[2]);
+    uint16_t func_start = 0, func_end = total;
+    uint8_t  func_itf = 0, func_n_itf = 0;
+    uint8_t  itf = 0xFF, alt = 0;
+    int      vendor_eps = 0;                // declared minus found, vendor interface
+
+    for (uint16_t off = 0; off < total; off += cfg[off])
+    {
+        const uint8_t *d = &cfg[off];
+        if (d[0] < 2 || off + d[0] > total) return -1;
+
+        if (d[1] == TUSB_DESC_INTERFACE_ASSOCIATION) { func_start = off; func_itf = d[2]; func_n_itf = d[3]; }
+        if (d[1] == TUSB_DESC_INTERFACE)
+        {
+            itf = d[2];
+            alt = d[3];
+            if ((itf < func_itf || itf >= func_itf + func_n_itf) && func_end == total) func_end = off;
+            if (d[5] == TUSB_CLASS_VENDOR_SPECIFIC) { vendor_itf = itf; vendor_eps = d[4]; }
+        }
+        if (d[1] == TUSB_DESC_ENDPOINT && itf == vendor_itf)
+        {
+            vendor_eps--;
+            if ((d[3] & 3) != TUSB_XFER_BULK || rd16(&d[4]) != CFG_TUD_VENDOR_EPSIZE) return -1;
+        }
+        if (itf != AUDIO_ITF_AS || alt >= MAX_ALTS) continue;
+
+        if (d[1] == 0x24 && d[2] == 0x02)           // Type I format: bSubslotSize
+            alt_bytes[alt] = d[4];
+        if (d[1] == TUSB_DESC_ENDPOINT && d[2] == EP_ADDR_AUDIO_IN)
+            ep_size[alt] = rd16(&d[4]);
+    }
+
+    // TinyUSB parses exactly CFG_TUD_AUDIO_FUNC_1_DESC_LEN bytes from the IAD on
+    if (func_end - func_start != CFG_TUD_AUDIO_FUNC_1_DESC_LEN)
+    {
+        fprintf(stderr, "sim_usb: audio function is %u bytes, CFG_TUD_AUDIO_FUNC_1_DESC_LEN says %u\n",
+                func_end - func_start, (unsigned)CFG_TUD_AUDIO_FUNC_1_DESC_LEN);
+        return -1;
+    }
+    if (vendor_eps != 0)
+    {
+        fprintf(stderr, "sim_usb: vendor interface endpoint count does not match bNumEndpoints\n");
+        return -1;
+    }
+    if (func_end != total && dev[4] != TUSB_CLASS_MISC)
+    {
+        fprintf(stderr, "sim_usb: composite device without the IAD device class\n");
+        return -1;
+    }
+    mounted = true;
+    return 0;
+}
+
+uint16_t sim_usb_ep_size(uint8_t alt)         { return alt < MAX_ALTS ? ep_size[alt] : 0; }
+uint8_t  sim_usb_alt_bytes(uint8_t alt)       { return alt < MAX_ALTS ? alt_bytes[alt] : 0; }
+void     sim_usb_set_packet_sink(sim_packet_fn fn) { sink = fn; }
+void     sim_usb_sof(void)                    { sof_pending++; }
+void     sim_usb_set_frame(uint32_t frame)    { sof_frame = frame & 0x7FF; }
+void     sim_usb_set_sof_hook(sim_sof_fn fn)  { sof_hook = fn; }
+
+void sim_usb_set_rate(uint32_t rate)
+{
+    rate_req = rate;
+    rate_pending = true;
+}
+
+void sim_usb_set_alt(uint8_t alt)
+{
+    alt_req = alt;
+    alt_pending = true;
+}
+
+uint32_t sim_usb_get_rates(uint32_t *rates, uint32_t max)
+{
+    tusb_control_request_t req = {
+        .bmRequestType = 0xA1, .bRequest = AUDIO_CS_REQ_RANGE,
+        .wValue = AUDIO_CS_CTRL_SAM_FREQ << 8, .wIndex = AUDIO_ENTITY_CLOCK << 8 | AUDIO_ITF_AC,
+        .wLength = sizeof(ctrl_in),
+    };
+    ctrl_in_len = 0;
+    if (!tud_audio_get_req_entity_cb(0, &req) || ctrl_in_len < 2) return 0;
+
+    uint32_t n = rd16(ctrl_in);
+    for (uint32_t i = 0; i < n && i < max && 2 + 12 * (i + 1) <= ctrl_in_len; i++)
+        rates[i] = rd32(&ctrl_in[2 + 12 * i]);
+    return n < max ? n : max;
+}
+
+int sim_usb_vendor_in(uint8_t request, void *buf, uint16_t max)
+{
+    if (vendor_itf == 0xFF) return -1;
+    tusb_control_request_t req = {
+        .bmRequestType = 0xC1, .bRequest = request,          // vendor, interface, IN
+        .wValue = 0, .wIndex = vendor_itf, .wLength = max < sizeof(ctrl_in) ? max : sizeof(ctrl_in),
+    };
+    ctrl_in_len = 0;
+    if (!tud_vendor_control_xfer_cb(0, CONTROL_STAGE_SETUP, &req)) return -1;
+    memcpy(buf, ctrl_in, ctrl_in_len);
+    return ctrl_in_len;
+}
+
+void sim_usb_vendor_out(uint8_t request, uint16_t value)
+{
+    vendor_req = request;
+    vendor_value = value;
+    vendor_pending = true;
+}
+
+bool sim_usb_vendor_out_ok(void) { return vendor_ok; }
+
+void sim_usb_set_bulk_sink(sim_packet_fn fn, uint32_t bytes_per_ms)
+{
+    bulk_sink = fn;
+    bulk_per_ms = bytes_per_ms;
+}
+
+uint32_t sim_usb_bulk_pending(void) { return bulk_level; }
+
+// One frame of bulk IN: the host takes what the FIFO holds, up to its per-frame share
+static void bulk_frame(void)
+{
+    uint32_t n = bulk_level < bulk_per_ms ? bulk_level : bulk_per_ms;
+    if (!n) return;
+    if (bulk_sink) bulk_sink(bulk_fifo, (uint16_t)n);
+    memmove(bulk_fifo, &bulk_fifo[n], bulk_level - n);
+    bulk_level -= n;
+}
+
+void sim_usb_task(void)
+{
+    if (rate_pending)
+    {
+        rate_pending = false;
+        uint8_t buf[4] = { (uint8_t)rate_req, (uint8_t)(rate_req >> 8), (uint8_t)(rate_req >> 16), (uint8_t)(rate_req >> 24) };
+        tusb_control_request_t req = {
+            .bmRequestType = 0x21, .bRequest = AUDIO_CS_REQ_CUR,
+            .wValue = AUDIO_CS_CTRL_SAM_FREQ << 8, .wIndex = AUDIO_ENTITY_CLOCK << 8 | AUDIO_ITF_AC,
+            .wLength = 4,
+        };
+        if (!tud_audio_set_req_entity_cb(0, &req, buf))
+            fprintf(stderr, "sim_usb: SET CUR %u Hz stalled\n", rate_req);
+    }
+
+    if (alt_pending)
+    {
+        alt_pending = false;
+        tusb_control_request_t req = {
+            .bmRequestType = 0x01, .bRequest = 0x0B,         // SET_INTERFACE
+            .wValue = alt_req, .wIndex = AUDIO_ITF_AS, .wLength = 0,
+        };
+        if (cur_alt) tud_audio_set_itf_close_EP_cb(0, &req);
+        cur_alt = alt_req;
+        tud_audio_set_itf_cb(0, &req);
+    }
+
+    if (vendor_pending)
+    {
+        vendor_pending = false;
+        tusb_control_request_t req = {
+            .bmRequestType = 0x41, .bRequest = vendor_req,        // vendor, interface, OUT
+            .wValue = vendor_value, .wIndex = vendor_itf, .wLength = 0,
+        };
+        vendor_ok = vendor_itf != 0xFF && tud_vendor_control_xfer_cb(0, CONTROL_STAGE_SETUP, &req);
+    }
+
+    for (; sof_pending; sof_pending--)
+    {
+        bulk_frame();
+        sof_frame = (sof_frame + 1) & 0x7FF;
+        if (sof_hook) sof_hook();
+        if (sof_enabled) tud_sof_cb(sof_frame);
+        if (mounted && cur_alt)
+            tud_audio_tx_done_pre_load_cb(0, 0, EP_ADDR_AUDIO_IN, cur_alt);
+    }
+}
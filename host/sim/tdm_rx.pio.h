@@ -0,0 +1,31 @@
+// tdm_rx.pio.h — host simulation stand-in for the pioasm output of pio/tdm_rx.pio
+
+#ifndef SIM_TDM_RX_PIO_H
+#define SIM_TDM_RX_PIO_H
+
+#include "hardware/pio.h"
+
+#define tdm_rx_offset_entry_point 5u
+
+// As assembled: one-line `in pins, 1` (capture.c widens them), side-set in bits 12:11
+static const uint16_t tdm_rx_program_instructions[] = {
+    0x5001,     // in pins, 1          side 2
+    0x0040,     // jmp x--, 0          side 0
+    0x5001,     // in pins, 1          side 2
+    0xa822,     // mov x, y            side 1
+    0x5801,     // in pins, 1          side 3
+    0xa042,     // nop                 side 0
+};
+
+static const pio_program_t tdm_rx_program = {
+    tdm_rx_program_instructions, sizeof(tdm_rx_program_instructions) / sizeof(uint16_t), -1,
+};
+
+static inline pio_sm_config tdm_rx_program_get_default_config(uint offset)
+{
+    (void)offset;
+    pio_sm_config c = { 256, false, 32, false };
+    return c;
+}
+
+#endif // SIM_TDM_RX_PIO_H
@@ -0,0 +1,100 @@
+// tusb.h — host simulation stand-in for the TinyUSB device API the firmware uses
+//
+// sim_usb.c plays the host and the device stack: it walks the descriptors, issues
+// the audio class requests and calls the firmware's callbacks from tud_task().
+
+#ifndef SIM_TUSB_H
+#define SIM_TUSB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tusb_config.h"
+
+#define TU_ATTR_PACKED                      __attribute__((packed))
+#define TU_U16_HIGH(x)                      ((uint8_t)(((x) >> 8) & 0xFF))
+#define TU_U16_LOW(x)                       ((uint8_t)((x) & 0xFF))
+
+#define TUSB_DESC_DEVICE                    0x01
+#define TUSB_DESC_CONFIGURATION             0x02
+#define TUSB_DESC_STRING                    0x03
+#define TUSB_DESC_INTERFACE                 0x04
+#define TUSB_DESC_ENDPOINT                  0x05
+#define TUSB_DESC_INTERFACE_ASSOCIATION     0x0B
+#define TUSB_CLASS_AUDIO                    0x01
+#define TUSB_CLASS_MISC                     0xEF
+#define TUSB_CLASS_VENDOR_SPECIFIC          0xFF
+#define MISC_SUBCLASS_COMMON                0x02
+#define MISC_PROTOCOL_IAD                   0x01
+
+#define TUSB_REQ_TYPE_VENDOR                2
+#define TUSB_DIR_OUT                        0
+#define TUSB_DIR_IN                         1
+#define TUSB_XFER_BULK                      2
+#define CONTROL_STAGE_SETUP                 1
+
+#define AUDIO_CS_REQ_CUR                    0x01
+#define AUDIO_CS_REQ_RANGE                  0x02
+#define AUDIO_CS_CTRL_SAM_FREQ              0x01
+#define AUDIO_CS_CTRL_CLK_VALID             0x02
+
+typedef struct TU_ATTR_PACKED {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t  bDeviceClass;
+    uint8_t  bDeviceSubClass;
+    uint8_t  bDeviceProtocol;
+    uint8_t  bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t  iManufacturer;
+    uint8_t  iProduct;
+    uint8_t  iSerialNumber;
+    uint8_t  bNumConfigurations;
+} tusb_desc_device_t;
+
+typedef struct TU_ATTR_PACKED {
+    union {
+        struct TU_ATTR_PACKED {
+            uint8_t recipient : 5;
+            uint8_t type      : 2;
+            uint8_t direction : 1;
+        } bmRequestType_bit;
+        uint8_t bmRequestType;
+    };
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} tusb_control_request_t;
+
+// ---------- Device API ----------
+void     tusb_init(void);
+void     tud_task(void);                    // runs pending USB events, then yields core0
+void     tud_sof_cb_enable(bool enable);
+bool     tud_audio_n_mounted(uint8_t func_id);
+uint16_t tud_audio_write(const void *data, uint16_t len);
+bool     tud_audio_buffer_and_schedule_control_xfer(uint8_t rhport, tusb_control_request_t const *p_request,
+                                                    void *data, uint16_t len);
+bool     tud_control_xfer(uint8_t rhport, tusb_control_request_t const *request, void *buffer, uint16_t len);
+bool     tud_control_status(uint8_t rhport, tusb_control_request_t const *request);
+bool     tud_vendor_mounted(void);
+uint32_t tud_vendor_write(const void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_write_available(void);
+uint32_t tud_vendor_write_flush(void);
+
+// ---------- Callbacks implemented by the firmware ----------
+uint8_t const  *tud_descriptor_device_cb(void);
+uint8_t const  *tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+void tud_sof_cb(uint32_t frame_count);
+bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t func_id, uint8_t ep_in, uint8_t cur_alt_setting);
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request);
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf);
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request);
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request);
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request);
+
+#endif // SIM_TUSB_H
@@ -0,0 +1,162 @@
+// tdm_ref.c — host test harness for tdm_unpack() (samples.c) and the tdm_rx bus layout
+//
+// For every frame layout tdm_rx supports (8/16 slots x 16/24/32-bit slots x 1/2/4 data
+// lines, every data width that fits): random slot data is clocked through a bit-level
+// model of pio/tdm_rx.pio (N bits per BCLK, shift left, autopush at 32), unpacked and
+// mapped by tdm_unpack() with a scrambled slot map, and checked bit for bit against a
+// per-bit decode. Also reports the bus clocks at 48 kHz against a 125 MHz clk_sys, the
+// channels per GPIO, and host cycles / ns per unpacked frame.
+
+#include "samples.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define FS              48000
+#define CLK_SYS_HZ      125000000.0
+#define N_FRAMES        4800                // 100 ms
+#define MAX_OUT         16                  // mapped channels (what the USB streams carry)
+#define MAX_WORDS       (16 * 32 * TDM_MAX_LINES / 32)
+
+static uint32_t bus[N_FRAMES * TDM_MAX_BUS_CHANNELS];     // slot contents, slot_bits wide
+static uint32_t raw[N_FRAMES * MAX_WORDS];
+static int32_t  out[N_FRAMES * MAX_OUT];
+
+static uint32_t rng = 1;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// ---------- Bit-level model of pio/tdm_rx.pio ----------
+// BCLK b of a frame: slot b / slot_bits, MSB first; line l is `in` pin l
+static void clock_frames(const tdm_layout_t *t, uint32_t n_frames)
+{
+    uint32_t n_bus = t->n_slots * t->n_lines, bclks = t->n_slots * t->slot_bits;
+    uint32_t *w = raw, isr = 0, n = 0;
+    for (uint32_t f = 0; f < n_frames; f++)
+    {
+        const uint32_t *s = &bus[f * n_bus];
+        for (uint32_t b = 0; b < bclks; b++)
+        {
+            uint32_t slot = b / t->slot_bits, bit = b % t->slot_bits, pins = 0;
+            for (uint32_t l = 0; l < t->n_lines; l++)
+                pins |= ((s[l * t->n_slots + slot] >> (t->slot_bits - 1 - bit)) & 1u) << l;
+            isr = (isr << t->n_lines) | pins;
+            n += t->n_lines;
+            if (n == 32)
+            {
+                *w++ = isr;
+                isr = 0;
+                n = 0;
+            }
+        }
+    }
+}
+
+// Expected channel c of frame f, straight from the slot contents
+static int32_t expect(const tdm_layout_t *t, uint32_t f, uint32_t c)
+{
+    uint32_t n_bus = t->n_slots * t->n_lines;
+    if (t->map[c] >= n_bus) return 0;
+    uint32_t v = bus[f * n_bus + t->map[c]] << (32 - t->slot_bits);
+    return (int32_t)(v & ~0u << (32 - t->data_bits));
+}
+
+// Up to MAX_OUT bus channels in random order, the last one unmapped
+static uint32_t make_map(uint8_t *map, uint32_t n_bus)
+{
+    uint8_t perm[TDM_MAX_BUS_CHANNELS];
+    for (uint32_t i = 0; i < n_bus; i++) perm[i] = (uint8_t)i;
+    for (uint32_t i = n_bus - 1; i > 0; i--)
+    {
+        uint32_t j = rand32() % (i + 1);
+        uint8_t  x = perm[i];
+        perm[i] = perm[j];
+        perm[j] = x;
+    }
+    uint32_t n = n_bus + 1 < MAX_OUT ? n_bus + 1 : MAX_OUT;
+    memcpy(map, perm, n - 1);
+    map[n - 1] = 0xFF;
+    return n;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static const uint32_t slot_counts[] = { 8, 16 };
+    static const uint32_t slot_widths[] = { 16, 24, 32 };
+    static const uint32_t data_widths[] = { 16, 24, 32 };
+    static const uint32_t line_counts[] = { 1, 2, 4 };
+    int fail = 0;
+
+    printf("slots  bits  data  lines  bus ch  words  BCLK[MHz]  clkdiv  ch/pin  out ch  bit-exact  "
+           "cyc/frame  ns/frame\n");
+
+    for (uint32_t si = 0; si < 2; si++)
+        for (uint32_t wi = 0; wi < 3; wi++)
+            for (uint32_t di = 0; di < 3; di++)
+                for (uint32_t li = 0; li < 3; li++)
+                {
+                    uint8_t map[MAX_OUT];
+                    tdm_layout_t t = { slot_counts[si], slot_widths[wi], data_widths[di], line_counts[li], 0, map };
+                    if (t.data_bits > t.slot_bits) continue;
+                    uint32_t n_bus = t.n_slots * t.n_lines;
+                    t.n_channels = make_map(map, n_bus);
+
+                    // Random slots through the PIO model, then unpack + map
+                    uint32_t keep = t.slot_bits == 32 ? ~0u : (1u << t.slot_bits) - 1;
+                    for (uint32_t i = 0; i < N_FRAMES * n_bus; i++)
+                        bus[i] = rand32() & keep;
+                    clock_frames(&t, N_FRAMES);
+                    tdm_unpack(&t, raw, out, N_FRAMES);
+
+                    uint32_t bad = 0;
+                    for (uint32_t f = 0; f < N_FRAMES; f++)
+                        for (uint32_t c = 0; c < t.n_channels; c++)
+                            if (out[f * t.n_channels + c] != expect(&t, f, c)) bad++;
+                    if (bad) fail = 1;
+
+                    // Timing: 10 passes over the whole buffer
+                    uint32_t reps = 10;
+                    double t0 = now_ns();
+#ifdef HAVE_TSC
+                    uint64_t c0 = __rdtsc();
+#endif
+                    for (uint32_t r = 0; r < reps; r++)
+                        tdm_unpack(&t, raw, out, N_FRAMES);
+#ifdef HAVE_TSC
+                    double cyc = (double)(__rdtsc() - c0) / (reps * N_FRAMES);
+#else
+                    double cyc = 0;
+#endif
+                    double ns = (now_ns() - t0) / (reps * N_FRAMES);
+
+                    // 2 PIO instructions per BCLK
+                    double bclk = (double)t.n_slots * t.slot_bits * FS;
+                    double div = CLK_SYS_HZ / (2 * bclk);
+                    printf("%5u  %4u  %4u  %5u  %6u  %5u  %9.3f  %6.3f%s  %6.2f  %6u  %9s  %9.1f  %8.1f\n",
+                           t.n_slots, t.slot_bits, t.data_bits, t.n_lines, n_bus, tdm_words_per_frame(&t),
+                           bclk / 1e6, div, div < 1 ? "!" : " ", (double)n_bus / (t.n_lines + 2),
+                           t.n_channels, bad ? "FAIL" : "ok", cyc, ns);
+                }
+
+    printf("\nBCLK/clkdiv at %u Hz with clk_sys %.0f MHz (! = PIO too slow); ch/pin counts BCLK and FSYNC;\n"
+           "i2s_rx3 for comparison: 6 ch on 5 pins = 1.20 ch/pin\n", FS, CLK_SYS_HZ / 1e6);
+    return fail;
+}
@@ -0,0 +1,132 @@
+// telemetry_decode.c — checks and prints telemetry.h snapshots (host side)
+
+#include "telemetry_decode.h"
+#include <stddef.h>
+#include <string.h>
+
+int telemetry_decode(const void *buf, int len, telemetry_snapshot_t *out)
+{
+    if (len < 8)
+    {
+        fprintf(stderr, "telemetry: short reply (%d bytes)\n", len);
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    memcpy(out, buf, (size_t)len < sizeof(*out) ? (size_t)len : sizeof(*out));
+
+    if (out->magic != TELEMETRY_MAGIC || out->version != TELEMETRY_VERSION)
+    {
+        fprintf(stderr, "telemetry: magic %08x version %u, expected %08x version %u\n",
+                out->magic, out->version, TELEMETRY_MAGIC, TELEMETRY_VERSION);
+        return -1;
+    }
+    if (out->size != sizeof(*out) || len != (int)sizeof(*out))
+    {
+        fprintf(stderr, "telemetry: snapshot is %d bytes (device says %u), expected %zu\n",
+                len, out->size, sizeof(*out));
+        return -1;
+    }
+    return 0;
+}
+
+void telemetry_decode_names(const void *buf, int len, telemetry_names_t *names)
+{
+    const char *p = buf, *end = p + (len > 0 ? len : 0);
+    names->n = 0;
+    while (p < end && names->n < TELEMETRY_MAX_STAGES)
+    {
+        size_t n = strnlen(p, (size_t)(end - p));
+        snprintf(names->name[names->n++], TELEMETRY_MAX_NAME, "%.*s", (int)n, p);
+        p += n + 1;
+    }
+}
+
+// ---------- Printing ----------
+static void counter(FILE *f, const char *label, uint32_t cur, uint32_t prev, double dt)
+{
+    fprintf(f, "  %s %u", label, cur);
+    if (dt > 0) fprintf(f, " (+%.0f/s)", (uint32_t)(cur - prev) / dt);
+}
+
+// Histogram at byte offset off in the (packed) snapshot: non-empty bins only, counts
+// since prev; label(b) names bin b.
+static void hist(FILE *f, const telemetry_snapshot_t *c, const telemetry_snapshot_t *p, size_t off,
+                 const char *(*label)(uint32_t))
+{
+    uint32_t cur[TELEMETRY_HIST_BINS], prev[TELEMETRY_HIST_BINS] = { 0 };
+    memcpy(cur, (const uint8_t *)c + off, sizeof(cur));
+    if (p) memcpy(prev, (const uint8_t *)p + off, sizeof(prev));
+    for (uint32_t b = 0; b < TELEMETRY_HIST_BINS; b++)
+        if (cur[b] != prev[b]) fprintf(f, "  %s:%u", label(b), cur[b] - prev[b]);
+    fprintf(f, "\n");
+}
+
+static const char *us_label(uint32_t b)
+{
+    static char s[16];
+    if (b == 0)                            snprintf(s, sizeof(s), "0us");
+    else if (b == TELEMETRY_HIST_BINS - 1) snprintf(s, sizeof(s), ">=%uus", 1u << (b - 1));
+    else                                   snprintf(s, sizeof(s), "<%uus", 1u << b);
+    return s;
+}
+
+static const char *budget_label(uint32_t b)
+{
+    static char s[16];
+    if (b == TELEMETRY_HIST_BINS - 1) snprintf(s, sizeof(s), ">=%u%%", 100 * b / TELEMETRY_HIST_BINS);
+    else                              snprintf(s, sizeof(s), "<%u%%", 100 * (b + 1) / TELEMETRY_HIST_BINS);
+    return s;
+}
+
+void telemetry_print(FILE *f, const telemetry_snapshot_t *cur, const telemetry_snapshot_t *prev,
+                     const telemetry_names_t *names)
+{
+    const telemetry_snapshot_t *p = prev ? prev : cur;
+    double dt = prev ? (uint32_t)(cur->time_us - prev->time_us) / 1e6 : 0;
+    double us_per_cycle = cur->clk_sys_hz ? 1e6 / cur->clk_sys_hz : 0;
+
+    fprintf(f, "device     %u Hz (capture %u), %u-bit, %u ch, %s core; up %.3f s",
+            cur->sample_rate, cur->capture_rate, 8 * cur->sample_bytes, cur->n_channels,
+            cur->dual_core ? "dual" : "single", cur->time_us / 1e6);
+    if (prev) fprintf(f, ", interval %.3f s", dt);
+
+    fprintf(f, "\ncapture  ");
+    counter(f, "frames", cur->frames, p->frames, dt);
+    counter(f, "DMA blocks", cur->dma_blocks, p->dma_blocks, dt);
+    counter(f, "overruns", cur->overruns, p->overruns, dt);
+    counter(f, "underruns", cur->underruns, p->underruns, dt);
+    fprintf(f, "  ring %u/%u frames\n", cur->ring_fill, cur->ring_frames);
+
+    fprintf(f, "usb IN   ");
+    counter(f, "SOFs", cur->sofs, p->sofs, dt);
+    counter(f, "packets", cur->in_packets, p->in_packets, dt);
+    counter(f, "empty", cur->in_empty, p->in_empty, dt);
+    counter(f, "late", cur->in_late, p->in_late, dt);
+    counter(f, "missed", cur->in_missed, p->in_missed, dt);
+    fprintf(f, "\n           callback busy %.2f%%, SOF -> callback max %u us\n",
+            dt > 0 ? (uint32_t)(cur->in_busy_us - p->in_busy_us) / (dt * 1e4)
+                   : cur->time_us ? cur->in_busy_us * 100.0 / cur->time_us : 0,
+            cur->in_latency_max_us);
+    fprintf(f, "  latency ");
+    hist(f, cur, prev, offsetof(telemetry_snapshot_t, in_latency_hist), us_label);
+    fprintf(f, "  duration");
+    hist(f, cur, prev, offsetof(telemetry_snapshot_t, in_duration_hist), us_label);
+
+    fprintf(f, "stages     clk_sys %.1f MHz, budget %u cycles/packet, queue %u",
+            cur->clk_sys_hz / 1e6, cur->budget, cur->queue_depth);
+    counter(f, "packets", cur->packets, p->packets, dt);
+    counter(f, "over budget", cur->over_budget, p->over_budget, dt);
+    fprintf(f, "\n         ");
+    for (uint32_t s = 0; s < cur->n_stages && s < TELEMETRY_MAX_STAGES; s++)
+        fprintf(f, "  %s %u/%u", names && s < names->n ? names->name[s] : "?",
+                cur->stage_avg[s], cur->stage_max[s]);
+    fprintf(f, "  (avg/max cycles)\n           total avg %u max %u cycles (%.1f/%.1f us)",
+            cur->total_avg, cur->total_max, cur->total_avg * us_per_cycle, cur->total_max * us_per_cycle);
+    if (dt > 0 && cur->clk_sys_hz)
+        fprintf(f, ", core load %.1f%%", (uint32_t)(cur->busy_cycles - prev->busy_cycles) * 100.0 /
+                                         (dt * cur->clk_sys_hz));
+    fprintf(f, "\n  budget  ");
+    hist(f, cur, prev, offsetof(telemetry_snapshot_t, cycle_hist), budget_label);
+
+    fprintf(f, "drift      %+d ppm (%u windows)\n", cur->drift_ppm, cur->drift_windows);
+}
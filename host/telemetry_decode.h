@@ -0,0 +1,30 @@
+// telemetry_decode.h — checks and prints telemetry.h snapshots (host side)
+//
+// Shared by telemetry_read (libusb, real device) and pipeline_sim (simulated device).
+
+#ifndef TELEMETRY_DECODE_H
+#define TELEMETRY_DECODE_H
+
+#include "telemetry.h"
+#include <stdio.h>
+
+#define TELEMETRY_MAX_NAME  16
+
+typedef struct {
+    uint32_t n;
+    char     name[TELEMETRY_MAX_STAGES][TELEMETRY_MAX_NAME];
+} telemetry_names_t;
+
+// Copies a received snapshot out of buf (little-endian host). 0, or -1 with a
+// message on stderr if the magic, version or size do not match.
+int telemetry_decode(const void *buf, int len, telemetry_snapshot_t *out);
+
+// Splits the TELEMETRY_REQ_STAGE_NAMES reply.
+void telemetry_decode_names(const void *buf, int len, telemetry_names_t *names);
+
+// Prints a snapshot; with prev (an earlier snapshot of the same device), counters are
+// also shown as rates and the load over the interval.
+void telemetry_print(FILE *f, const telemetry_snapshot_t *cur, const telemetry_snapshot_t *prev,
+                     const telemetry_names_t *names);
+
+#endif // TELEMETRY_DECODE_H
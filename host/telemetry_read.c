@@ -0,0 +1,107 @@
+// telemetry_read.c — reads telemetry snapshots from the device over USB (libusb)
+//
+// Claims only the telemetry interface, so the audio interfaces stay with the OS
+// driver and the stream is not interrupted. Each poll is one vendor control
+// request on EP0; with --interval the counters are also shown as rates.
+//
+//   telemetry_read [--interval S] [--count N] [--vid 0xCAFE --pid 0x4066]
+
+#include "telemetry_decode.h"
+#include <libusb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_VID     0xCAFE
+#define DEFAULT_PID     0x4066
+#define TIMEOUT_MS      500
+#define REQ_TYPE_IN     (LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE)
+
+static double   opt_interval = 0;       // 0: one snapshot
+static uint32_t opt_count    = 0;       // 0: until interrupted (with --interval)
+static uint16_t opt_vid      = DEFAULT_VID;
+static uint16_t opt_pid      = DEFAULT_PID;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: telemetry_read [--interval S] [--count N] [--vid ID --pid ID]\n");
+    exit(1);
+}
+
+static void parse(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) usage();
+        const char *k = argv[i], *v = argv[++i];
+        if      (!strcmp(k, "--interval")) opt_interval = atof(v);
+        else if (!strcmp(k, "--count"))    opt_count    = (uint32_t)strtoul(v, NULL, 0);
+        else if (!strcmp(k, "--vid"))      opt_vid      = (uint16_t)strtoul(v, NULL, 0);
+        else if (!strcmp(k, "--pid"))      opt_pid      = (uint16_t)strtoul(v, NULL, 0);
+        else usage();
+    }
+}
+
+static int request(libusb_device_handle *h, uint8_t req, void *buf, uint16_t len)
+{
+    int n = libusb_control_transfer(h, REQ_TYPE_IN, req, 0, TELEMETRY_ITF, buf, len, TIMEOUT_MS);
+    if (n < 0) fprintf(stderr, "telemetry_read: request %u: %s\n", req, libusb_error_name(n));
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    parse(argc, argv);
+
+    if (libusb_init(NULL) != 0)
+    {
+        fprintf(stderr, "telemetry_read: libusb_init failed\n");
+        return 1;
+    }
+    libusb_device_handle *h = libusb_open_device_with_vid_pid(NULL, opt_vid, opt_pid);
+    if (!h)
+    {
+        fprintf(stderr, "telemetry_read: no device %04x:%04x (or no permission)\n", opt_vid, opt_pid);
+        libusb_exit(NULL);
+        return 1;
+    }
+    int rc = libusb_claim_interface(h, TELEMETRY_ITF);
+    if (rc != 0)
+    {
+        fprintf(stderr, "telemetry_read: claim interface %u: %s\n", TELEMETRY_ITF, libusb_error_name(rc));
+        libusb_close(h);
+        libusb_exit(NULL);
+        return 1;
+    }
+
+    uint8_t buf[1024];
+    telemetry_names_t names;
+    int n = request(h, TELEMETRY_REQ_STAGE_NAMES, buf, sizeof(buf));
+    telemetry_decode_names(buf, n, &names);
+
+    telemetry_snapshot_t cur, prev;
+    bool have_prev = false;
+    int status = 0;
+    for (uint32_t i = 0; !opt_count || i < opt_count; i++)
+    {
+        n = request(h, TELEMETRY_REQ_SNAPSHOT, buf, sizeof(buf));
+        if (n < 0 || telemetry_decode(buf, n, &cur) != 0)
+        {
+            status = 1;
+            break;
+        }
+        if (i) printf("\n");
+        telemetry_print(stdout, &cur, have_prev ? &prev : NULL, &names);
+        fflush(stdout);
+
+        prev = cur;
+        have_prev = true;
+        if (opt_interval <= 0) break;
+        usleep((useconds_t)(opt_interval * 1e6));
+    }
+
+    libusb_release_interface(h, TELEMETRY_ITF);
+    libusb_close(h);
+    libusb_exit(NULL);
+    return status;
+}
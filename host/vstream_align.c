@@ -0,0 +1,362 @@
+// vstream_align.c — SOF-stamp fits and windowed-sinc resampling onto device 0's timeline
+
+#include "vstream_align.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KAISER_BETA     8.0
+#define HALF            (VALIGN_TAPS / 2)
+
+// ---------- Interpolation kernel ----------
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 40; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Phase p: taps for frames i - HALF + 1 .. i + HALF around position i + p / VALIGN_PHASES,
+// Kaiser-windowed sinc, unity DC gain. Phase 0 is a plain pass-through.
+static void build_kernel(valign_t *a)
+{
+    for (uint32_t p = 0; p <= VALIGN_PHASES; p++)
+    {
+        double frac = (double)p / VALIGN_PHASES, k[VALIGN_TAPS], sum = 0;
+        for (uint32_t t = 0; t < VALIGN_TAPS; t++)
+        {
+            double x = (double)t - (HALF - 1) - frac;
+            double r = x / HALF;
+            double w = r * r < 1 ? bessel_i0(KAISER_BETA * sqrt(1 - r * r)) / bessel_i0(KAISER_BETA) : 0;
+            k[t] = (fabs(x) < 1e-12 ? 1 : sin(M_PI * x) / (M_PI * x)) * w;
+            sum += k[t];
+        }
+        for (uint32_t t = 0; t < VALIGN_TAPS; t++)
+            a->kernel[p][t] = (float)(k[t] / sum);
+    }
+}
+
+int valign_init(valign_t *a, uint32_t n_dev, uint32_t sample_rate, valign_out_fn fn, void *ctx)
+{
+    if (n_dev < 1 || n_dev > VALIGN_MAX_DEVICES) return -1;
+    memset(a, 0, sizeof(*a));
+    a->n_dev = n_dev;
+    a->sample_rate = sample_rate;
+    a->fn = fn;
+    a->ctx = ctx;
+    build_kernel(a);
+    return 0;
+}
+
+void valign_free(valign_t *a)
+{
+    for (uint32_t d = 0; d < a->n_dev; d++)
+    {
+        free(a->dev[d].hist);
+        a->dev[d].hist = NULL;
+    }
+}
+
+// ---------- Fits ----------
+// Least-squares slope of y over x, and both means
+static double line(const double *x, const double *y, uint32_t n, double *mx, double *my)
+{
+    double sx = 0, sy = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        sx += x[i];
+        sy += y[i];
+    }
+    *mx = sx / n;
+    *my = sy / n;
+    double sxx = 0, sxy = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        sxx += (x[i] - *mx) * (x[i] - *mx);
+        sxy += (x[i] - *mx) * (y[i] - *my);
+    }
+    return sxx > 0 ? sxy / sxx : 0;
+}
+
+static void fit(valign_t *a, valign_dev_t *v)
+{
+    uint32_t n = v->n_st < VALIGN_FIT_STAMPS ? (uint32_t)v->n_st : VALIGN_FIT_STAMPS;
+    uint32_t last = (uint32_t)((v->n_st - 1) % VALIGN_FIT_STAMPS);
+    int64_t  sof_ref = v->st_sof[last];
+    double   pos_ref = v->st_pos[last], time_ref = v->st_time[last];
+
+    // Relative to the newest stamp, so the sums keep their precision
+    for (uint32_t i = 0; i < n; i++)
+    {
+        a->fx[i] = (double)(v->st_sof[i] - sof_ref);
+        a->fy[i] = v->st_pos[i] - pos_ref;
+        a->ft[i] = v->st_time[i] - time_ref;
+    }
+    // Device time over SOF along the lower envelope: the earliest callback in each of
+    // VALIGN_ENV_CHUNKS runs of stamps (picked against a nominal 1000 us per SOF), as
+    // a line through all of them tilts with the callback delays
+    uint32_t first = n < VALIGN_FIT_STAMPS ? 0 : (last + 1) % VALIGN_FIT_STAMPS;
+    double   ex[VALIGN_ENV_CHUNKS], et[VALIGN_ENV_CHUNKS];
+    for (uint32_t c = 0; c < VALIGN_ENV_CHUNKS; c++)
+    {
+        uint32_t best = 0;
+        double   low = INFINITY;
+        for (uint32_t k = c * n / VALIGN_ENV_CHUNKS; k < (c + 1) * n / VALIGN_ENV_CHUNKS; k++)
+        {
+            uint32_t i = (first + k) % VALIGN_FIT_STAMPS;
+            double   e = a->ft[i] - 1000 * a->fx[i];
+            if (e < low)
+            {
+                low = e;
+                best = i;
+            }
+        }
+        ex[c] = a->fx[best];
+        et[c] = a->ft[best];
+    }
+    double mx, my, mt;
+    double us_per_sof = line(ex, et, VALIGN_ENV_CHUNKS, &mx, &mt);
+    double rate = line(a->fx, a->fy, n, &mx, &my);
+
+    // Move each position back to its SOF: the callback's delay over the shortest one,
+    // at the device's frames per microsecond
+    double dmin = INFINITY, dsum = 0;
+    for (uint32_t i = 0; i < n; i++)
+        dmin = fmin(dmin, a->ft[i] - us_per_sof * a->fx[i]);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        double delay = a->ft[i] - us_per_sof * a->fx[i] - dmin;
+        dsum += delay;
+        if (us_per_sof > 0) a->fy[i] -= delay * rate / us_per_sof;
+    }
+    rate = line(a->fx, a->fy, n, &mx, &my);
+
+    v->fit      = true;
+    v->fit_at   = v->n_st;
+    v->fit_sof  = sof_ref;
+    v->fit_rate = rate;
+    v->fit_pos  = pos_ref + my - rate * mx;
+    v->stats.delay_us  = dsum / n;
+    v->stats.clock_ppm = (rate * 1000 / a->sample_rate - 1) * 1e6;
+}
+
+static void add_stamp(valign_t *a, valign_dev_t *v, int64_t start, const vstream_stamp_t *st)
+{
+    // Unwrap the device's 32-bit counters; blocks coded within one SOF repeat its stamp
+    int64_t sof  = v->n_st ? v->sof_last + (int32_t)(st->sof - v->sof_raw) : st->sof;
+    int64_t time = v->n_st ? v->time_last + (int32_t)(st->sof_time_us - v->time_raw) : st->sof_time_us;
+    if (v->n_st && sof <= v->sof_last) return;
+    if (!v->n_st) v->sof_first = sof;
+    v->sof_raw   = st->sof;
+    v->time_raw  = st->sof_time_us;
+    v->sof_last  = sof;
+    v->time_last = time;
+
+    uint32_t i = (uint32_t)(v->n_st % VALIGN_FIT_STAMPS);
+    v->st_sof[i]  = sof;
+    v->st_pos[i]  = (double)start + st->pos_q8 / 256.0;
+    v->st_time[i] = (double)time;
+    v->n_st++;
+    v->stats.stamps++;
+
+    if (v->n_st >= VALIGN_MIN_STAMPS && (!v->fit || v->n_st - v->fit_at >= VALIGN_REFIT_STAMPS))
+        fit(a, v);
+}
+
+// Puts every device's SOF count on device 0's numbering: the multiple of 2048 that
+// brings its first stamp closest to device 0's.
+static bool resolve(valign_t *a)
+{
+    for (uint32_t d = 0; d < a->n_dev; d++)
+        if (!a->dev[d].n_st) return false;
+    for (uint32_t d = 1; d < a->n_dev; d++)
+    {
+        double k = round((double)(a->dev[0].sof_first - a->dev[d].sof_first) / 2048);
+        a->dev[d].sof_offset = (int64_t)k * 2048;
+    }
+    a->resolved = true;
+    return true;
+}
+
+// Device v's stream position at SOF `sof` of device 0's numbering
+static inline double dev_pos(const valign_dev_t *v, double sof)
+{
+    return v->fit_pos + v->fit_rate * (sof - (double)(v->fit_sof + v->sof_offset));
+}
+
+// Oldest frame still in a device's history
+static inline int64_t dev_oldest(const valign_dev_t *v)
+{
+    int64_t lo = v->next - (int64_t)VALIGN_HIST_FRAMES;
+    return lo > v->first ? lo : v->first;
+}
+
+// ---------- Output ----------
+static inline int32_t to_int(double x, uint32_t bits)
+{
+    double full = (double)(1u << (bits - 1));
+    double s = floor(x * full + 0.5);
+    if (s > full - 1) s = full - 1;
+    if (s < -full) s = -full;
+    return (int32_t)s;
+}
+
+static inline float *frame_at(const valign_dev_t *v, int64_t i)
+{
+    return &v->hist[(size_t)((uint64_t)i & (VALIGN_HIST_FRAMES - 1)) * v->n_ch];
+}
+
+// Device v at position x into o[0 .. n_ch)
+static void interpolate(const valign_t *a, const valign_dev_t *v, double x, int32_t *o)
+{
+    int64_t i = (int64_t)floor(x);
+    double  f = (x - (double)i) * VALIGN_PHASES;
+    uint32_t p = (uint32_t)f;
+    if (p >= VALIGN_PHASES) p = VALIGN_PHASES - 1;
+    float w = (float)(f - p), k[VALIGN_TAPS];
+    for (uint32_t t = 0; t < VALIGN_TAPS; t++)
+        k[t] = a->kernel[p][t] + w * (a->kernel[p + 1][t] - a->kernel[p][t]);
+
+    float acc[LOSSLESS_MAX_CHANNELS] = { 0 };
+    for (uint32_t t = 0; t < VALIGN_TAPS; t++)
+    {
+        const float *s = frame_at(v, i - (HALF - 1) + t);
+        for (uint32_t c = 0; c < v->n_ch; c++)
+            acc[c] += k[t] * s[c];
+    }
+    for (uint32_t c = 0; c < v->n_ch; c++)
+        o[c] = to_int(acc[c], a->bits);
+}
+
+// First output frame: every device has VALIGN_TAPS frames of history before it
+static void start_output(valign_t *a)
+{
+    valign_dev_t *r = &a->dev[0];
+    double sof = -INFINITY;
+    a->n_channels = 0;
+    a->bits = 0;
+    for (uint32_t d = 0; d < a->n_dev; d++)
+    {
+        valign_dev_t *v = &a->dev[d];
+        double lo = (double)(dev_oldest(v) + VALIGN_TAPS);
+        sof = fmax(sof, (lo - v->fit_pos) / v->fit_rate + (double)(v->fit_sof + v->sof_offset));
+        a->n_channels += v->n_ch;
+        if (v->bits > a->bits) a->bits = v->bits;
+    }
+    a->out_frame = (int64_t)ceil(dev_pos(r, sof));
+    a->out_started = true;
+}
+
+static void emit(valign_t *a)
+{
+    if (!a->resolved && !resolve(a)) return;
+    for (uint32_t d = 0; d < a->n_dev; d++)
+        if (!a->dev[d].fit) return;
+    if (!a->out_started) start_output(a);
+
+    valign_dev_t *r = &a->dev[0];
+    double sof_now = (double)r->fit_sof;
+    for (uint32_t d = 0; d < a->n_dev; d++)
+    {
+        valign_dev_t *v = &a->dev[d];
+        v->stats.ref_ppm   = (v->fit_rate / r->fit_rate - 1) * 1e6;
+        v->stats.offset_ms = (dev_pos(v, sof_now) - dev_pos(r, sof_now)) * 1000 / a->sample_rate;
+    }
+
+    // Output trails every device's newest fitted stamp by VALIGN_LAG_SOFS
+    double sof_max = INFINITY;
+    if (!a->flushing)
+        for (uint32_t d = 0; d < a->n_dev; d++)
+            sof_max = fmin(sof_max, (double)(a->dev[d].fit_sof + a->dev[d].sof_offset) - VALIGN_LAG_SOFS);
+
+    uint32_t n = 0;
+    while (a->out_frame < r->next)
+    {
+        int32_t *o = &a->out[n * a->n_channels];
+        double sof = (double)r->fit_sof + ((double)a->out_frame - r->fit_pos) / r->fit_rate;
+        bool room = r->next - a->out_frame < (int64_t)VALIGN_HIST_FRAMES / 2;
+        bool wait = false;
+        if (sof > sof_max && room) break;           // device 0 has room: wait for later fits
+
+        // The reference passes through; the others are read at the same instant
+        const float *s0 = frame_at(r, a->out_frame);
+        for (uint32_t c = 0; c < r->n_ch; c++)
+            o[c] = to_int(s0[c], a->bits);
+        o += r->n_ch;
+
+        for (uint32_t d = 1; d < a->n_dev && !wait; d++)
+        {
+            valign_dev_t *v = &a->dev[d];
+            double x = dev_pos(v, sof);
+            int64_t i = (int64_t)floor(x);
+            if (i + HALF >= v->next && room && !a->flushing)
+                wait = true;                        // not received yet: wait while device 0 has room
+            else if (i + HALF >= v->next || i - (HALF - 1) < dev_oldest(v))
+            {
+                memset(o, 0, v->n_ch * sizeof(*o));
+                v->stats.late_frames++;
+            }
+            else
+                interpolate(a, v, x, o);
+            o += v->n_ch;
+        }
+        if (wait) break;
+
+        a->out_frame++;
+        a->out_frames++;
+        if (++n == VALIGN_OUT_FRAMES)
+        {
+            a->fn(a->ctx, a->out, n);
+            n = 0;
+        }
+    }
+    if (n) a->fn(a->ctx, a->out, n);
+}
+
+// ---------- Input ----------
+void valign_block(valign_t *a, uint32_t dev, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                  const int32_t *samples, uint32_t lost)
+{
+    if (dev >= a->n_dev) return;
+    valign_dev_t *v = &a->dev[dev];
+    if (!v->started)
+    {
+        v->hist = calloc((size_t)VALIGN_HIST_FRAMES * h->n_channels, sizeof(float));
+        if (!v->hist) return;
+        v->n_ch = h->n_channels;
+        v->bits = h->bits;
+        v->first = v->next = h->frame;
+        v->started = true;
+        lost = 0;
+    }
+    if (h->n_channels != v->n_ch || h->bits != v->bits) return;    // restarted in another format
+
+    // Skipped frames become silence in the history
+    int64_t start = v->next + lost;
+    for (int64_t i = lost > VALIGN_HIST_FRAMES ? start - VALIGN_HIST_FRAMES : v->next; i < start; i++)
+        memset(frame_at(v, i), 0, v->n_ch * sizeof(float));
+
+    float scale = 1.0f / (float)(1u << (v->bits - 1));
+    for (uint32_t f = 0; f < h->n_frames; f++)
+    {
+        float *d = frame_at(v, start + (int64_t)f);
+        for (uint32_t c = 0; c < v->n_ch; c++)
+            d[c] = (float)samples[f * v->n_ch + c] * scale;
+    }
+    v->next = start + h->n_frames;
+    v->stats.blocks++;
+    v->stats.lost_frames += lost;
+
+    if (stamp) add_stamp(a, v, start, stamp);
+    emit(a);
+}
+
+void valign_flush(valign_t *a)
+{
+    a->flushing = true;
+    emit(a);
+}
@@ -0,0 +1,114 @@
+// vstream_align.h — merges the stamped bulk streams of several devices into one
+// sample-aligned stream (host side)
+//
+// Devices on one USB bus see the same SOFs. A stamped block (vstream.h) says where its
+// stream stood at a SOF, so a straight line through a device's last VALIGN_FIT_STAMPS
+// stamps (stream position over SOF number) gives both its offset and its clock against
+// the bus. Device 0 is the reference: its samples pass through untouched and set the
+// output timeline. Every other device is resampled onto it with a windowed-sinc
+// interpolator, at the position its own line gives for the same instant, so clock drift
+// between the devices is taken out continuously. Frames a device skipped are silence;
+// so are output frames a device had no samples for in time (counted as late).
+//
+// A line is best determined in the middle of its stamps, so the output trails the
+// newest stamps by half a fit (VALIGN_LAG_SOFS, ~1 s); valign_flush() emits the rest
+// when the streams end.
+//
+// The SOF callback reads the position a variable few microseconds after the SOF. The
+// fit moves every stamp back by its delay over the shortest one, measured with the
+// device timer (sof_time_us) against the lower envelope of device time over SOF.
+//
+// The 11-bit USB frame number repeats every 2048 ms, so the extended SOF counts of two
+// devices can differ by a multiple of 2048: the first stamps of all devices are taken
+// to be less than a second apart (start the streams together).
+
+#ifndef VSTREAM_ALIGN_H
+#define VSTREAM_ALIGN_H
+
+#include "vstream.h"
+#include "lossless.h"
+#include <stdbool.h>
+
+#define VALIGN_MAX_DEVICES      8
+#define VALIGN_MAX_CHANNELS     (VALIGN_MAX_DEVICES * LOSSLESS_MAX_CHANNELS)
+#define VALIGN_TAPS             16              // interpolator length, even
+#define VALIGN_PHASES           256             // kernel table steps per frame, linear in between
+#define VALIGN_FIT_STAMPS       2048            // stamps per fit (~2 s)
+#define VALIGN_MIN_STAMPS       256             // before a device's first fit
+#define VALIGN_REFIT_STAMPS     64              // new stamps between fits
+#define VALIGN_ENV_CHUNKS       16              // lower-envelope points for the SOF callback delay
+#define VALIGN_LAG_SOFS         (VALIGN_FIT_STAMPS / 2)
+#define VALIGN_HIST_FRAMES      (1u << 18)      // samples kept per device (5.5 s at 48 kHz)
+#define VALIGN_OUT_FRAMES       256             // frames per output call
+
+typedef struct {
+    uint64_t blocks;
+    uint64_t stamps;                // used (one per SOF; repeats are dropped)
+    uint64_t lost_frames;           // skipped by the device, merged as silence
+    uint64_t late_frames;           // output frames this device had no samples for in time
+    double   clock_ppm;             // stream rate against the USB frame clock
+    double   ref_ppm;               // stream rate against device 0
+    double   offset_ms;             // stream position minus device 0's at the same SOF
+    double   delay_us;              // SOF callback delay over the shortest, mean of the last fit
+} valign_dev_stats_t;
+
+typedef struct {
+    // Stamps (ring of the last VALIGN_FIT_STAMPS): SOF, stream position there, device time
+    int64_t  st_sof[VALIGN_FIT_STAMPS];
+    double   st_pos[VALIGN_FIT_STAMPS];
+    double   st_time[VALIGN_FIT_STAMPS];
+    uint64_t n_st;
+    int64_t  sof_first;             // unwrapped, device numbering
+    int64_t  sof_offset;            // multiple of 2048 onto device 0's numbering
+    uint32_t sof_raw, time_raw;     // last raw values, for unwrapping
+    int64_t  sof_last, time_last;
+
+    // Fit: stream position = fit_pos + fit_rate * (sof - fit_sof)
+    bool     fit;
+    int64_t  fit_sof;
+    double   fit_pos, fit_rate;
+    uint64_t fit_at;                // n_st at the last fit
+
+    // Samples: stream frame i at hist[(i % VALIGN_HIST_FRAMES) * n_ch], scaled to +/-1
+    uint32_t n_ch, bits;
+    float   *hist;
+    int64_t  first, next;           // oldest frame received, one past the newest
+    bool     started;
+
+    valign_dev_stats_t stats;
+} valign_dev_t;
+
+// Merged frames: n_frames x valign_t.n_channels interleaved, sign-extended valign_t.bits
+typedef void (*valign_out_fn)(void *ctx, const int32_t *frames, uint32_t n_frames);
+
+typedef struct {
+    uint32_t      n_dev;
+    uint32_t      sample_rate;      // nominal, for the ppm figures
+    uint32_t      n_channels;       // sum over the devices, set with the first output
+    uint32_t      bits;             // widest device's
+    bool          resolved;         // SOF numbering lined up across devices
+    bool          out_started;
+    bool          flushing;         // no lag, no waiting: the streams have ended
+    int64_t       out_frame;        // device 0 stream frame of the next output frame
+    uint64_t      out_frames;
+    valign_dev_t  dev[VALIGN_MAX_DEVICES];
+    float         kernel[VALIGN_PHASES + 1][VALIGN_TAPS];
+    double        fx[VALIGN_FIT_STAMPS], fy[VALIGN_FIT_STAMPS], ft[VALIGN_FIT_STAMPS];   // fit scratch
+    int32_t       out[VALIGN_OUT_FRAMES * VALIGN_MAX_CHANNELS];
+    valign_out_fn fn;
+    void         *ctx;
+} valign_t;
+
+// Returns 0, or -1 for an unsupported device count.
+int valign_init(valign_t *a, uint32_t n_dev, uint32_t sample_rate, valign_out_fn fn, void *ctx);
+void valign_free(valign_t *a);
+
+// One decoded block of device dev (the arguments of vstream_block_fn); calls fn for
+// every output frame all devices now cover.
+void valign_block(valign_t *a, uint32_t dev, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                  const int32_t *samples, uint32_t lost);
+
+// End of the streams: emits the frames still held back, with the last fits.
+void valign_flush(valign_t *a);
+
+#endif // VSTREAM_ALIGN_H
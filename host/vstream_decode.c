@@ -0,0 +1,111 @@
+// vstream_decode.c — reassembles and decodes vstream.h blocks (host side)
+
+#include "vstream_decode.h"
+#include <string.h>
+
+void vstream_decoder_init(vstream_decoder_t *d, vstream_block_fn fn, void *ctx)
+{
+    memset(d, 0, sizeof(*d));
+    d->fn = fn;
+    d->ctx = ctx;
+}
+
+// Plausible header at p (at least VSTREAM_HEADER_BYTES available)
+static bool header_ok(const vstream_block_t *h)
+{
+    if (h->sync == VSTREAM_SYNC_DETECT)
+        return h->n_channels >= 1 && h->n_channels <= DETECT_MAX_MICS && h->bits == 0 && h->n_frames >= 1 &&
+               h->bytes == VSTREAM_REPORT_BYTES;
+    return (h->sync == VSTREAM_SYNC || h->sync == VSTREAM_SYNC_STAMPED) &&
+           h->n_channels >= 1 && h->n_channels <= LOSSLESS_MAX_CHANNELS &&
+           (h->bits == 16 || h->bits == 24) &&
+           h->n_frames >= 1 && h->n_frames <= LOSSLESS_MAX_FRAMES &&
+           h->bytes > VSTREAM_HEADER_BYTES + (h->sync == VSTREAM_SYNC_STAMPED ? VSTREAM_STAMP_BYTES : 0) &&
+           h->bytes <= VSTREAM_MAX_BLOCK;
+}
+
+static void report(vstream_decoder_t *d, const vstream_block_t *h, const uint8_t *payload)
+{
+    detect_features_t f;
+    memcpy(&f, payload, sizeof(f));
+    if (d->reports_started) d->stats.report_gaps += h->seq - d->report_seq - 1;
+    d->reports_started = true;
+    d->report_seq = h->seq;
+    d->stats.reports++;
+    d->stats.bytes += h->bytes;
+    if (d->report_fn) d->report_fn(d->ctx, h, &f);
+}
+
+static void block(vstream_decoder_t *d, const vstream_block_t *h, const uint8_t *payload)
+{
+    vstream_stamp_t stamp;
+    bool stamped = h->sync == VSTREAM_SYNC_STAMPED;
+    if (stamped)
+    {
+        memcpy(&stamp, payload, sizeof(stamp));
+        payload += sizeof(stamp);
+    }
+    uint32_t len = h->bytes - VSTREAM_HEADER_BYTES - (stamped ? VSTREAM_STAMP_BYTES : 0);
+    if (lossless_decode(payload, len, h->n_channels, h->n_frames, h->bits, d->samples) != len)
+    {
+        d->stats.bad_blocks++;
+        return;
+    }
+
+    uint32_t lost = 0;
+    if (d->started)
+    {
+        d->stats.seq_gaps += h->seq - d->prev.seq - 1;
+        uint32_t expect = d->prev.frame + d->prev.n_frames;
+        if (h->frame != expect)
+        {
+            lost = h->frame - expect;
+            d->stats.frame_gaps++;
+            d->stats.lost_frames += lost;
+        }
+    }
+    d->started = true;
+    d->prev = *h;
+
+    d->stats.blocks++;
+    d->stats.stamped += stamped;
+    d->stats.frames += h->n_frames;
+    d->stats.bytes += h->bytes;
+    d->stats.raw_bytes += (uint64_t)h->n_frames * h->n_channels * (h->bits / 8);
+    if (d->fn) d->fn(d->ctx, h, stamped ? &stamp : NULL, d->samples, lost);
+}
+
+void vstream_decoder_feed(vstream_decoder_t *d, const uint8_t *data, uint32_t len)
+{
+    while (len)
+    {
+        uint32_t n = sizeof(d->buf) - d->len;
+        if (n > len) n = len;
+        memcpy(&d->buf[d->len], data, n);
+        d->len += n;
+        data += n;
+        len -= n;
+
+        // Consume every complete block; on a bad header slide one byte to resync
+        uint32_t off = 0;
+        while (d->len - off >= VSTREAM_HEADER_BYTES)
+        {
+            vstream_block_t h;
+            memcpy(&h, &d->buf[off], sizeof(h));
+            if (!header_ok(&h))
+            {
+                d->stats.resyncs++;
+                off++;
+                continue;
+            }
+            if (d->len - off < h.bytes) break;
+            if (h.sync == VSTREAM_SYNC_DETECT)
+                report(d, &h, &d->buf[off + VSTREAM_HEADER_BYTES]);
+            else
+                block(d, &h, &d->buf[off + VSTREAM_HEADER_BYTES]);
+            off += h.bytes;
+        }
+        memmove(d->buf, &d->buf[off], d->len - off);
+        d->len -= off;
+    }
+}
@@ -0,0 +1,62 @@
+// vstream_decode.h — reassembles and decodes vstream.h blocks from a bulk byte stream (host side)
+//
+// Shared by vstream_rec (libusb, real device or a raw capture) and pipeline_sim
+// (simulated device). Bytes arrive in arbitrary chunks; every complete block is
+// checked, decoded with lossless.h and handed to a callback together with its
+// continuity against the previous block. Stamped and plain blocks may be mixed, and so
+// may the report records of event mode, which go to a callback of their own.
+
+#ifndef VSTREAM_DECODE_H
+#define VSTREAM_DECODE_H
+
+#include "vstream.h"
+#include "lossless.h"
+#include <stdbool.h>
+
+#define VSTREAM_MAX_BLOCK   (VSTREAM_HEADER_BYTES + VSTREAM_STAMP_BYTES + \
+                             LOSSLESS_MAX_BYTES(LOSSLESS_MAX_CHANNELS, LOSSLESS_MAX_FRAMES, 24))
+
+typedef struct {
+    uint64_t blocks;
+    uint64_t stamped;               // blocks that carried a SOF stamp
+    uint64_t frames;                // decoded
+    uint64_t bytes;                 // block and report bytes, headers included
+    uint64_t raw_bytes;             // the same frames as PCM
+    uint64_t seq_gaps;              // blocks missing by sequence number (host-side loss)
+    uint64_t frame_gaps;            // jumps in the frame number (device-side overruns)
+    uint64_t lost_frames;
+    uint64_t resyncs;               // bytes skipped looking for a block header
+    uint64_t bad_blocks;            // header or payload did not decode
+    uint64_t reports;               // event mode report records
+    uint64_t report_gaps;           // reports missing by their sequence number
+} vstream_stats_t;
+
+// Called per decoded block: samples are n_frames x n_channels interleaved, sign-extended
+// `bits`-bit integers; lost = frames missing since the previous block (0 if contiguous);
+// stamp is the block's SOF stamp, or NULL.
+typedef void (*vstream_block_fn)(void *ctx, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                                 const int32_t *samples, uint32_t lost);
+
+// Called per report record (event mode): the header and its feature vector.
+typedef void (*vstream_report_fn)(void *ctx, const vstream_block_t *h, const detect_features_t *f);
+
+typedef struct {
+    uint8_t          buf[2 * VSTREAM_MAX_BLOCK];
+    uint32_t         len;
+    bool             started;
+    vstream_block_t  prev;
+    bool             reports_started;
+    uint32_t         report_seq;    // of the previous report
+    vstream_stats_t  stats;
+    int32_t          samples[LOSSLESS_MAX_CHANNELS * LOSSLESS_MAX_FRAMES];
+    vstream_block_fn fn;
+    vstream_report_fn report_fn;    // optional, set after init
+    void            *ctx;
+} vstream_decoder_t;
+
+void vstream_decoder_init(vstream_decoder_t *d, vstream_block_fn fn, void *ctx);
+
+// Feeds received bytes; calls fn for every block they complete.
+void vstream_decoder_feed(vstream_decoder_t *d, const uint8_t *data, uint32_t len);
+
+#endif // VSTREAM_DECODE_H
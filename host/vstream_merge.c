@@ -0,0 +1,306 @@
+// vstream_merge.c — lines up the stamped raw captures of several devices into one WAV
+//
+// The inputs are raw bulk captures (vstream_rec --raw, pipeline_sim --bulk-raw) recorded
+// with --stamps 1 from devices on one USB bus, started within a second of each other.
+// The first file is the reference timeline (vstream_align.h); the output channels are
+// every device's channels in argument order. The files are decoded in step, the one
+// with the fewest frames so far first, so their samples meet inside the aligner's history.
+//
+// --check HZ measures the alignment on a test tone present on every channel (as
+// pipeline_sim --source tone makes): a cross-correlation against channel 0 must find no
+// whole-frame lag, then each channel's delay against channel 0 comes from the phase of
+// the tone over 50 ms windows, after the first second. It fails if any delay exceeds
+// --max-us (default 2).
+//
+//   vstream_merge [--out merged.wav] [--check HZ [--max-us US]] dev0.vs dev1.vs ...
+
+#include "vstream_align.h"
+#include "vstream_decode.h"
+#include "wav.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_BYTES     4096
+#define CHECK_SKIP_S    1.0             // fits settle, decimator and interpolator histories fill
+#define CHECK_WIN_S     0.05
+#define XCORR_FRAMES    4800            // coarse check: 100 ms at 48 kHz ...
+#define XCORR_LAGS      480             // ... against +/- 10 ms
+#define SILENT_RMS      1e-4            // channels below this (of full scale) are not checked
+
+static const char *opt_out    = NULL;
+static double      opt_check  = 0;
+static double      opt_max_us = 2;
+static const char *opt_in[VALIGN_MAX_DEVICES];
+static uint32_t    n_in;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: vstream_merge [--out merged.wav] [--check HZ [--max-us US]] dev0.vs dev1.vs ...\n");
+    exit(1);
+}
+
+static void parse(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *k = argv[i];
+        if (k[0] != '-')
+        {
+            if (n_in == VALIGN_MAX_DEVICES) usage();
+            opt_in[n_in++] = k;
+            continue;
+        }
+        if (i + 1 >= argc) usage();
+        const char *v = argv[++i];
+        if      (!strcmp(k, "--out"))    opt_out    = v;
+        else if (!strcmp(k, "--check"))  opt_check  = atof(v);
+        else if (!strcmp(k, "--max-us")) opt_max_us = atof(v);
+        else usage();
+    }
+    if (n_in < 2) usage();
+}
+
+// ---------- Inputs ----------
+typedef struct {
+    FILE             *f;
+    vstream_info_t    info;
+    vstream_decoder_t dec;
+    uint32_t          index;
+} input_t;
+
+static input_t  inputs[VALIGN_MAX_DEVICES];
+static valign_t align;
+
+static void on_block(void *ctx, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                     const int32_t *s, uint32_t lost)
+{
+    input_t *in = ctx;
+    valign_block(&align, in->index, h, stamp, s, lost);
+}
+
+// ---------- Check ----------
+typedef struct {
+    double   rms_sum;
+    double   i, q;                  // tone projection over the current window
+    double   delay_sum, delay_min, delay_max;
+    uint64_t windows;
+    int32_t  lag;                   // coarse, frames
+} chan_t;
+
+static chan_t   chans[VALIGN_MAX_CHANNELS];
+static float   *xbuf;               // XCORR_FRAMES + 2 * XCORR_LAGS frames for the coarse check
+static uint64_t xfill;
+static uint64_t win_n;
+static bool     xdone;
+
+static void coarse_lags(void)
+{
+    uint32_t n_ch = align.n_channels;
+    for (uint32_t c = 1; c < n_ch; c++)
+    {
+        double best = -INFINITY;
+        for (int32_t lag = -XCORR_LAGS; lag <= XCORR_LAGS; lag++)
+        {
+            double acc = 0;
+            for (uint32_t t = 0; t < XCORR_FRAMES; t++)
+                acc += (double)xbuf[(XCORR_LAGS + t) * n_ch] * xbuf[(XCORR_LAGS + t + lag) * n_ch + c];
+            if (acc > best)
+            {
+                best = acc;
+                chans[c].lag = lag;
+            }
+        }
+    }
+    xdone = true;
+}
+
+static void check_frames(const int32_t *s, uint32_t n, uint64_t first)
+{
+    uint32_t n_ch = align.n_channels;
+    double   fs = inputs[0].info.sample_rate;
+    uint64_t skip = (uint64_t)(CHECK_SKIP_S * fs), win = (uint64_t)(CHECK_WIN_S * fs);
+    double   full = (double)(1u << (align.bits - 1)), w = 2 * M_PI * opt_check / fs;
+
+    for (uint32_t f = 0; f < n; f++)
+    {
+        uint64_t k = first + f;
+        if (k < skip) continue;
+        const int32_t *x = &s[f * n_ch];
+
+        uint64_t span = XCORR_FRAMES + 2 * XCORR_LAGS;
+        if (xfill < span)
+        {
+            for (uint32_t c = 0; c < n_ch; c++)
+                xbuf[xfill * n_ch + c] = (float)(x[c] / full);
+            if (++xfill == span) coarse_lags();
+        }
+
+        double cs = cos(w * (double)k), sn = sin(w * (double)k);
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            double v = x[c] / full;
+            chans[c].i += v * cs;
+            chans[c].q += v * sn;
+            chans[c].rms_sum += v * v;
+        }
+        if (++win_n < win) continue;
+
+        // Delay against channel 0 from the tone's phase
+        double p0 = atan2(chans[0].q, chans[0].i);
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            chan_t *ch = &chans[c];
+            double d = remainder(p0 - atan2(ch->q, ch->i), 2 * M_PI) / (2 * M_PI * opt_check) * 1e6;
+            if (!ch->windows || d < ch->delay_min) ch->delay_min = d;
+            if (!ch->windows || d > ch->delay_max) ch->delay_max = d;
+            ch->delay_sum += d;
+            ch->windows++;
+            ch->i = ch->q = 0;
+        }
+        win_n = 0;
+    }
+}
+
+static wav_t wav;
+
+static void on_output(void *ctx, const int32_t *s, uint32_t n)
+{
+    (void)ctx;
+    if (opt_check > 0) check_frames(s, n, align.out_frames - n);
+    if (!wav.f) return;
+    if (!wav.n_channels)
+    {
+        wav.n_channels = align.n_channels;
+        wav.bytes = align.bits / 8;
+        wav_header(&wav);
+    }
+    wav_frames(&wav, s, n);
+}
+
+static bool check_report(void)
+{
+    if (!xdone)
+    {
+        printf("check      too short: %.1f s of aligned output needed\n",
+               CHECK_SKIP_S + (double)(XCORR_FRAMES + 2 * XCORR_LAGS) / inputs[0].info.sample_rate);
+        return false;
+    }
+    bool ok = true;
+    double worst = 0;
+    uint64_t frames = align.out_frames - (uint64_t)(CHECK_SKIP_S * inputs[0].info.sample_rate);
+    printf("check      %.0f Hz tone, delay against ch 0 per %.0f ms window [us]:\n", opt_check, CHECK_WIN_S * 1e3);
+    uint32_t c = 0;
+    for (uint32_t d = 0; d < align.n_dev; d++)
+    {
+        const valign_dev_t *v = &align.dev[d];
+        double mean = 0, lo = INFINITY, hi = -INFINITY;
+        uint32_t n_used = 0, n_silent = 0, n_lagged = 0;
+        for (uint32_t k = 0; k < v->n_ch; k++, c++)
+        {
+            const chan_t *ch = &chans[c];
+            if (sqrt(ch->rms_sum / (double)frames) < SILENT_RMS) { n_silent++; continue; }
+            if (ch->lag) n_lagged++;
+            mean += ch->delay_sum / ch->windows;
+            lo = fmin(lo, ch->delay_min);
+            hi = fmax(hi, ch->delay_max);
+            n_used++;
+        }
+        if (n_used) mean /= n_used;
+        bool dev_ok = n_used && !n_lagged;
+        if (dev_ok) worst = fmax(worst, fmax(fabs(lo), fabs(hi)));
+        ok = ok && dev_ok;
+        printf("           device %u: %u ch (%u silent), mean %+.3f, range %+.3f .. %+.3f%s\n", d, n_used,
+               n_silent, n_used ? mean : 0, n_used ? lo : 0, n_used ? hi : 0,
+               n_lagged ? ", WHOLE-FRAME LAG" : "");
+    }
+    ok = ok && worst <= opt_max_us;
+    printf("           worst %.3f us (limit %.1f)\n", worst, opt_max_us);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    parse(argc, argv);
+
+    for (uint32_t d = 0; d < n_in; d++)
+    {
+        input_t *in = &inputs[d];
+        in->index = d;
+        if (!(in->f = fopen(opt_in[d], "rb")))
+        {
+            perror(opt_in[d]);
+            return 1;
+        }
+        if (fread(&in->info, sizeof(in->info), 1, in->f) != 1 || in->info.version != VSTREAM_VERSION)
+        {
+            fprintf(stderr, "vstream_merge: %s: not a raw vstream capture\n", opt_in[d]);
+            return 1;
+        }
+        if (in->info.sample_rate != inputs[0].info.sample_rate)
+        {
+            fprintf(stderr, "vstream_merge: %s: %u Hz, the reference runs at %u Hz\n", opt_in[d],
+                    in->info.sample_rate, inputs[0].info.sample_rate);
+            return 1;
+        }
+        vstream_decoder_init(&in->dec, on_block, in);
+    }
+    valign_init(&align, n_in, inputs[0].info.sample_rate, on_output, NULL);
+    if (opt_check > 0 && !(xbuf = malloc(sizeof(float) * (XCORR_FRAMES + 2 * XCORR_LAGS) * VALIGN_MAX_CHANNELS)))
+        return 1;
+    wav.rate = inputs[0].info.sample_rate;
+    if (opt_out && !(wav.f = fopen(opt_out, "wb")))
+    {
+        perror(opt_out);
+        return 1;
+    }
+
+    // Decode in step until one file runs out
+    uint8_t buf[CHUNK_BYTES];
+    for (;;)
+    {
+        input_t *next = &inputs[0];
+        for (uint32_t d = 1; d < n_in; d++)
+            if (inputs[d].dec.stats.frames + inputs[d].dec.stats.lost_frames <
+                next->dec.stats.frames + next->dec.stats.lost_frames) next = &inputs[d];
+        size_t n = fread(buf, 1, sizeof(buf), next->f);
+        if (!n) break;
+        vstream_decoder_feed(&next->dec, buf, (uint32_t)n);
+    }
+    valign_flush(&align);
+
+    if (wav.f)
+    {
+        wav_header(&wav);
+        fclose(wav.f);
+    }
+
+    bool ok = true;
+    uint32_t rate = inputs[0].info.sample_rate;
+    printf("merged     %u devices, %u ch, %u-bit, %llu frames (%.2f s) at %u Hz\n", n_in, align.n_channels,
+           align.bits, (unsigned long long)align.out_frames, (double)align.out_frames / rate, rate);
+    for (uint32_t d = 0; d < n_in; d++)
+    {
+        const valign_dev_t *v = &align.dev[d];
+        const vstream_stats_t *s = &inputs[d].dec.stats;
+        fclose(inputs[d].f);
+        printf("device %u   %u ch, %llu blocks (%llu stamped), %llu lost, %llu late; clock %+.1f ppm vs USB, "
+               "%+.1f ppm vs ref, offset %+.3f ms, SOF delay %.2f us\n",
+               d, v->n_ch, (unsigned long long)s->blocks, (unsigned long long)s->stamped,
+               (unsigned long long)v->stats.lost_frames, (unsigned long long)v->stats.late_frames,
+               v->stats.clock_ppm, v->stats.ref_ppm, v->stats.offset_ms, v->stats.delay_us);
+        if (!v->fit)
+        {
+            printf("           no fit: %llu SOF stamps (record with --stamps 1)\n", (unsigned long long)v->n_st);
+            ok = false;
+        }
+        if (s->bad_blocks || s->resyncs) ok = false;
+    }
+    if (opt_check > 0) ok = check_report() && ok;
+    valign_free(&align);
+    free(xbuf);
+
+    printf("\nresult     %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
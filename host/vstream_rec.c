@@ -0,0 +1,436 @@
+// vstream_rec.c — records the vendor bulk stream (vstream.h) to WAV, or decodes a raw capture
+//
+// Live: claims the vendor interface (the audio interfaces stay with the OS driver),
+// starts the stream at the requested depth, keeps several bulk transfers in flight
+// and decodes the blocks as they arrive. Frames the device skipped (overruns) are
+// written as silence, so the file keeps the device's timeline; sequence gaps mean
+// bytes lost on the host side and are reported, not patched. --raw also keeps the
+// undecoded stream (INFO reply first), which --in decodes offline. --stamps 1 asks for
+// SOF-stamped blocks; start one recorder per device (--index picks among devices with
+// the same VID:PID) within a second of each other and line the raw captures up with
+// vstream_merge.
+//
+// --detect 1 starts event mode: the detector's onsets and releases are printed as they
+// arrive, and the WAV holds only the triggered audio, the events back to back (each
+// one's start is printed) rather than padded out to the device's timeline.
+//
+//   vstream_rec [--bits 16|24] [--seconds S] [--out rec.wav] [--raw rec.vs] [--stamps 1]
+//               [--detect 1] [--vid ID --pid ID] [--index N]
+//   vstream_rec --in rec.vs [--out rec.wav] [--detect 1]
+//
+// The sample rate is the Clock Source's (set it through the audio interface first).
+// Without libusb (HAVE_LIBUSB unset) only --in is available.
+
+#include "vstream_decode.h"
+#include "telemetry.h"
+#include "wav.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_LIBUSB
+#include <libusb.h>
+#endif
+
+#define DEFAULT_VID     0xCAFE
+#define DEFAULT_PID     0x4066
+#define TIMEOUT_MS      500
+#define N_TRANSFERS     8
+#define TRANSFER_BYTES  4096
+
+static uint32_t    opt_bits    = 24;
+static double      opt_seconds = 10;
+static const char *opt_out     = NULL;
+static const char *opt_raw     = NULL;
+static const char *opt_in      = NULL;
+static uint16_t    opt_vid     = DEFAULT_VID;
+static uint16_t    opt_pid     = DEFAULT_PID;
+static uint32_t    opt_index   = 0;
+static bool        opt_stamps  = false;
+static bool        opt_detect  = false;
+
+static volatile sig_atomic_t stop;
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: vstream_rec [--bits 16|24] [--seconds S] [--out rec.wav] [--raw rec.vs] [--stamps 1]\n"
+                    "                   [--detect 1] [--vid ID --pid ID] [--index N]\n"
+                    "       vstream_rec --in rec.vs [--out rec.wav] [--detect 1]\n");
+    exit(1);
+}
+
+static void parse(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) usage();
+        const char *k = argv[i], *v = argv[++i];
+        if      (!strcmp(k, "--bits"))    opt_bits    = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--seconds")) opt_seconds = atof(v);
+        else if (!strcmp(k, "--out"))     opt_out     = v;
+        else if (!strcmp(k, "--raw"))     opt_raw     = v;
+        else if (!strcmp(k, "--in"))      opt_in      = v;
+        else if (!strcmp(k, "--vid"))     opt_vid     = (uint16_t)strtoul(v, NULL, 0);
+        else if (!strcmp(k, "--pid"))     opt_pid     = (uint16_t)strtoul(v, NULL, 0);
+        else if (!strcmp(k, "--index"))   opt_index   = (uint32_t)atoi(v);
+        else if (!strcmp(k, "--stamps"))  opt_stamps  = atoi(v) != 0;
+        else if (!strcmp(k, "--detect"))  opt_detect  = atoi(v) != 0;
+        else usage();
+    }
+    if (opt_bits != 16 && opt_bits != 24) usage();
+}
+
+// ---------- Decoded blocks ----------
+typedef struct {
+    wav_t    wav;
+    uint64_t target_frames;         // stop after this many (0: no limit)
+    uint32_t last_time_us;
+    uint32_t max_interval_us;       // largest device-time step between blocks
+    bool     started;
+    uint32_t first_frame;           // of the first block or report
+    uint32_t last_frame;            // past the previous block
+    uint64_t events, detections;    // audio segments, onsets
+} rec_t;
+
+// Device time in seconds since the first block or report
+static double rec_time(rec_t *r, uint32_t frame)
+{
+    if (!r->started)
+    {
+        r->started = true;
+        r->first_frame = frame;
+    }
+    return r->wav.rate ? (double)(frame - r->first_frame) / r->wav.rate : 0;
+}
+
+static void on_block(void *ctx, const vstream_block_t *h, const vstream_stamp_t *stamp,
+                     const int32_t *s, uint32_t lost)
+{
+    (void)stamp;
+    rec_t *r = ctx;
+    if (r->wav.frames && h->time_us - r->last_time_us > r->max_interval_us)
+        r->max_interval_us = h->time_us - r->last_time_us;
+    r->last_time_us = h->time_us;
+
+    // Event mode: a new segment wherever the frames do not follow on
+    if (opt_detect)
+    {
+        if (!r->events || h->frame != r->last_frame)
+        {
+            r->events++;
+            printf("audio      event %llu from %.3f s\n", (unsigned long long)r->events, rec_time(r, h->frame));
+        }
+        r->last_frame = h->frame + h->n_frames;
+        lost = 0;
+    }
+
+    if (r->wav.f)
+    {
+        if (!r->wav.n_channels)
+        {
+            r->wav.n_channels = h->n_channels;
+            r->wav.bytes = h->bits / 8;
+            wav_header(&r->wav);
+        }
+        // Keep the device's timeline: skipped frames become silence
+        for (uint32_t left = lost; left; )
+        {
+            uint32_t n = left < LOSSLESS_MAX_FRAMES ? left : LOSSLESS_MAX_FRAMES;
+            wav_frames(&r->wav, NULL, n);
+            left -= n;
+        }
+        wav_frames(&r->wav, s, h->n_frames);
+    }
+    else
+        r->wav.frames += lost + h->n_frames;
+
+    if (!opt_detect && r->target_frames && r->wav.frames >= r->target_frames) stop = 1;
+}
+
+static void on_report(void *ctx, const vstream_block_t *h, const detect_features_t *f)
+{
+    rec_t *r = ctx;
+    double t = rec_time(r, h->frame);
+    if (f->flags & DETECT_ONSET)
+    {
+        r->detections++;
+        printf("detect     onset   %.3f s: f0 %.1f Hz, score %.1f dB", t, f->f0_q4 / 16.0, f->score_q8 / 256.0);
+        if (f->flags & DETECT_DOA) printf(", az %d el %d deg", f->az_deg, f->el_deg);
+        printf("\n");
+    }
+    if (f->flags & DETECT_RELEASE) printf("detect     release %.3f s\n", t);
+    if (r->target_frames && h->frame - r->first_frame >= r->target_frames) stop = 1;
+}
+
+static void report(const vstream_decoder_t *d, const rec_t *r)
+{
+    const vstream_stats_t *s = &d->stats;
+    printf("blocks     %llu (%llu SOF-stamped), %llu frames, %.2f s at %u Hz\n", (unsigned long long)s->blocks,
+           (unsigned long long)s->stamped, (unsigned long long)s->frames,
+           r->wav.rate ? (double)s->frames / r->wav.rate : 0, r->wav.rate);
+    printf("ratio      %.2fx (%llu bytes for %llu bytes of PCM)\n", s->bytes ? (double)s->raw_bytes / s->bytes : 0,
+           (unsigned long long)s->bytes, (unsigned long long)s->raw_bytes);
+    printf("gaps       %llu sequence (host lost blocks), %llu frame (device skipped %llu frames)\n",
+           (unsigned long long)s->seq_gaps, (unsigned long long)s->frame_gaps, (unsigned long long)s->lost_frames);
+    printf("errors     %llu resync bytes, %llu undecodable blocks; block interval max %u us\n",
+           (unsigned long long)s->resyncs, (unsigned long long)s->bad_blocks, r->max_interval_us);
+    if (opt_detect || s->reports)
+        printf("events     %llu reports (%llu missing), %llu detections, %llu audio segments\n",
+               (unsigned long long)s->reports, (unsigned long long)s->report_gaps,
+               (unsigned long long)r->detections, (unsigned long long)r->events);
+}
+
+// ---------- Offline ----------
+static int decode_file(void)
+{
+    FILE *in = fopen(opt_in, "rb");
+    if (!in)
+    {
+        perror(opt_in);
+        return 1;
+    }
+    vstream_info_t info;
+    if (fread(&info, sizeof(info), 1, in) != 1 || info.version != VSTREAM_VERSION)
+    {
+        fprintf(stderr, "vstream_rec: %s: not a raw vstream capture (version %u)\n", opt_in, info.version);
+        fclose(in);
+        return 1;
+    }
+
+    static rec_t r;
+    static vstream_decoder_t d;
+    r.wav.rate = info.sample_rate;
+    if (opt_out && !(r.wav.f = fopen(opt_out, "wb")))
+    {
+        perror(opt_out);
+        fclose(in);
+        return 1;
+    }
+    vstream_decoder_init(&d, on_block, &r);
+    d.report_fn = on_report;
+
+    uint8_t buf[TRANSFER_BYTES];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        vstream_decoder_feed(&d, buf, (uint32_t)n);
+    fclose(in);
+
+    if (r.wav.f)
+    {
+        wav_header(&r.wav);
+        fclose(r.wav.f);
+    }
+    report(&d, &r);
+    return d.stats.bad_blocks || d.stats.resyncs ? 1 : 0;
+}
+
+// ---------- Live ----------
+#if HAVE_LIBUSB
+#define REQ_TYPE_IN     (LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE)
+#define REQ_TYPE_OUT    (LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE)
+
+typedef struct {
+    vstream_decoder_t dec;
+    rec_t             rec;
+    FILE             *raw;
+    int               in_flight;
+    int               error;
+} live_t;
+
+// libusb_error_name() only knows enum libusb_error
+static const char *transfer_status_name(enum libusb_transfer_status status)
+{
+    switch (status)
+    {
+    case LIBUSB_TRANSFER_COMPLETED: return "completed";
+    case LIBUSB_TRANSFER_ERROR:     return "error";
+    case LIBUSB_TRANSFER_TIMED_OUT: return "timed out";
+    case LIBUSB_TRANSFER_CANCELLED: return "cancelled";
+    case LIBUSB_TRANSFER_STALL:     return "stall";
+    case LIBUSB_TRANSFER_NO_DEVICE: return "no device";
+    case LIBUSB_TRANSFER_OVERFLOW:  return "overflow";
+    }
+    return "unknown status";
+}
+
+static void LIBUSB_CALL on_transfer(struct libusb_transfer *t)
+{
+    live_t *l = t->user_data;
+    if (t->status == LIBUSB_TRANSFER_COMPLETED || t->status == LIBUSB_TRANSFER_TIMED_OUT)
+    {
+        if (l->raw) fwrite(t->buffer, 1, (size_t)t->actual_length, l->raw);
+        vstream_decoder_feed(&l->dec, t->buffer, (uint32_t)t->actual_length);
+        int rc = stop ? 0 : libusb_submit_transfer(t);
+        if (!stop && rc == 0) return;
+        if (rc < 0)
+        {
+            // With every transfer lost this way the event loop would wait forever
+            fprintf(stderr, "vstream_rec: bulk resubmit: %s\n", libusb_error_name(rc));
+            l->error = 1;
+            stop = 1;
+        }
+    }
+    else if (t->status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        fprintf(stderr, "vstream_rec: bulk transfer: %s\n", transfer_status_name(t->status));
+        l->error = 1;
+        stop = 1;
+    }
+    l->in_flight--;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static int record(libusb_device_handle *h)
+{
+    static live_t l;
+    vstream_info_t info;
+    int n = libusb_control_transfer(h, REQ_TYPE_IN, VSTREAM_REQ_INFO, 0, TELEMETRY_ITF,
+                                    (unsigned char *)&info, sizeof(info), TIMEOUT_MS);
+    if (n != (int)sizeof(info) || info.version != VSTREAM_VERSION)
+    {
+        fprintf(stderr, "vstream_rec: INFO failed (%s) - firmware without the bulk stream?\n",
+                n < 0 ? libusb_error_name(n) : "short reply");
+        return 1;
+    }
+    printf("device     %u ch, %u Hz, %u-bit, max block %u bytes\n",
+           info.n_channels, info.sample_rate, opt_bits, info.max_block_bytes);
+
+    l.rec.wav.rate = info.sample_rate;
+    l.rec.target_frames = (uint64_t)(opt_seconds * info.sample_rate);
+    if (opt_out && !(l.rec.wav.f = fopen(opt_out, "wb")))
+    {
+        perror(opt_out);
+        return 1;
+    }
+    if (opt_raw)
+    {
+        if (!(l.raw = fopen(opt_raw, "wb")))
+        {
+            perror(opt_raw);
+            return 1;
+        }
+        fwrite(&info, sizeof(info), 1, l.raw);
+    }
+    vstream_decoder_init(&l.dec, on_block, &l.rec);
+    l.dec.report_fn = on_report;
+
+    // Transfers first, so the device FIFO is drained from the first block on
+    struct libusb_transfer *t[N_TRANSFERS];
+    static uint8_t bufs[N_TRANSFERS][TRANSFER_BYTES];
+    for (int i = 0; i < N_TRANSFERS; i++)
+    {
+        t[i] = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(t[i], h, VSTREAM_EP_IN, bufs[i], TRANSFER_BYTES, on_transfer, &l, 100);
+        if (libusb_submit_transfer(t[i]) == 0) l.in_flight++;
+    }
+    if (!l.in_flight)
+    {
+        fprintf(stderr, "vstream_rec: no bulk transfer could be submitted\n");
+        stop = 1;
+        l.error = 1;
+    }
+
+    uint16_t start = (uint16_t)(opt_bits / 8 | (opt_stamps ? VSTREAM_START_STAMPED : 0) |
+                                (opt_detect ? VSTREAM_START_DETECT : 0));
+    n = libusb_control_transfer(h, REQ_TYPE_OUT, VSTREAM_REQ_START, start, TELEMETRY_ITF, NULL, 0, TIMEOUT_MS);
+    if (n < 0)
+    {
+        fprintf(stderr, "vstream_rec: START refused (%s) - is an audio stream open%s?\n", libusb_error_name(n),
+                opt_detect ? ", at a rate the detector takes" : "");
+        stop = 1;
+        l.error = 1;
+    }
+
+    signal(SIGINT, on_signal);
+    while (!stop)
+        libusb_handle_events(NULL);
+
+    libusb_control_transfer(h, REQ_TYPE_OUT, VSTREAM_REQ_STOP, 0, TELEMETRY_ITF, NULL, 0, TIMEOUT_MS);
+    for (int i = 0; i < N_TRANSFERS; i++)
+        libusb_cancel_transfer(t[i]);
+    while (l.in_flight > 0)
+        libusb_handle_events(NULL);
+    for (int i = 0; i < N_TRANSFERS; i++)
+        libusb_free_transfer(t[i]);
+
+    if (libusb_control_transfer(h, REQ_TYPE_IN, VSTREAM_REQ_INFO, 0, TELEMETRY_ITF,
+                                (unsigned char *)&info, sizeof(info), TIMEOUT_MS) == (int)sizeof(info))
+        printf("device     %u blocks sent, %u bulk FIFO stalls\n", info.blocks, info.stalls);
+
+    if (l.raw) fclose(l.raw);
+    if (l.rec.wav.f)
+    {
+        wav_header(&l.rec.wav);
+        fclose(l.rec.wav.f);
+    }
+    report(&l.dec, &l.rec);
+    return l.error;
+}
+
+// The opt_index-th device with opt_vid:opt_pid, in libusb's enumeration order
+static libusb_device_handle *open_device(void)
+{
+    libusb_device **list;
+    libusb_device_handle *h = NULL;
+    ssize_t n = libusb_get_device_list(NULL, &list);
+    uint32_t seen = 0;
+    for (ssize_t i = 0; i < n && !h; i++)
+    {
+        struct libusb_device_descriptor dd;
+        if (libusb_get_device_descriptor(list[i], &dd) != 0 ||
+            dd.idVendor != opt_vid || dd.idProduct != opt_pid) continue;
+        if (seen++ == opt_index && libusb_open(list[i], &h) != 0) h = NULL;
+    }
+    if (n >= 0) libusb_free_device_list(list, 1);
+    return h;
+}
+
+static int live(void)
+{
+    if (libusb_init(NULL) != 0)
+    {
+        fprintf(stderr, "vstream_rec: libusb_init failed\n");
+        return 1;
+    }
+    libusb_device_handle *h = open_device();
+    if (!h)
+    {
+        fprintf(stderr, "vstream_rec: no device %04x:%04x #%u (or no permission)\n", opt_vid, opt_pid, opt_index);
+        libusb_exit(NULL);
+        return 1;
+    }
+    int rc = libusb_claim_interface(h, TELEMETRY_ITF);
+    if (rc != 0)
+    {
+        fprintf(stderr, "vstream_rec: claim interface %u: %s\n", TELEMETRY_ITF, libusb_error_name(rc));
+        libusb_close(h);
+        libusb_exit(NULL);
+        return 1;
+    }
+
+    int status = record(h);
+
+    libusb_release_interface(h, TELEMETRY_ITF);
+    libusb_close(h);
+    libusb_exit(NULL);
+    return status;
+}
+#else
+static int live(void)
+{
+    fprintf(stderr, "vstream_rec: built without libusb, only --in is available\n");
+    return 1;
+}
+#endif // HAVE_LIBUSB
+
+int main(int argc, char **argv)
+{
+    parse(argc, argv);
+    return opt_in ? decode_file() : live();
+}
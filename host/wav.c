@@ -0,0 +1,30 @@
+// wav.c — WAVE_FORMAT_EXTENSIBLE writer, sizes patched on close
+
+#include "wav.h"
+
+static void put16(FILE *f, uint32_t v) { fputc(v & 0xFF, f); fputc(v >> 8 & 0xFF, f); }
+static void put32(FILE *f, uint32_t v) { put16(f, v & 0xFFFF); put16(f, v >> 16); }
+
+void wav_header(wav_t *w)
+{
+    static const uint8_t pcm_guid[16] = { 1, 0, 0, 0, 0, 0, 0x10, 0, 0x80, 0, 0, 0xAA, 0, 0x38, 0x9B, 0x71 };
+    uint32_t block = w->n_channels * w->bytes;
+    uint32_t data = (uint32_t)(w->frames * block);
+
+    fseek(w->f, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, w->f); put32(w->f, 60 + data); fwrite("WAVE", 1, 4, w->f);
+    fwrite("fmt ", 1, 4, w->f); put32(w->f, 40);
+    put16(w->f, 0xFFFE); put16(w->f, w->n_channels); put32(w->f, w->rate);
+    put32(w->f, w->rate * block); put16(w->f, block); put16(w->f, 8 * w->bytes);
+    put16(w->f, 22); put16(w->f, 8 * w->bytes); put32(w->f, 0);        // valid bits, no speaker mask
+    fwrite(pcm_guid, 1, 16, w->f);
+    fwrite("data", 1, 4, w->f); put32(w->f, data);
+}
+
+void wav_frames(wav_t *w, const int32_t *s, uint32_t n)
+{
+    for (uint32_t i = 0; i < n * w->n_channels; i++)
+        for (uint32_t b = 0; b < w->bytes; b++)
+            fputc((uint32_t)(s ? s[i] : 0) >> (8 * b) & 0xFF, w->f);
+    w->frames += n;
+}
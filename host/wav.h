@@ -0,0 +1,24 @@
+// wav.h — WAVE_FORMAT_EXTENSIBLE writer for the host tools (vstream_rec, vstream_merge)
+//
+// Integer PCM, 2 or 3 bytes per sample. The header is written with the sizes known so
+// far; call wav_header() again before closing to patch them.
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    FILE    *f;
+    uint32_t n_channels, bytes, rate;
+    uint64_t frames;
+} wav_t;
+
+// (Re)writes the header at the start of the file; leaves the file position after it.
+void wav_header(wav_t *w);
+
+// n interleaved frames of sign-extended 8 * bytes-bit samples; s = NULL writes silence.
+void wav_frames(wav_t *w, const int32_t *s, uint32_t n);
+
+#endif // WAV_H
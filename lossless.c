@@ -0,0 +1,240 @@
+// lossless.c — lossless multi-channel block codec (see lossless.h for the format)
+//
+// The encoder reads the interleaved block in place (no scratch buffers, so it fits
+// core1's small stack) in two passes per channel. The first sums |residual| for all
+// orders with and without decorrelation and picks the order and the Rice parameter
+// from those sums. The second writes, counting bits, and falls back to verbatim if
+// coding stops paying. The sums are 32-bit with |e| clamped, so the M0+ needs no
+// adds with carry.
+
+#include "lossless.h"
+
+// ---------- Bit writer (MSB first) ----------
+typedef struct {
+    uint8_t  *p, *end;
+    uint32_t  acc;              // pending bits in the low n bits
+    uint32_t  n;                // < 8 between calls
+    int       overflow;
+} bitw_t;
+
+// nb <= 24
+static inline void put(bitw_t *w, uint32_t v, uint32_t nb)
+{
+    w->acc = (w->acc << nb) | (v & ((1u << nb) - 1));
+    w->n += nb;
+    while (w->n >= 8)
+    {
+        w->n -= 8;
+        if (w->p < w->end) *w->p++ = (uint8_t)(w->acc >> w->n);
+        else               w->overflow = 1;
+    }
+}
+
+static inline void put32(bitw_t *w, uint32_t v, uint32_t nb)
+{
+    if (nb > 16)
+    {
+        put(w, v >> 16, nb - 16);
+        nb = 16;
+    }
+    put(w, v, nb);
+}
+
+static inline uint32_t zigzag(int32_t e)
+{
+    return ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+}
+
+// ---------- Fixed predictors ----------
+// Residuals of orders 0..3 for sample i of a channel; d holds the previous sample's
+// orders 0..2. Below order i the highest available order is used (ramp-up).
+static inline void residuals(int32_t d[LOSSLESS_MAX_ORDER], uint32_t i, int32_t v,
+                             int32_t e[LOSSLESS_MAX_ORDER + 1])
+{
+    e[0] = v;
+    e[1] = i >= 1 ? e[0] - d[0] : e[0];
+    e[2] = i >= 2 ? e[1] - d[1] : e[1];
+    e[3] = i >= 3 ? e[2] - d[2] : e[2];
+    d[0] = e[0];
+    d[1] = e[1];
+    d[2] = e[2];
+}
+
+// Sample f of channel c at the coded width; decorrelated: minus channel c - 1
+static inline int32_t sample(const int32_t *in, uint32_t n_ch, uint32_t f, uint32_t c,
+                             uint32_t shift, uint32_t decor)
+{
+    const int32_t *fr = in + f * n_ch + c;
+    int32_t v = fr[0] >> shift;
+    return decor ? v - (fr[-1] >> shift) : v;
+}
+
+// |e| as the order selection counts it. The clamp keeps a channel's sum in 32 bits
+// with room for the Rice estimate below; residuals that large are coded verbatim.
+#define SUM_CLAMP       ((1u << 24) - 1)
+_Static_assert((uint64_t)LOSSLESS_MAX_FRAMES * SUM_CLAMP * 2 < (1ull << 31), "selection sums overflow");
+
+static inline uint32_t abs_clamped(int32_t e)
+{
+    uint32_t a = (uint32_t)(e < 0 ? -e : e);
+    return a < SUM_CLAMP ? a : SUM_CLAMP;
+}
+
+// ---------- Encoder ----------
+static void encode_channel(bitw_t *w, const int32_t *in, uint32_t n_ch, uint32_t c,
+                           uint32_t n, uint32_t bits)
+{
+    uint32_t shift = 32 - bits;
+    uint32_t n_src = c ? 2 : 1;
+
+    // Pass 1: sum |e| for every order, plain and decorrelated
+    uint32_t sum[2][LOSSLESS_MAX_ORDER + 1] = { { 0 } };
+    for (uint32_t s = 0; s < n_src; s++)
+    {
+        int32_t d[LOSSLESS_MAX_ORDER] = { 0 }, e[LOSSLESS_MAX_ORDER + 1];
+        for (uint32_t i = 0; i < n; i++)
+        {
+            residuals(d, i, sample(in, n_ch, i, c, shift, s), e);
+            sum[s][0] += abs_clamped(e[0]);
+            sum[s][1] += abs_clamped(e[1]);
+            sum[s][2] += abs_clamped(e[2]);
+            sum[s][3] += abs_clamped(e[3]);
+        }
+    }
+
+    uint32_t decor = 0, order = 0;
+    for (uint32_t s = 0; s < n_src; s++)
+        for (uint32_t o = 0; o <= LOSSLESS_MAX_ORDER; o++)
+            if (sum[s][o] < sum[decor][order]) { decor = s; order = o; }
+
+    // Rice parameter: the zigzag sum is ~2 sum |e|, and a parameter k > 0 costs about
+    // n (k + 1) + zigzag sum / 2^k - n / 2 bits (the quotients round down by 1/2)
+    uint32_t u_sum = 2 * sum[decor][order];
+    uint32_t k = 0, cost = n + u_sum;
+    while (k < LOSSLESS_VERBATIM - 1)
+    {
+        uint32_t next = n * (k + 2) + (u_sum >> (k + 1)) - n / 2;
+        if (next >= cost) break;
+        cost = next;
+        k++;
+    }
+
+    // Pass 2: write, verbatim if coding does not pay (estimated, or found on the way)
+    uint32_t limit = n * bits;
+    if (cost < limit)
+    {
+        bitw_t mark = *w;
+        uint32_t used = 0;
+        put(w, order << 6 | decor << 5 | k, 8);
+        int32_t d[LOSSLESS_MAX_ORDER] = { 0 }, e[LOSSLESS_MAX_ORDER + 1];
+        for (uint32_t i = 0; i < n && used < limit; i++)
+        {
+            residuals(d, i, sample(in, n_ch, i, c, shift, decor), e);
+            uint32_t u = zigzag(e[order]);
+            uint32_t q = u >> k;
+            if (q + 1 + k <= 24)
+            {
+                put(w, (((1u << q) - 1) << 1 << k) | (u & ((1u << k) - 1)), q + 1 + k);
+                used += q + 1 + k;
+            }
+            else if (q < LOSSLESS_ESC_Q)
+            {
+                put(w, ((1u << q) - 1) << 1, q + 1);
+                put32(w, u, k);
+                used += q + 1 + k;
+            }
+            else
+            {
+                put(w, (1u << LOSSLESS_ESC_Q) - 1, LOSSLESS_ESC_Q);
+                put32(w, u, 32);
+                used += LOSSLESS_ESC_Q + 32;
+            }
+        }
+        if (used < limit) return;
+        *w = mark;                  // bytes after mark.p are simply written again
+    }
+
+    put(w, LOSSLESS_VERBATIM, 8);
+    for (uint32_t i = 0; i < n; i++)
+        put(w, (uint32_t)sample(in, n_ch, i, c, shift, 0), bits);
+}
+
+uint32_t lossless_encode(const int32_t *in, uint32_t n_ch, uint32_t n_frames, uint32_t bits,
+                         uint8_t *out, uint32_t cap)
+{
+    if (n_ch > LOSSLESS_MAX_CHANNELS || n_frames > LOSSLESS_MAX_FRAMES) return 0;
+
+    bitw_t w = { .p = out, .end = out + cap };
+    for (uint32_t c = 0; c < n_ch; c++)
+        encode_channel(&w, in, n_ch, c, n_frames, bits);
+    if (w.n) put(&w, 0, 8 - w.n);
+    return w.overflow ? 0 : (uint32_t)(w.p - out);
+}
+
+// ---------- Decoder ----------
+typedef struct {
+    const uint8_t *p, *end;
+    uint32_t       acc;
+    uint32_t       n;
+    int            underflow;
+} bitr_t;
+
+static inline uint32_t bit(bitr_t *r)
+{
+    if (!r->n)
+    {
+        if (r->p >= r->end) { r->underflow = 1; return 0; }
+        r->acc = *r->p++;
+        r->n = 8;
+    }
+    return r->acc >> --r->n & 1;
+}
+
+static uint32_t get(bitr_t *r, uint32_t nb)
+{
+    uint32_t v = 0;
+    while (nb--) v = v << 1 | bit(r);
+    return v;
+}
+
+static inline int32_t sign_extend(uint32_t v, uint32_t bits)
+{
+    return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+uint32_t lossless_decode(const uint8_t *in, uint32_t len, uint32_t n_ch, uint32_t n_frames, uint32_t bits,
+                         int32_t *out)
+{
+    if (n_ch > LOSSLESS_MAX_CHANNELS || n_frames > LOSSLESS_MAX_FRAMES) return 0;
+
+    bitr_t r = { .p = in, .end = in + len };
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        uint32_t hdr = get(&r, 8);
+        uint32_t k = hdr & 31, decor = hdr >> 5 & 1, order = hdr >> 6;
+        if (decor && !c) return 0;
+
+        int32_t x1 = 0, x2 = 0, x3 = 0;         // previous coded samples
+        for (uint32_t i = 0; i < n_frames; i++)
+        {
+            int32_t s;
+            if (k == LOSSLESS_VERBATIM)
+                s = sign_extend(get(&r, bits), bits);
+            else
+            {
+                uint32_t q = 0;
+                while (q < LOSSLESS_ESC_Q && bit(&r)) q++;
+                uint32_t u = q < LOSSLESS_ESC_Q ? q << k | get(&r, k) : get(&r, 32);
+                int32_t  e = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+
+                uint32_t o = order < i ? order : i;
+                int32_t pred = o == 0 ? 0 : o == 1 ? x1 : o == 2 ? 2 * x1 - x2 : 3 * x1 - 3 * x2 + x3;
+                s = e + pred;
+            }
+            x3 = x2; x2 = x1; x1 = s;
+            out[i * n_ch + c] = decor ? s + out[i * n_ch + c - 1] : s;
+            if (r.underflow) return 0;
+        }
+    }
+    return (uint32_t)(r.p - in);
+}
@@ -0,0 +1,41 @@
+// lossless.h — lossless multi-channel block codec (no SDK dependencies)
+//
+// Per channel and block: optional inter-channel decorrelation (code ch - ch-1),
+// a fixed polynomial predictor of order 0..3 (as in Shorten/FLAC, orders ramp up
+// over the first samples so every block decodes on its own) and Rice-coded
+// residuals with one parameter per channel. A channel that would not shrink is
+// stored verbatim, so a block never exceeds LOSSLESS_MAX_BYTES. Everything is
+// integer; host/lossless_bench.c round-trips and times it on the host.
+//
+// Bitstream, MSB first, padded to a byte at the end. Per channel:
+//   8 bits  order << 6 | decorrelated << 5 | rice_k   (rice_k == 31: verbatim)
+//   n residuals: zigzag(e) >> k in unary (1s, then a 0) and the low k bits; a quotient
+//   of LOSSLESS_ESC_Q or more is sent as LOSSLESS_ESC_Q 1s and zigzag(e) in 32 bits.
+//   Verbatim: n samples of `bits` bits, two's complement.
+
+#ifndef LOSSLESS_H
+#define LOSSLESS_H
+
+#include <stdint.h>
+
+#define LOSSLESS_MAX_CHANNELS   16
+#define LOSSLESS_MAX_FRAMES     64          // per block
+#define LOSSLESS_MAX_ORDER      3
+#define LOSSLESS_ESC_Q          24
+#define LOSSLESS_VERBATIM       31
+
+// Worst case payload (every channel verbatim)
+#define LOSSLESS_MAX_BYTES(n_ch, n_frames, bits)    (((n_ch) * (8 + (n_frames) * (bits)) + 7) / 8)
+
+// in: n_frames x n_ch interleaved Q31 (as the pipeline produces); samples are coded
+// at `bits` (16 or 24) significant bits, i.e. exactly what PCM packing would send.
+// Returns payload bytes written to out (cap >= LOSSLESS_MAX_BYTES), or 0 if out is too small.
+uint32_t lossless_encode(const int32_t *in, uint32_t n_ch, uint32_t n_frames, uint32_t bits,
+                         uint8_t *out, uint32_t cap);
+
+// out: n_frames x n_ch interleaved samples, sign-extended `bits`-bit integers.
+// Returns payload bytes consumed, or 0 if the payload is malformed or truncated.
+uint32_t lossless_decode(const uint8_t *in, uint32_t len, uint32_t n_ch, uint32_t n_frames, uint32_t bits,
+                         int32_t *out);
+
+#endif // LOSSLESS_H
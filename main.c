@@ -1,105 +1,74 @@
-// main.c — RP2040 + PIO I2S RX -> TinyUSB audio (TX to host)
-
-#include "i2s_rx.pio.h"
+// main.c — RP2040/RP2350 + PIO I2S RX -> TinyUSB audio (TX to host)
+
+#include "capture.h"
+#include "drift.h"
+#include "pipeline.h"
+#include "audio_ctrl.h"
+#include "telemetry.h"
+#include "vstream.h"
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/pio.h"
-#include "hardware/dma.h"
-#include "hardware/clocks.h"
-#include "hardware/irq.h"
 #include "tusb.h"
 
-// ---------- Audio parameters (taken from tusb_config.h) ----------
-#define AUDIO_SAMPLE_RATE   CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE
-#define AUDIO_N_CHANNELS    CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
-#define AUDIO_SAMPLE_BYTES  CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX
-#define AUDIO_PACKET_SIZE   (AUDIO_SAMPLE_RATE / 1000 * AUDIO_N_CHANNELS * AUDIO_SAMPLE_BYTES)
-// One USB frame (1 ms) worth of audio bytes per packet.
+// ---------- Audio parameters (audio_config.h; rate and depth are host-selected) ----------
+// Largest packet: one USB frame (1 ms) at the top rate and depth, +1 frame for clock drift.
+#define AUDIO_PACKET_SIZE   PIPELINE_PCM_PACKET_BYTES
 
-// ---------- Pins ----------
-#define PIN_I2S_DATA  2
-#define PIN_I2S_SCK   3
-#define PIN_I2S_WS    4
+// ---------- Pins (see wiring_and_bom.md) ----------
+// A TDM bus (capture_config.h) uses the same pins: FSYNC on WS, data lines from GP2.
+#define PIN_I2S_WS    0     // WS / FSYNC (side-set base)
+#define PIN_I2S_SCK   1     // BCLK (side-set base + 1)
+#define PIN_I2S_SD0   2     // SD lines GP2..GP4 (mic pairs 1+2, 3+4, 5+6)
 
-// ---------- DMA setup ----------
-#define DMA_ADC_CHANNEL  0
-// Double buffer: 2 * one-USB-packet so DMA can fill one while USB sends the other
-#define DMA_BUF_SIZE_IN_BYTES   (2 * AUDIO_PACKET_SIZE)
+#if AUDIO_N_ALTS && AUDIO_PACKET_SIZE > CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX
+#error "CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX must fit a nominal+1 frame packet"
+#endif
 
 // ---------- Globals ----------
-static volatile uint32_t dma_buf_select = 0;               // 0 or 1
-static uint8_t  usb_frame_buf[AUDIO_PACKET_SIZE];          // staging for tud_audio_write
-static uint8_t  dma_buf[DMA_BUF_SIZE_IN_BYTES];            // DMA target (2 halves)
-
-// ---------- Minimal PIO init helper for i2s_rx ----------
-static void i2s_rx_program_init(PIO pio, uint sm, uint offset,
-                                uint pin_data, uint pin_sck, uint pin_ws,
-                                uint32_t sample_rate)
+static drift_t  drift;                                                  // I2S vs SOF clock tracker
+
+// ---------- TinyUSB SOF callback ----------
+// 1 kHz host clock reference: sample the capture position for the drift tracker and
+// the bulk stream's SOF stamps (first, so the stamp's time is read right after it).
+// Also keeps capture_frames_total() polled well within one ring period, and paces
+// the vendor bulk stream (one block per SOF, like the iso stream).
+void tud_sof_cb(uint32_t frame_count)
 {
-    // Configure pins
-    pio_gpio_init(pio, pin_sck);
-    pio_gpio_init(pio, pin_ws);
-    pio_gpio_init(pio, pin_data);
-
-    // SCK (sideset) is output; WS and DATA are inputs
-    pio_sm_set_consecutive_pindirs(pio, sm, pin_sck, 1, true);
-    pio_sm_set_consecutive_pindirs(pio, sm, pin_ws,  1, false);
-    pio_sm_set_consecutive_pindirs(pio, sm, pin_data,1, false);
-
-    // Build config from program
-    pio_sm_config c = i2s_rx_program_get_default_config(offset);
-
-    // Map pins to functions
-    sm_config_set_sideset_pins(&c, pin_sck);   // sideset drives SCK
-    sm_config_set_in_pins(&c, pin_data);       // IN reads from DATA
-    sm_config_set_jmp_pin(&c, pin_ws);         // WAIT/JMP uses WS
-
-    // Shift config: explicit PUSH in PIO program -> no autopush
-    sm_config_set_in_shift(&c, true /*right*/, false /*autopush*/, 32);
-
-    // Clocking:
-    // PIO toggles SCK every instruction; one data bit uses 2 instr (in+nop)
-    // => f_sm = 2 * BCLK. For 16-bit stereo: BCLK = 32 * fs. => f_sm = 64 * fs.
-    float div = (float)clock_get_hz(clk_sys) / (64.0f * (float)sample_rate);
-    sm_config_set_clkdiv(&c, div);
-
-    // Init SM
-    pio_sm_init(pio, sm, offset, &c);
-}
-
-// ---------- DMA IRQ handler ----------
-static void __isr dma_handler(void)
-{
-    // Ack IRQ for our channel
-    dma_hw->ints0 = 1u << DMA_ADC_CHANNEL;
-
-    // Flip buffer half
-    dma_buf_select ^= 1;
-
-    // Point DMA to the other half of our buffer and re-trigger
-    uint32_t next_addr = (uint32_t)dma_buf + (dma_buf_select * AUDIO_PACKET_SIZE);
-    dma_channel_set_write_addr(DMA_ADC_CHANNEL, (void *)next_addr, true);
+    uint32_t frac_q8;
+    uint32_t frames = capture_position(&frac_q8);
+    vstream_sof(frame_count, frames, frac_q8);
+    drift_sof(&drift, frame_count, frames);
+    telemetry_sof();
 }
 
 // ---------- TinyUSB audio callback ----------
-// Called before TinyUSB loads the IN endpoint; we copy the just-filled half.
+// Called before TinyUSB loads the IN endpoint; hands over the next finished packet
+// from the pipeline (core1 in dual-core mode). As an asynchronous source the packet
+// carries nominal +/- 1 frames so the stream follows the I2S clock.
 bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t func_id,
                                    uint8_t ep_in, uint8_t cur_alt_setting)
 {
     (void)rhport; (void)func_id; (void)ep_in; (void)cur_alt_setting;
     if (!tud_audio_n_mounted(func_id)) return false;
 
-    uint32_t filled_addr = (uint32_t)dma_buf + ((1u - dma_buf_select) * AUDIO_PACKET_SIZE);
-    memcpy(usb_frame_buf, (void *)filled_addr, sizeof(usb_frame_buf));
-    (void)tud_audio_write(usb_frame_buf, sizeof(usb_frame_buf));
+    uint32_t t = telemetry_in_begin();
+    uint16_t len;
+    const uint8_t *pkt = pipeline_packet_acquire(&len);
+    (void)tud_audio_write(pkt, len);
+    pipeline_packet_release();
+    telemetry_in_end(t);
     return true;
 }
 
 int main(void)
 {
     stdio_init_all();
+    drift_init(&drift, AUDIO_DEFAULT_SAMPLE_RATE);
+    telemetry_init(&drift);
     tusb_init();
+    tud_sof_cb_enable(true);
 
     // Heartbeat LED
     const uint led_pin = PICO_DEFAULT_LED_PIN;
@@ -109,39 +78,11 @@ int main(void)
     uint32_t heartbeat_ms = 200;
     absolute_time_t next_heartbeat = make_timeout_time_ms(heartbeat_ms);
 
-    // -------- PIO program load & init --------
-    PIO pio = pio0;
-    uint sm = 0;
-    uint offset = pio_add_program(pio, &i2s_rx_program);
-    i2s_rx_program_init(pio, sm, offset, PIN_I2S_DATA, PIN_I2S_SCK, PIN_I2S_WS, AUDIO_SAMPLE_RATE);
-
-    // Enable SM
-    pio_sm_set_enabled(pio, sm, true);
-
-    // -------- DMA config --------
-    dma_channel_config c = dma_channel_get_default_config(DMA_ADC_CHANNEL);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);       // PIO RX FIFO is 32-bit
-    channel_config_set_read_increment(&c, false);                  // read from fixed FIFO address
-    channel_config_set_write_increment(&c, true);                  // write linear buffer
-    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));     // PIO RX DREQ
-
-    // Start writing into the first half
-    dma_buf_select = 0;
-    dma_channel_configure(
-        DMA_ADC_CHANNEL, &c,
-        dma_buf,               // dst
-        &pio->rxf[sm],         // src
-        AUDIO_PACKET_SIZE / 4, // 32-bit words per half
-        false                  // don't start yet
-    );
-
-    // IRQ for half-complete
-    dma_channel_set_irq0_enabled(DMA_ADC_CHANNEL, true);
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
-    irq_set_enabled(DMA_IRQ_0, true);
+    // -------- Capture: PIO + chained DMA ring --------
+    capture_start(pio0, 0, PIN_I2S_SD0, PIN_I2S_WS, AUDIO_DEFAULT_SAMPLE_RATE);
 
-    // Kick off first transfer
-    dma_channel_start(DMA_ADC_CHANNEL);
+    // -------- Processing stages (core1 in dual-core mode), host format requests --------
+    audio_ctrl_init(&drift);
 
     // -------- Main loop --------
     for (;;)
@@ -0,0 +1,558 @@
+// pipeline.c — capture -> processing stages -> USB packet queue
+//
+// Dual-core mode: core1 owns the capture ring consumer side and the stage chain; it
+// pushes finished USB packets into a single-producer/single-consumer queue that core0
+// drains from the TinyUSB IN callback. Head is written only by core1, tail only by
+// core0, so no locks are needed - just a barrier between payload and index.
+
+#include "pipeline.h"
+#include "samples.h"
+#include "beamform.h"
+#include "decimate.h"
+#include "detect.h"
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+
+#if (PIPELINE_QUEUE_PACKETS & (PIPELINE_QUEUE_PACKETS - 1)) || PIPELINE_QUEUE_PACKETS < 2
+#error "PIPELINE_QUEUE_PACKETS must be a power of 2 >= 2"
+#endif
+#if PIPELINE_PRE_BYTES < 3 * PIPELINE_BLOCK_BYTES
+#error "PIPELINE_PRE_BYTES must hold three worst-case blocks"
+#endif
+
+typedef struct {
+    uint16_t len;
+    uint8_t  data[PIPELINE_PACKET_BYTES];
+} pipeline_packet_t;
+
+const char *const pipeline_stage_names[PIPELINE_N_STAGES] = {
+    "unpack", "decim", "dc", "gain", "beam", "detect", "pack",
+};
+
+// ---------- Globals ----------
+volatile pipeline_stats_t pipeline_stats;
+
+static drift_t           *pkt_drift;
+static volatile uint32_t  stage_mask = PIPELINE_STAGES_DEFAULT;
+static uint32_t           fmt_rate  = AUDIO_DEFAULT_SAMPLE_RATE;
+static uint32_t           fmt_bytes = PIPELINE_MAX_SAMPLE_BYTES;
+static uint32_t           fmt_decim = 1;
+static uint32_t           fmt_output = PIPELINE_OUT_PCM;
+static uint32_t           blk_seq;      // next vstream block's sequence number
+static uint32_t           blk_frame;    // and its stream-rate frame position
+static volatile uint32_t  sof_seq;      // SOF stamp: odd while core0 writes, 0 = none yet
+static volatile uint32_t  sof_ext;
+static volatile uint32_t  sof_pos_q8;
+static volatile uint32_t  sof_time_us;
+static uint32_t           hist_width;   // cycles per histogram bin
+static decimator_t        decim;
+static int32_t            gain_q12[PIPELINE_N_MICS];
+static int32_t            dc_mean[PIPELINE_N_MICS];
+static int32_t            pcm[CAPTURE_MAX_READ_FRAMES * PIPELINE_N_MICS];
+static const beam_mic_t   array_mics[ARRAY_N_MICS] = ARRAY_MIC_POSITIONS;
+
+#if BEAM_OUTPUT != BEAM_OUTPUT_NONE
+static beamformer_t       beams;
+static int32_t            usb_pcm[CAPTURE_MAX_READ_FRAMES * PIPELINE_N_CHANNELS];
+static const beam_dir_t   beam_dirs[BEAM_N_BEAMS] = BEAM_DIRECTIONS;
+#endif
+
+// Event mode
+static bool               det_on;
+static bool               det_rate_ok;  // detector initialised for the format's rate
+static detector_t         det;
+static detect_report_t    det_reports[PIPELINE_MAX_REPORTS];
+static uint32_t           det_seq;      // next report's sequence number
+static uint32_t           det_sent;     // next sent block's
+static uint32_t           det_drain_bytes;  // block bytes per packet on average
+static uint32_t           det_credit;   // drain budget not used yet, at most 3/2 det_drain_bytes
+static bool               det_active;   // between the reports with DETECT_ONSET and DETECT_RELEASE
+static uint32_t           det_stop_seq; // first block coded after the release
+static bool               pre_draining; // active, or blocks from before the release left
+static uint8_t            pre_buf[PIPELINE_PRE_BYTES];
+static uint32_t           pre_rd, pre_wr;   // oldest block, next block
+static uint32_t           pre_end;      // end of the blocks before pre_wr wrapped to 0
+static uint32_t           pre_n;
+static bool               pre_wrapped;  // pre_wr is behind pre_rd
+
+static pipeline_packet_t  queue[PIPELINE_DUAL_CORE ? PIPELINE_QUEUE_PACKETS : 1];     // single core: queue[0] only
+#if PIPELINE_DUAL_CORE
+static volatile uint32_t  q_head;       // written by the producer (core1)
+static volatile uint32_t  q_tail;       // written by the consumer (core0)
+static bool               q_holding;    // consumer holds queue[q_tail] (not silence)
+static uint8_t            silence[CAPTURE_MAX_FRAMES_PER_PACKET * PIPELINE_N_CHANNELS * PIPELINE_MAX_SAMPLE_BYTES];
+#endif
+
+// ---------- Cycle counter ----------
+// SysTick is per core: 24-bit down-counter at clk_sys.
+static void cycles_init(void)
+{
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;          // enable, processor clock, no IRQ
+}
+
+static inline uint32_t cycles_now(void)
+{
+    return systick_hw->cvr;
+}
+
+static inline void cycles_account(volatile stage_cycles_t *s, uint32_t c)
+{
+    s->last = c;
+    if (c > s->max) s->max = c;
+    s->avg = (uint32_t)((int32_t)s->avg + (((int32_t)c - (int32_t)s->avg) >> 4));
+}
+
+// Per-packet total: deadline and histogram (a divide per packet, not per sample)
+static inline void packet_account(uint32_t c)
+{
+    cycles_account(&pipeline_stats.total, c);
+    pipeline_stats.busy += c;
+    if (c > pipeline_stats.budget) pipeline_stats.over_budget++;
+    uint32_t b = c / hist_width;
+    pipeline_stats.hist[b < PIPELINE_HIST_BINS ? b : PIPELINE_HIST_BINS - 1]++;
+}
+
+// Closes stage s that started at *t and restarts the clock for the next one.
+static inline void stage_done(uint32_t s, uint32_t *t)
+{
+    uint32_t now = cycles_now();
+    cycles_account(&pipeline_stats.stage[s], (*t - now) & 0x00FFFFFF);
+    *t = now;
+}
+
+static void pipeline_init(drift_t *drift)
+{
+    pkt_drift = drift;
+    for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+        gain_q12[c] = 1 << GAIN_Q;
+    pipeline_stats.budget = clock_get_hz(clk_sys) / 1000;
+    hist_width = pipeline_stats.budget / PIPELINE_HIST_BINS;
+    pipeline_set_format(AUDIO_CAPTURE_RATE(fmt_rate), fmt_rate, fmt_bytes);
+}
+
+void pipeline_set_format(uint32_t capture_rate, uint32_t sample_rate, uint32_t sample_bytes)
+{
+    fmt_rate  = sample_rate;
+    fmt_bytes = sample_bytes;
+    fmt_decim = capture_rate / sample_rate;
+    blk_seq   = 0;
+    blk_frame = 0;
+    sof_seq   = 0;                  // positions before the restart are meaningless now
+    for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+        dc_mean[c] = 0;
+    det_seq = det_sent = 0;
+    det_active = pre_draining = false;
+    det_credit = 0;
+    pre_rd = pre_wr = pre_n = 0;
+    pre_wrapped = false;
+
+    // Filter state starts from silence; the factor must have a coefficient set
+    if (fmt_decim > 1 && decim_init(&decim, fmt_decim, PIPELINE_N_MICS) != 0)
+        panic("decim_init: no coefficients for this rate");
+
+#if BEAM_OUTPUT != BEAM_OUTPUT_NONE
+    // Steering table is built per format change, never per sample
+    if (beam_init(&beams, array_mics, ARRAY_N_MICS, beam_dirs, BEAM_N_BEAMS, sample_rate) != 0)
+        panic("beam_init: array aperture exceeds BEAM_HIST");
+#endif
+
+    // The detector's steering and decimation too; rates it does not take leave it off
+    det_rate_ok = detect_init(&det, array_mics, PIPELINE_N_MICS, sample_rate) == 0;
+}
+
+void pipeline_set_output(uint32_t output)
+{
+    fmt_output = output;
+}
+
+void pipeline_set_detect(bool on)
+{
+    det_on = on && det_rate_ok && fmt_output != PIPELINE_OUT_PCM;
+    det_drain_bytes = VSTREAM_BLOCK_MAX_BYTES(PIPELINE_N_CHANNELS, fmt_rate / 1000 + 1, 8 * fmt_bytes,
+                                              fmt_output == PIPELINE_OUT_STAMPED);
+    if (det_drain_bytes < PIPELINE_DRAIN_BYTES) det_drain_bytes = PIPELINE_DRAIN_BYTES;
+}
+
+bool pipeline_detect_fits(uint32_t sample_rate, uint32_t sample_bytes, bool stamped)
+{
+    // pre_reserve() can leave up to a block unused at the wrap and keeps room for two more
+    uint32_t per_ms = VSTREAM_BLOCK_MAX_BYTES(PIPELINE_N_CHANNELS, sample_rate / 1000, 8 * sample_bytes, stamped);
+    return PIPELINE_PRE_MS * per_ms <= PIPELINE_PRE_BYTES - 3 * PIPELINE_BLOCK_BYTES;
+}
+
+// Bytes of one nominal packet of silence at the current format
+static inline uint16_t silence_len(void)
+{
+    return (uint16_t)(capture_frames_per_packet() / fmt_decim * PIPELINE_N_CHANNELS * fmt_bytes);
+}
+
+// ---------- SOF stamp ----------
+// Written by core0 from the SOF callback, read by the stage core: a sequence count
+// around the fields instead of a lock (the reader retries if core0 was mid-write).
+void pipeline_sof(uint32_t sof, uint32_t cap_pos_q8, uint32_t time_us)
+{
+    uint32_t seq = sof_seq;
+    sof_seq = seq + 1;
+    __dmb();
+    sof_ext     = sof;
+    sof_pos_q8  = cap_pos_q8;
+    sof_time_us = time_us;
+    __dmb();
+    seq += 2;
+    sof_seq = seq ? seq : 2;        // 0 stays "no SOF yet"
+}
+
+// False if no SOF has come since the last format change.
+static bool sof_read(vstream_stamp_t *st, uint32_t *cap_pos_q8)
+{
+    for (;;)
+    {
+        uint32_t seq = sof_seq;
+        __dmb();
+        st->sof         = sof_ext;
+        *cap_pos_q8     = sof_pos_q8;
+        st->sof_time_us = sof_time_us;
+        __dmb();
+        if (seq == 0) return false;
+        if (!(seq & 1) && seq == sof_seq) return true;
+        tight_loop_contents();
+    }
+}
+
+// ---------- Lossless block ----------
+// vstream.h header (+ SOF stamp) + lossless.h payload of n USB frames; skipped counts
+// the capture frames the ring dropped ahead of this packet, cap_first is the capture
+// index (capture_read_position()) the first of the n frames was taken at.
+static uint16_t encode_block(const int32_t *in, uint8_t *out, uint32_t cap, uint32_t n, uint32_t skipped,
+                             uint32_t cap_first)
+{
+    blk_frame += skipped / fmt_decim;
+    vstream_block_t h = {
+        .sync       = VSTREAM_SYNC,
+        .n_channels = PIPELINE_N_CHANNELS,
+        .bits       = (uint8_t)(8 * fmt_bytes),
+        .n_frames   = (uint16_t)n,
+        .seq        = blk_seq++,
+        .frame      = blk_frame,
+        .time_us    = time_us_32(),
+    };
+    blk_frame += n;
+
+    uint32_t head = sizeof(h);
+    vstream_stamp_t st;
+    uint32_t cap_pos_q8;
+    if (fmt_output == PIPELINE_OUT_STAMPED && sof_read(&st, &cap_pos_q8))
+    {
+        // Capture frames from the block's first frame to the SOF, in stream frames
+        st.pos_q8 = (int32_t)(cap_pos_q8 - (cap_first << 8)) / (int32_t)fmt_decim;
+        h.sync = VSTREAM_SYNC_STAMPED;
+        memcpy(out + head, &st, sizeof(st));
+        head += sizeof(st);
+    }
+
+    uint32_t len = lossless_encode(in, PIPELINE_N_CHANNELS, n, h.bits, out + head, cap - head);
+    h.bytes = (uint16_t)(head + len);
+    memcpy(out, &h, sizeof(h));
+    return h.bytes;
+}
+
+// ---------- Event mode ----------
+// Pre-trigger ring: whole blocks back to back, oldest at pre_rd. A block that would not
+// fit before the end goes to the start instead, and the oldest blocks make room.
+static void pre_drop(void)
+{
+    vstream_block_t h;
+    memcpy(&h, &pre_buf[pre_rd], sizeof(h));
+    pre_rd += h.bytes;
+    pre_n--;
+    if (pre_wrapped && pre_rd == pre_end)
+    {
+        pre_rd = 0;
+        pre_wrapped = false;
+    }
+}
+
+// Room for n_blocks worst-case blocks at pre_wr. Outside a detection the ring keeps one
+// spare, so the first packets of a drain never have to drop the oldest audio.
+static uint8_t *pre_reserve(uint32_t n_blocks)
+{
+    uint32_t room = n_blocks * PIPELINE_BLOCK_BYTES;
+    if (!pre_n) pre_rd = pre_wr = 0;
+    for (;;)
+    {
+        if (!pre_wrapped)
+        {
+            if (PIPELINE_PRE_BYTES - pre_wr >= room) break;
+            pre_end = pre_wr;
+            pre_wr = 0;
+            pre_wrapped = true;
+        }
+        else if (pre_rd - pre_wr >= room) break;
+        else pre_drop();
+    }
+    return &pre_buf[pre_wr];
+}
+
+// Report records, then - while draining - the oldest blocks the drain credit covers,
+// renumbered in the order they are sent, then the packet's block into the ring. The
+// credit grows by det_drain_bytes per packet, so whole blocks average out to the budget
+// and the backlog shrinks whenever blocks are smaller than that.
+static uint16_t pack_events(const int32_t *in, uint8_t *out, uint32_t n, uint32_t n_reports, uint32_t skipped,
+                            uint32_t cap_first)
+{
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < n_reports; i++)
+    {
+        const detect_report_t *r = &det_reports[i];
+        vstream_block_t h = {
+            .sync       = VSTREAM_SYNC_DETECT,
+            .n_channels = PIPELINE_N_MICS,
+            .n_frames   = (uint16_t)(DETECT_HOP * det.factor),
+            .bytes      = VSTREAM_REPORT_BYTES,
+            .seq        = det_seq++,
+            .frame      = r->frame,
+            .time_us    = time_us_32(),
+        };
+        memcpy(out + len, &h, sizeof(h));
+        memcpy(out + len + sizeof(h), &r->f, sizeof(r->f));
+        len += VSTREAM_REPORT_BYTES;
+        if (r->f.flags & DETECT_ONSET) det_active = pre_draining = true;
+        if (r->f.flags & DETECT_RELEASE)
+        {
+            det_active = false;
+            det_stop_seq = blk_seq;
+        }
+    }
+
+    // A host reading slower than the drain backs the queue up: hold the blocks in the
+    // ring (dropping the oldest) rather than in the capture ring, which would skip frames
+    // the detector needs
+    bool host_behind = pipeline_queued() >= PIPELINE_QUEUE_PACKETS / 2;
+    if (pre_draining && !host_behind)
+    {
+        det_credit += det_drain_bytes;
+        if (det_credit > det_drain_bytes * 3 / 2) det_credit = det_drain_bytes * 3 / 2;
+    }
+    while (pre_draining && !host_behind && pre_n)
+    {
+        vstream_block_t h;
+        memcpy(&h, &pre_buf[pre_rd], sizeof(h));
+        if (!det_active && (int32_t)(h.seq - det_stop_seq) >= 0)
+        {
+            pre_draining = false;
+            det_credit = 0;
+            break;
+        }
+        if (h.bytes > det_credit) break;
+        h.seq = det_sent++;
+        memcpy(out + len, &pre_buf[pre_rd], h.bytes);
+        memcpy(out + len, &h, sizeof(h));
+        len += h.bytes;
+        det_credit -= h.bytes;
+        pre_drop();
+    }
+
+    uint8_t *blk = pre_reserve(pre_draining ? 1 : 2);
+    pre_wr += encode_block(in, blk, PIPELINE_BLOCK_BYTES, n, skipped, cap_first);
+    pre_n++;
+    return (uint16_t)len;
+}
+
+// ---------- Stage chain ----------
+// n capture frames in; after decimation n counts USB frames.
+static void process_packet(pipeline_packet_t *p, uint32_t n)
+{
+    uint32_t mask = stage_mask;
+    uint32_t t0 = cycles_now();
+    uint32_t t = t0;
+
+    uint32_t skipped = capture_stats.skipped;
+    uint32_t got = capture_read(pcm, n);
+    uint32_t cap_first = capture_read_position() - got;     // after any frames it skipped
+    skipped = capture_stats.skipped - skipped;
+    stage_done(STAGE_UNPACK, &t);
+
+    if (fmt_decim > 1)
+    {
+        cap_first += decim.phase;   // the first output is taken that many frames in
+        n = decim_process(&decim, pcm, PIPELINE_N_MICS, pcm, PIPELINE_N_MICS, n);
+        stage_done(STAGE_DECIM, &t);
+    }
+
+    if (mask & PIPELINE_STAGE(STAGE_DC))
+    {
+        dc_remove(pcm, n, PIPELINE_N_MICS, dc_mean);
+        stage_done(STAGE_DC, &t);
+    }
+
+    if (mask & PIPELINE_STAGE(STAGE_GAIN))
+    {
+        apply_gain(pcm, n, PIPELINE_N_MICS, gain_q12);
+        stage_done(STAGE_GAIN, &t);
+    }
+
+#if BEAM_OUTPUT == BEAM_OUTPUT_APPEND
+    for (uint32_t f = 0; f < n; f++)
+        for (uint32_t c = 0; c < PIPELINE_N_MICS; c++)
+            usb_pcm[f * PIPELINE_N_CHANNELS + c] = pcm[f * PIPELINE_N_MICS + c];
+    beam_process(&beams, pcm, PIPELINE_N_MICS, usb_pcm, PIPELINE_N_CHANNELS, PIPELINE_N_MICS, n);
+    stage_done(STAGE_BEAM, &t);
+    const int32_t *out = usb_pcm;
+#elif BEAM_OUTPUT == BEAM_OUTPUT_REPLACE
+    beam_process(&beams, pcm, PIPELINE_N_MICS, usb_pcm, PIPELINE_N_CHANNELS, 0, n);
+    stage_done(STAGE_BEAM, &t);
+    const int32_t *out = usb_pcm;
+#else
+    const int32_t *out = pcm;
+#endif
+
+    uint32_t n_reports = 0;
+    if (det_on)
+    {
+        // Frames the ring skipped count toward the report positions, as for the blocks
+        if (skipped) detect_skip(&det, skipped / fmt_decim);
+        n_reports = detect_process(&det, pcm, PIPELINE_N_MICS, n, det_reports);
+        stage_done(STAGE_DETECT, &t);
+    }
+
+    if (det_on)
+        p->len = pack_events(out, p->data, n, n_reports, skipped, cap_first);
+    else if (fmt_output != PIPELINE_OUT_PCM)
+        p->len = encode_block(out, p->data, PIPELINE_PACKET_BYTES, n, skipped, cap_first);
+    else
+    {
+        pcm_pack(out, p->data, n * PIPELINE_N_CHANNELS, fmt_bytes);
+        p->len = (uint16_t)(n * PIPELINE_N_CHANNELS * fmt_bytes);
+    }
+    stage_done(STAGE_PACK, &t);
+
+    packet_account((t0 - t) & 0x00FFFFFF);
+    pipeline_stats.packets++;
+}
+
+#if PIPELINE_DUAL_CORE
+
+static void core1_main(void)
+{
+    cycles_init();
+
+    for (;;)
+    {
+        // Wait for a free queue slot
+        uint32_t head = q_head;
+        uint32_t queued = head - q_tail;
+        if (queued >= PIPELINE_QUEUE_PACKETS)
+        {
+            tight_loop_contents();
+            continue;
+        }
+
+        // Size the packet from everything buffered ahead of the USB endpoint,
+        // then wait for the DMA to deliver that many frames
+        uint32_t n = drift_packet_frames(pkt_drift,
+                                         capture_fill() + queued * capture_frames_per_packet(),
+                                         capture_target_fill());
+        while (capture_fill() < n)
+            tight_loop_contents();
+
+        process_packet(&queue[head % PIPELINE_QUEUE_PACKETS], n);
+        __dmb();                    // payload visible before the index
+        q_head = head + 1;
+    }
+}
+
+const uint8_t *pipeline_packet_acquire(uint16_t *len)
+{
+    uint32_t tail = q_tail;
+    q_holding = (q_head != tail);
+    if (!q_holding)
+    {
+        pipeline_stats.queue_empty++;
+        *len = silence_len();
+        return silence;
+    }
+    __dmb();                        // index read before the payload
+    pipeline_packet_t *p = &queue[tail % PIPELINE_QUEUE_PACKETS];
+    *len = p->len;
+    return p->data;
+}
+
+void pipeline_packet_release(void)
+{
+    if (!q_holding) return;         // silence was handed out
+    q_holding = false;
+    __dmb();                        // done reading before the slot is reused
+    q_tail = q_tail + 1;
+}
+
+void pipeline_start(drift_t *drift)
+{
+    if (!pkt_drift) pipeline_init(drift);
+    multicore_launch_core1(core1_main);
+}
+
+uint32_t pipeline_queued(void)
+{
+    return q_head - q_tail;
+}
+
+void pipeline_stop(void)
+{
+    // core1 holds no locks, so a reset is safe; the queue starts over empty
+    multicore_reset_core1();
+    q_head = 0;
+    q_tail = 0;
+    q_holding = false;
+}
+
+#else // single core: stages run inline in the IN callback
+
+const uint8_t *pipeline_packet_acquire(uint16_t *len)
+{
+    uint32_t n = drift_packet_frames(pkt_drift, capture_fill(), capture_target_fill());
+    process_packet(&queue[0], n);
+    *len = queue[0].len;
+    return queue[0].data;
+}
+
+void pipeline_packet_release(void)
+{
+}
+
+void pipeline_start(drift_t *drift)
+{
+    if (!pkt_drift) pipeline_init(drift);
+    cycles_init();
+}
+
+void pipeline_stop(void)
+{
+}
+
+uint32_t pipeline_queued(void)
+{
+    return 0;
+}
+
+#endif // PIPELINE_DUAL_CORE
+
+void pipeline_set_stages(uint32_t mask)
+{
+    stage_mask = mask | PIPELINE_STAGES_REQUIRED;
+}
+
+void pipeline_set_gain(uint32_t mic, int32_t q12)
+{
+    if (mic < PIPELINE_N_MICS) gain_q12[mic] = q12;
+}
+
+int32_t pipeline_headroom(void)
+{
+    return (int32_t)pipeline_stats.budget - (int32_t)pipeline_stats.total.max;
+}
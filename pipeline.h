@@ -0,0 +1,176 @@
+// pipeline.h — capture -> processing stages -> USB packet queue (core1 producer, core0 USB)
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "capture.h"
+#include "drift.h"
+#include "decimate.h"
+#include "beamform.h"
+#include "lossless.h"
+#include "detect.h"
+#include "vstream.h"
+
+// ---------- Mode ----------
+// 1: stages run on core1 and finished packets are queued for core0 (SPSC, lock-free).
+// 0: stages run inline in the TinyUSB IN callback on core0.
+#ifndef PIPELINE_DUAL_CORE
+#define PIPELINE_DUAL_CORE          1
+#endif
+
+// Finished packets queued between the cores. Power of 2.
+#ifndef PIPELINE_QUEUE_PACKETS
+#define PIPELINE_QUEUE_PACKETS      4
+#endif
+
+// Event mode's pre-trigger ring of coded blocks (pipeline_set_detect()). It has to reach
+// back PIPELINE_PRE_MS before the onset report even if every block goes verbatim: the
+// report comes DETECT_ON_HOPS + 1 hops (~130 ms) after a clear rotor starts and up to
+// ~0.3 s after a faint one (host/detect_ref). Formats it cannot cover are refused
+// (pipeline_detect_fits()): with 6 channels on the RP2040 24 kHz/24-bit and 48 kHz, on the
+// RP2350 none; more channels refuse more.
+#define PIPELINE_PRE_MS             300
+#ifndef PIPELINE_PRE_BYTES
+#if PICO_RP2350
+#define PIPELINE_PRE_BYTES          (320 * 1024)
+#else
+#define PIPELINE_PRE_BYTES          (128 * 1024)
+#endif
+#endif
+
+#define PIPELINE_N_MICS             ARRAY_N_MICS
+#define PIPELINE_N_CHANNELS         AUDIO_N_CHANNELS                        // USB channels
+#define PIPELINE_MAX_SAMPLE_BYTES   AUDIO_MAX_SAMPLE_BYTES                  // widest depth, either stream
+#define PIPELINE_PCM_PACKET_BYTES   (CAPTURE_MAX_READ_FRAMES * PIPELINE_N_CHANNELS * AUDIO_ISO_MAX_SAMPLE_BYTES)
+// Slot size: a PCM packet or a vstream block, whichever is larger (the block's
+// worst case is every channel verbatim plus headers and a stamp)
+#define PIPELINE_BLOCK_BYTES        (VSTREAM_HEADER_BYTES + VSTREAM_STAMP_BYTES + \
+                                     LOSSLESS_MAX_BYTES(PIPELINE_N_CHANNELS, CAPTURE_MAX_READ_FRAMES, 8 * PIPELINE_MAX_SAMPLE_BYTES))
+// Event mode: report records (detect_process() finishes at most two frames per packet),
+// then blocks from the pre-trigger ring: PIPELINE_DRAIN_BYTES or one worst-case block,
+// whichever is larger, on average and up to 3/2 of it in one packet. The default is below
+// what a Full-Speed host reads per frame and above what the lossless coder makes of most
+// formats, so the ring catches up.
+#define PIPELINE_MAX_REPORTS        2
+#ifndef PIPELINE_DRAIN_BYTES
+#define PIPELINE_DRAIN_BYTES        1024
+#endif
+#define PIPELINE_EVENT_BYTES        ((PIPELINE_BLOCK_BYTES > PIPELINE_DRAIN_BYTES ? PIPELINE_BLOCK_BYTES : PIPELINE_DRAIN_BYTES) * 3 / 2 + \
+                                     PIPELINE_MAX_REPORTS * VSTREAM_REPORT_BYTES)
+#define PIPELINE_PACKET_BYTES       (PIPELINE_EVENT_BYTES > PIPELINE_PCM_PACKET_BYTES ? PIPELINE_EVENT_BYTES : PIPELINE_PCM_PACKET_BYTES)
+
+#if PIPELINE_N_MICS != CAPTURE_N_CHANNELS
+#error "array_config.h mic count must match the capture channels (capture_config.h)"
+#endif
+#if PIPELINE_N_MICS > DECIM_MAX_CH || (BEAM_OUTPUT != BEAM_OUTPUT_NONE && PIPELINE_N_MICS > BEAM_MAX_MICS)
+#error "more mics than decimate.h / beamform.h hold"
+#endif
+#if PIPELINE_N_CHANNELS > LOSSLESS_MAX_CHANNELS || CAPTURE_MAX_READ_FRAMES > LOSSLESS_MAX_FRAMES
+#error "USB channels / packet frames exceed what lossless.h codes per block"
+#endif
+#if PIPELINE_N_MICS > DETECT_MAX_MICS || CAPTURE_MAX_READ_FRAMES >= DETECT_HOP
+#error "more mics than detect.h holds, or packets long enough for more than PIPELINE_MAX_REPORTS"
+#endif
+
+// ---------- Output ----------
+enum {
+    PIPELINE_OUT_PCM,           // UAC2 packets (iso IN)
+    PIPELINE_OUT_LOSSLESS,      // vstream.h blocks (vendor bulk IN)
+    PIPELINE_OUT_STAMPED,       // vstream.h blocks with SOF stamps
+};
+
+// ---------- Stages ----------
+enum {
+    STAGE_UNPACK,       // ring -> Q31 (capture_read), always on
+    STAGE_DECIM,        // polyphase decimation (on whenever the USB rate is below the capture rate)
+    STAGE_DC,           // DC offset removal
+    STAGE_GAIN,         // per-channel gain
+    STAGE_BEAM,         // delay-and-sum beams (on whenever BEAM_OUTPUT != BEAM_OUTPUT_NONE)
+    STAGE_DETECT,       // drone detector on the mics (on in event mode)
+    STAGE_PACK,         // Q31 -> USB PCM or a lossless block, always on
+    PIPELINE_N_STAGES
+};
+
+#define PIPELINE_STAGE(s)           (1u << (s))
+#if BEAM_OUTPUT != BEAM_OUTPUT_NONE
+#define PIPELINE_STAGES_REQUIRED    (PIPELINE_STAGE(STAGE_UNPACK) | PIPELINE_STAGE(STAGE_BEAM) | PIPELINE_STAGE(STAGE_PACK))
+#else
+#define PIPELINE_STAGES_REQUIRED    (PIPELINE_STAGE(STAGE_UNPACK) | PIPELINE_STAGE(STAGE_PACK))
+#endif
+#define PIPELINE_STAGES_DEFAULT     (PIPELINE_STAGES_REQUIRED | PIPELINE_STAGE(STAGE_DC))
+
+extern const char *const pipeline_stage_names[PIPELINE_N_STAGES];
+
+// ---------- Cycle accounting ----------
+// SysTick cycles of the core running the stages, per packet.
+#define PIPELINE_HIST_BINS          16      // per-packet total, 1/16 of the budget per bin
+typedef struct {
+    uint32_t last;
+    uint32_t max;
+    uint32_t avg;           // IIR, 1/16
+} stage_cycles_t;
+
+typedef struct {
+    stage_cycles_t stage[PIPELINE_N_STAGES];
+    stage_cycles_t total;
+    uint32_t budget;        // cycles per packet deadline (1 ms of clk_sys)
+    uint32_t packets;       // packets produced
+    uint32_t busy;          // sum of per-packet totals (wraps)
+    uint32_t over_budget;   // packets that missed the deadline
+    uint32_t hist[PIPELINE_HIST_BINS];  // last bin includes over budget
+    uint32_t queue_empty;   // IN callbacks that found no packet (silence sent)
+} pipeline_stats_t;
+
+extern volatile pipeline_stats_t pipeline_stats;
+
+// Starts the stages (on core1 in dual-core mode). drift sizes the packets.
+void pipeline_start(drift_t *drift);
+
+// Stops the stages and drops queued packets. core0 only.
+void pipeline_stop(void);
+
+// USB stream format: rate, bytes per sample, and the capture rate it is decimated from
+// (equal = no decimation). Call with the pipeline stopped; defaults are
+// AUDIO_DEFAULT_SAMPLE_RATE and AUDIO_MAX_SAMPLE_BYTES.
+void pipeline_set_format(uint32_t capture_rate, uint32_t sample_rate, uint32_t sample_bytes);
+
+// PIPELINE_OUT_PCM (default), PIPELINE_OUT_LOSSLESS or PIPELINE_OUT_STAMPED. Call with the
+// pipeline stopped; block sequence and frame numbers restart at 0 with every
+// pipeline_set_format().
+void pipeline_set_output(uint32_t output);
+
+// Event mode (vstream.h): the detector (detect.h) runs on the mics after the gain stage,
+// packets carry its reports, and the coded blocks wait in a pre-trigger ring of
+// PIPELINE_PRE_BYTES. From a report with DETECT_ONSET on, every packet also carries the
+// oldest of them, as many as the drain budget covers (PIPELINE_DRAIN_BYTES, at least a
+// worst-case block, per packet on average), up to the last block coded before the report
+// with DETECT_RELEASE; the later ones stay as the next pre-trigger. Needs a vstream output
+// at a rate detect_factor() takes and a format pipeline_detect_fits() takes. Call with the
+// pipeline stopped, after pipeline_set_format() and pipeline_set_output().
+void pipeline_set_detect(bool on);
+
+// Whether the pre-trigger ring holds PIPELINE_PRE_MS of worst-case blocks at this format.
+bool pipeline_detect_fits(uint32_t sample_rate, uint32_t sample_bytes, bool stamped);
+
+// core0, SOF callback: latest SOF for the stamps - extended frame number, capture
+// position (capture_position()) in 1/256 frames, device time. Blocks coded before the
+// first SOF after pipeline_set_format() go out unstamped.
+void pipeline_sof(uint32_t sof, uint32_t cap_pos_q8, uint32_t time_us);
+
+// Enabled stages; required stages are always kept. Safe to call from core0 at any time.
+void pipeline_set_stages(uint32_t mask);
+void pipeline_set_gain(uint32_t mic, int32_t gain_q12);
+
+// Cycles left before the packet deadline in the worst packet seen so far.
+int32_t pipeline_headroom(void);
+
+// Finished packets waiting for the IN callback (always 0 in single-core mode).
+uint32_t pipeline_queued(void);
+
+// core0, IN callback: next finished packet and its length in bytes. Never NULL
+// (silence on underrun). Valid until pipeline_packet_release().
+const uint8_t *pipeline_packet_acquire(uint16_t *len);
+void pipeline_packet_release(void);
+
+#endif // PIPELINE_H
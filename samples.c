@@ -0,0 +1,231 @@
+// samples.c — sample unpacking / packing kernels
+
+#include "samples.h"
+#include <string.h>
+
+// Gathers every third bit of a 24-bit word (bits 0, 3, ... 21) into bits 0..7.
+static inline uint32_t compress3(uint32_t x)
+{
+    x &= 0x249249u;
+    x = (x | (x >> 2)) & 0x0C30C3u;
+    x = (x | (x >> 4)) & 0x00F00Fu;
+    x = (x | (x >> 8)) & 0x0000FFu;
+    return x;
+}
+
+// One slot = 3 data words (24 BCLKs) + 1 padding word (ICS43434 is high-Z after bit 23).
+// Within a word the oldest BCLK sits highest, so compress3() yields MSB-first bytes.
+static inline void unpack_slot(const uint32_t *w, int32_t *out)
+{
+    for (uint32_t line = 0; line < I2S3_N_LINES; line++)
+    {
+        uint32_t v = (compress3(w[0] >> line) << 24)
+                   | (compress3(w[1] >> line) << 16)
+                   | (compress3(w[2] >> line) << 8);
+        out[2 * line] = (int32_t)v;
+    }
+}
+
+void i2s3_unpack(const uint32_t *raw, int32_t *out, uint32_t n_frames)
+{
+    while (n_frames--)
+    {
+        unpack_slot(raw, out);                              // left  -> even channels
+        unpack_slot(raw + I2S3_WORDS_PER_SLOT, out + 1);    // right -> odd channels
+        raw += I2S3_WORDS_PER_FRAME;
+        out += I2S3_N_CHANNELS;
+    }
+}
+
+// Gathers every second / fourth bit of a word (bits 0, n, 2n, ...) into the low bits.
+static inline uint32_t compress2(uint32_t x)
+{
+    x &= 0x55555555u;
+    x = (x | (x >> 1)) & 0x33333333u;
+    x = (x | (x >> 2)) & 0x0F0F0F0Fu;
+    x = (x | (x >> 4)) & 0x00FF00FFu;
+    x = (x | (x >> 8)) & 0x0000FFFFu;
+    return x;
+}
+
+static inline uint32_t compress4(uint32_t x)
+{
+    x &= 0x11111111u;
+    x = (x | (x >> 3)) & 0x03030303u;
+    x = (x | (x >> 6)) & 0x000F000Fu;
+    x = (x | (x >> 12)) & 0x000000FFu;
+    return x;
+}
+
+// Slot bits at bit offset off of an MSB-first stream, left-justified. A slot that
+// starts mid-word ends inside the frame (frames are whole words), so w[i + 1] exists.
+static inline uint32_t slot_at(const uint32_t *w, uint32_t off)
+{
+    uint32_t i = off >> 5, sh = off & 31;
+    return sh ? w[i] << sh | w[i + 1] >> (32 - sh) : w[i];
+}
+
+#define TDM_MAX_LINE_WORDS      (16 * 32 / 32)
+#define TDM_MUTED               0xFFFFFFFFu
+
+// Splits each frame into one bit stream per line (a single line already is one), then
+// cuts out only the mapped slots.
+void tdm_unpack(const tdm_layout_t *t, const uint32_t *raw, int32_t *out, uint32_t n_frames)
+{
+    uint32_t n_lines = t->n_lines, n_ch = t->n_channels;
+    uint32_t line_words = t->n_slots * t->slot_bits / 32;
+    uint32_t keep = ~0u << (32 - t->data_bits);
+    uint32_t split[TDM_MAX_LINES * TDM_MAX_LINE_WORDS];
+    uint32_t off[TDM_MAX_BUS_CHANNELS];
+
+    // Stream bit offset of each output channel (the map is fixed per call)
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        uint32_t m = t->map[c], line = m / t->n_slots;
+        off[c] = line < n_lines ? 32 * line * line_words + (m - line * t->n_slots) * t->slot_bits : TDM_MUTED;
+    }
+
+    while (n_frames--)
+    {
+        const uint32_t *s = split;
+        if (n_lines == 4)
+        {
+            for (uint32_t k = 0; k < line_words; k++, raw += 4)
+                for (uint32_t l = 0; l < 4; l++)
+                    split[l * line_words + k] = compress4(raw[0] >> l) << 24 | compress4(raw[1] >> l) << 16
+                                              | compress4(raw[2] >> l) << 8  | compress4(raw[3] >> l);
+        }
+        else if (n_lines == 2)
+        {
+            for (uint32_t k = 0; k < line_words; k++, raw += 2)
+                for (uint32_t l = 0; l < 2; l++)
+                    split[l * line_words + k] = compress2(raw[0] >> l) << 16 | compress2(raw[1] >> l);
+        }
+        else
+        {
+            s = raw;
+            raw += line_words;
+        }
+
+        for (uint32_t c = 0; c < n_ch; c++)
+            *out++ = off[c] == TDM_MUTED ? 0 : (int32_t)(slot_at(s, off[c]) & keep);
+    }
+}
+
+// ---------- Per-channel processing: C ----------
+static inline int32_t sat_q31(int64_t v)
+{
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+void dc_remove_c(int32_t *x, uint32_t n_frames, uint32_t n_ch, int32_t *mean)
+{
+    // Halved arithmetic keeps x - mean inside 32 bits
+    for (uint32_t f = 0; f < n_frames; f++)
+    {
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            int32_t d = (*x >> 1) - (mean[c] >> 1);
+            mean[c] += d >> (DC_SHIFT - 1);
+            if (d >  0x3FFFFFFF) d =  0x3FFFFFFF;
+            if (d < -0x40000000) d = -0x40000000;
+            *x++ = d * 2;
+        }
+    }
+}
+
+void apply_gain_c(int32_t *x, uint32_t n_frames, uint32_t n_ch, const int32_t *gain_q12)
+{
+    for (uint32_t f = 0; f < n_frames; f++)
+    {
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            *x = sat_q31(((int64_t)*x * gain_q12[c]) >> GAIN_Q);
+            x++;
+        }
+    }
+}
+
+void pcm_pack_c(const int32_t *in, uint8_t *dst, uint32_t n_samples, uint32_t sample_bytes)
+{
+    // Keep the top sample_bytes of each Q31 sample, little-endian.
+    uint32_t drop = 4u - sample_bytes;
+    while (n_samples--)
+    {
+        uint32_t v = (uint32_t)*in++ >> (8u * drop);
+        for (uint32_t b = 0; b < sample_bytes; b++)
+        {
+            *dst++ = (uint8_t)v;
+            v >>= 8;
+        }
+    }
+}
+
+// ---------- Per-channel processing: DSP extension ----------
+// Channel by channel, so the mean and the gain stay in registers.
+void dc_remove_dsp(int32_t *x, uint32_t n_frames, uint32_t n_ch, int32_t *mean)
+{
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        int32_t m = mean[c];
+        int32_t *p = x + c;
+        for (uint32_t f = 0; f < n_frames; f++, p += n_ch)
+        {
+            int32_t d = (*p >> 1) - (m >> 1);
+            m += d >> (DC_SHIFT - 1);
+            *p = dsp_ssat(d, 31) * 2;
+        }
+        mean[c] = m;
+    }
+}
+
+// The Q12 product fits 32 bits when its high word does in GAIN_Q bits: one SSAT
+// instead of two 64-bit compares.
+void apply_gain_dsp(int32_t *x, uint32_t n_frames, uint32_t n_ch, const int32_t *gain_q12)
+{
+    for (uint32_t c = 0; c < n_ch; c++)
+    {
+        int32_t g = gain_q12[c];
+        int32_t *p = x + c;
+        for (uint32_t f = 0; f < n_frames; f++, p += n_ch)
+        {
+            int64_t v = (int64_t)*p * g;
+            int32_t hi = (int32_t)(v >> 32);
+            uint32_t r = (uint32_t)hi << (32 - GAIN_Q) | (uint32_t)v >> GAIN_Q;
+            *p = dsp_ssat(hi, GAIN_Q) == hi ? (int32_t)r : (hi >> 31) ^ INT32_MAX;
+        }
+    }
+}
+
+// Whole little-endian words out (unaligned stores are fine on the M33): two 16-bit
+// samples per PKHTB, four 24-bit samples per three words. Odd tails go through the
+// C version.
+void pcm_pack_dsp(const int32_t *in, uint8_t *dst, uint32_t n_samples, uint32_t sample_bytes)
+{
+    if (sample_bytes == 4)
+    {
+        memcpy(dst, in, n_samples * sizeof(int32_t));
+        return;
+    }
+    if (sample_bytes == 2)
+    {
+        for (; n_samples >= 2; n_samples -= 2, in += 2, dst += 4)
+        {
+            uint32_t w = dsp_pack_hi16(in[0], in[1]);
+            memcpy(dst, &w, sizeof(w));
+        }
+    }
+    else
+    {
+        for (; n_samples >= 4; n_samples -= 4, in += 4, dst += 12)
+        {
+            uint32_t a = (uint32_t)in[0] >> 8, b = (uint32_t)in[1] >> 8;
+            uint32_t c = (uint32_t)in[2] >> 8, d = (uint32_t)in[3] >> 8;
+            uint32_t w[3] = { a | b << 24, b >> 8 | c << 16, c >> 16 | d << 8 };
+            memcpy(dst, w, sizeof(w));
+        }
+    }
+    pcm_pack_c(in, dst, n_samples, sample_bytes);
+}
@@ -0,0 +1,72 @@
+// samples.h — sample unpacking / packing kernels (no SDK dependencies)
+
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <stdint.h>
+#include "dsp.h"
+
+// ---------- i2s_rx3 capture layout ----------
+// See pio/i2s_rx3.pio: 3 SD lines, 32-bit slots, autopush every 8 BCLKs (24 bits).
+#define I2S3_N_LINES            3
+#define I2S3_N_CHANNELS         (2 * I2S3_N_LINES)
+#define I2S3_WORDS_PER_SLOT     4
+#define I2S3_WORDS_PER_FRAME    (2 * I2S3_WORDS_PER_SLOT)
+
+// Transposes packed 3-bit-per-BCLK words into interleaved channels
+// (ch0 = GP2 left, ch1 = GP2 right, ch2 = GP3 left, ...).
+// Output samples are the mic's 24 bits left-justified in an int32 (Q31).
+void i2s3_unpack(const uint32_t *raw, int32_t *out, uint32_t n_frames);
+
+// ---------- tdm_rx capture layout ----------
+// See pio/tdm_rx.pio: n_lines data lines, n_slots x slot_bits BCLKs per frame, autopush
+// every 32 bits, so a frame is n_slots * slot_bits * n_lines / 32 words.
+#define TDM_MAX_LINES           4
+#define TDM_MAX_BUS_CHANNELS    (16 * TDM_MAX_LINES)
+
+typedef struct {
+    uint32_t       n_slots;         // 8 or 16
+    uint32_t       slot_bits;       // 16, 24 or 32
+    uint32_t       data_bits;       // kept from the top of each slot, <= slot_bits
+    uint32_t       n_lines;         // 1, 2 or 4
+    uint32_t       n_channels;      // output channels, <= TDM_MAX_BUS_CHANNELS
+    const uint8_t *map;             // channel c <- bus channel map[c] = line * n_slots + slot
+} tdm_layout_t;
+
+static inline uint32_t tdm_words_per_frame(const tdm_layout_t *t)
+{
+    return t->n_slots * t->slot_bits * t->n_lines / 32;
+}
+
+// Splits the lines and cuts the mapped slots out into interleaved output channels
+// (map entries past the bus give silence). Output samples are the slot's data_bits
+// left-justified in an int32 (Q31).
+void tdm_unpack(const tdm_layout_t *t, const uint32_t *raw, int32_t *out, uint32_t n_frames);
+
+// ---------- Per-channel processing (interleaved Q31, in place) ----------
+// Each kernel below has a C (_c) and a DSP-extension (_dsp) version with the same
+// output; the plain name is the one DSP_KERNELS selects (dsp.h).
+// DC removal: one-pole high-pass, corner ~ fs / (2*pi*2^DC_SHIFT) (~7.5 Hz at 48 kHz).
+#define DC_SHIFT                10
+#define GAIN_Q                  12          // gain_q12: 4096 = 1.0
+
+void dc_remove_c(int32_t *x, uint32_t n_frames, uint32_t n_ch, int32_t *mean);
+void dc_remove_dsp(int32_t *x, uint32_t n_frames, uint32_t n_ch, int32_t *mean);
+void apply_gain_c(int32_t *x, uint32_t n_frames, uint32_t n_ch, const int32_t *gain_q12);
+void apply_gain_dsp(int32_t *x, uint32_t n_frames, uint32_t n_ch, const int32_t *gain_q12);
+
+// Packs Q31 samples into little-endian USB PCM of 2, 3 or 4 bytes per sample.
+void pcm_pack_c(const int32_t *in, uint8_t *dst, uint32_t n_samples, uint32_t sample_bytes);
+void pcm_pack_dsp(const int32_t *in, uint8_t *dst, uint32_t n_samples, uint32_t sample_bytes);
+
+#if DSP_KERNELS
+#define dc_remove               dc_remove_dsp
+#define apply_gain              apply_gain_dsp
+#define pcm_pack                pcm_pack_dsp
+#else
+#define dc_remove               dc_remove_c
+#define apply_gain              apply_gain_c
+#define pcm_pack                pcm_pack_c
+#endif
+
+#endif // SAMPLES_H
@@ -0,0 +1,186 @@
+// telemetry.c — core0 USB counters and the vendor-request snapshot
+//
+// The IN and SOF hooks only bump counters and two log2 histograms (a timer read and
+// a CLZ each). Everything else is read where it already lives - capture_stats,
+// pipeline_stats, the drift tracker - when the host asks for a snapshot. core1's
+// counters are single words it alone writes, so core0 reads them without locking;
+// a snapshot taken mid-packet may be off by that one packet. The interface also
+// carries the vendor bulk stream, so its control requests are dispatched here too.
+
+#include "telemetry.h"
+#include "audio_config.h"
+#include "audio_ctrl.h"
+#include "capture.h"
+#include "pipeline.h"
+#include "vstream.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "tusb.h"
+#include <string.h>
+
+_Static_assert(PIPELINE_N_STAGES <= TELEMETRY_MAX_STAGES, "telemetry snapshot has too few stage slots");
+_Static_assert(PIPELINE_HIST_BINS == TELEMETRY_HIST_BINS, "cycle histogram size differs from the wire format");
+
+// ---------- Globals (core0 only) ----------
+typedef struct {
+    uint32_t sofs;
+    uint32_t sof_us;                // time of the last SOF
+    uint32_t in_sof;                // sofs at the last IN load
+    uint32_t in_packets;
+    uint32_t in_late;
+    uint32_t in_missed;
+    uint32_t in_busy_us;
+    uint32_t in_latency_max_us;
+    uint32_t in_latency_hist[TELEMETRY_HIST_BINS];
+    uint32_t in_duration_hist[TELEMETRY_HIST_BINS];
+} usb_counters_t;
+
+static usb_counters_t        usb;
+static drift_t              *tel_drift;
+static telemetry_snapshot_t  snap;                          // EP0 sends from here
+static vstream_info_t        vinfo;
+static char                  stage_names[PIPELINE_N_STAGES * 12];
+static uint16_t              stage_names_len;
+
+// ---------- Hot path ----------
+static inline uint32_t log2_bin(uint32_t us)
+{
+    uint32_t b = us ? 32 - (uint32_t)__builtin_clz(us) : 0;
+    return b < TELEMETRY_HIST_BINS ? b : TELEMETRY_HIST_BINS - 1;
+}
+
+void telemetry_sof(void)
+{
+    usb.sof_us = time_us_32();
+    usb.sofs++;
+}
+
+uint32_t telemetry_in_begin(void)
+{
+    uint32_t now = time_us_32();
+    uint32_t lat = now - usb.sof_us;
+    usb.in_latency_hist[log2_bin(lat)]++;
+    if (lat > usb.in_latency_max_us) usb.in_latency_max_us = lat;
+
+    // One load per SOF: none since the last SOF means this one ran behind,
+    // more than one SOF means frames went out without a fresh load
+    uint32_t gap = usb.sofs - usb.in_sof;
+    if (usb.in_packets)
+    {
+        if (gap == 0) usb.in_late++;
+        else          usb.in_missed += gap - 1;
+    }
+    usb.in_sof = usb.sofs;
+    return now;
+}
+
+void telemetry_in_end(uint32_t t_begin)
+{
+    uint32_t d = time_us_32() - t_begin;
+    usb.in_duration_hist[log2_bin(d)]++;
+    usb.in_busy_us += d;
+    usb.in_packets++;
+}
+
+// ---------- Snapshot ----------
+void telemetry_init(drift_t *drift)
+{
+    tel_drift = drift;
+
+    uint16_t n = 0;
+    for (uint32_t s = 0; s < PIPELINE_N_STAGES; s++)
+    {
+        uint16_t len = (uint16_t)strlen(pipeline_stage_names[s]) + 1;
+        if (n + len > sizeof(stage_names)) break;
+        memcpy(&stage_names[n], pipeline_stage_names[s], len);
+        n += len;
+    }
+    stage_names_len = n;
+}
+
+static void snapshot(void)
+{
+    telemetry_snapshot_t *t = &snap;
+    memset(t, 0, sizeof(*t));
+    t->magic   = TELEMETRY_MAGIC;
+    t->version = TELEMETRY_VERSION;
+    t->size    = sizeof(*t);
+    t->time_us = time_us_32();
+
+    t->sample_rate  = audio_ctrl_sample_rate();
+    t->capture_rate = AUDIO_CAPTURE_RATE(t->sample_rate);
+    t->sample_bytes = (uint8_t)audio_ctrl_sample_bytes();
+    t->n_channels   = PIPELINE_N_CHANNELS;
+    t->dual_core    = PIPELINE_DUAL_CORE;
+    t->n_stages     = PIPELINE_N_STAGES;
+
+    // capture_frames_total() also brings dma_blocks up to date
+    t->frames      = capture_frames_total();
+    t->dma_blocks  = capture_stats.dma_blocks;
+    t->overruns    = capture_stats.overruns;
+    t->underruns   = capture_stats.underruns;
+    t->ring_fill   = capture_fill();
+    t->ring_frames = 2 * capture_target_fill();
+
+    t->sofs              = usb.sofs;
+    t->in_packets        = usb.in_packets;
+    t->in_empty          = pipeline_stats.queue_empty;
+    t->in_late           = usb.in_late;
+    t->in_missed         = usb.in_missed;
+    t->in_busy_us        = usb.in_busy_us;
+    t->in_latency_max_us = usb.in_latency_max_us;
+    memcpy(t->in_latency_hist, usb.in_latency_hist, sizeof(t->in_latency_hist));
+    memcpy(t->in_duration_hist, usb.in_duration_hist, sizeof(t->in_duration_hist));
+
+    t->clk_sys_hz  = clock_get_hz(clk_sys);
+    t->budget      = pipeline_stats.budget;
+    t->packets     = pipeline_stats.packets;
+    t->busy_cycles = pipeline_stats.busy;
+    t->over_budget = pipeline_stats.over_budget;
+    t->queue_depth = pipeline_queued();
+    for (uint32_t s = 0; s < PIPELINE_N_STAGES; s++)
+    {
+        t->stage_avg[s] = pipeline_stats.stage[s].avg;
+        t->stage_max[s] = pipeline_stats.stage[s].max;
+    }
+    t->total_avg = pipeline_stats.total.avg;
+    t->total_max = pipeline_stats.total.max;
+    for (uint32_t b = 0; b < TELEMETRY_HIST_BINS; b++)
+        t->cycle_hist[b] = pipeline_stats.hist[b];
+
+    t->drift_ppm     = drift_ppm(tel_drift);
+    t->drift_windows = tel_drift->windows;
+}
+
+// ---------- TinyUSB vendor class callback ----------
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    if (stage != CONTROL_STAGE_SETUP) return true;
+    if (request->bmRequestType_bit.type != TUSB_REQ_TYPE_VENDOR ||
+        request->wIndex != TELEMETRY_ITF) return false;
+    bool in = request->bmRequestType_bit.direction == TUSB_DIR_IN;
+
+    switch (request->bRequest)
+    {
+    case TELEMETRY_REQ_SNAPSHOT:
+        if (!in) return false;
+        snapshot();
+        return tud_control_xfer(rhport, request, &snap, sizeof(snap));
+    case TELEMETRY_REQ_STAGE_NAMES:
+        if (!in) return false;
+        return tud_control_xfer(rhport, request, stage_names, stage_names_len);
+    case VSTREAM_REQ_INFO:
+        if (!in) return false;
+        vstream_info(&vinfo);
+        return tud_control_xfer(rhport, request, &vinfo, sizeof(vinfo));
+    case VSTREAM_REQ_START:
+        if (in || !vstream_start(request->wValue)) return false;
+        return tud_control_status(rhport, request);
+    case VSTREAM_REQ_STOP:
+        if (in) return false;
+        vstream_stop();
+        return tud_control_status(rhport, request);
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,97 @@
+// telemetry.h — hot-path counters and histograms, read by the host over a vendor interface
+//
+// The device keeps plain per-core counters: core1 (or whichever core runs the stages)
+// writes pipeline_stats, core0 writes the USB/IN counters here. Nothing is sent
+// unsolicited: the host asks for a snapshot with a vendor control request on EP0,
+// which is assembled on core0 from tud_task() and never touches the audio endpoint.
+// Counters are monotonic and wrap at 2^32; the host works on deltas between snapshots.
+//
+// The wire format below is shared with host/telemetry_read.c (no SDK dependencies).
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "drift.h"
+
+// ---------- Interface ----------
+// Vendor-specific interface after the audio function. Telemetry uses EP0 requests
+// only; the interface's bulk endpoints belong to the vendor stream (vstream.h).
+#define TELEMETRY_ITF               2
+#define TELEMETRY_DESC_LEN          9           // the interface descriptor
+
+// bmRequestType: vendor, interface recipient, wIndex = TELEMETRY_ITF
+#define TELEMETRY_REQ_SNAPSHOT      0x01        // IN: telemetry_snapshot_t
+#define TELEMETRY_REQ_STAGE_NAMES   0x02        // IN: stage names, NUL separated
+
+#define TELEMETRY_MAGIC             0x4D4C4554  // "TELM"
+#define TELEMETRY_VERSION           1
+
+// ---------- Histograms ----------
+// Log2 microsecond bins: bin 0 = 0 us, bin b = [2^(b-1), 2^b) us, last bin open-ended.
+// Cycle bins: bin b = [b, b + 1) / TELEMETRY_HIST_BINS of the per-packet budget; the
+// last bin also takes everything over budget.
+#define TELEMETRY_HIST_BINS         16
+#define TELEMETRY_MAX_STAGES        8
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                  // sizeof(telemetry_snapshot_t)
+    uint32_t time_us;               // device time of the snapshot (wraps)
+
+    // Stream format
+    uint32_t sample_rate;
+    uint32_t capture_rate;
+    uint8_t  sample_bytes;
+    uint8_t  n_channels;
+    uint8_t  dual_core;
+    uint8_t  n_stages;
+
+    // Capture: PIO -> DMA ring (read on core0)
+    uint32_t dma_blocks;            // ring slots completed by the data channel
+    uint32_t frames;                // frames captured
+    uint32_t overruns;              // consumer lapped by the DMA (frames skipped)
+    uint32_t underruns;             // reads short of frames (zero-padded)
+    uint32_t ring_fill;             // frames waiting now
+    uint32_t ring_frames;           // ring size at the current rate
+
+    // USB IN (core0)
+    uint32_t sofs;
+    uint32_t in_packets;            // tud_audio_tx_done_pre_load_cb calls that loaded a packet
+    uint32_t in_empty;              // of those, silence because no packet was ready
+    uint32_t in_late;               // loads with no SOF since the previous one (ran behind)
+    uint32_t in_missed;             // SOF frames that got no load at all
+    uint32_t in_busy_us;            // time spent in the IN callback
+    uint32_t in_latency_max_us;     // SOF -> IN callback
+    uint32_t in_latency_hist[TELEMETRY_HIST_BINS];
+    uint32_t in_duration_hist[TELEMETRY_HIST_BINS];
+
+    // Stages (core1 in dual-core mode, core0 otherwise), SysTick cycles per packet
+    uint32_t clk_sys_hz;
+    uint32_t budget;                // cycles per 1 ms packet deadline
+    uint32_t packets;
+    uint32_t busy_cycles;           // sum of per-packet totals (load = delta / delta time)
+    uint32_t over_budget;           // packets that took longer than the budget
+    uint32_t queue_depth;           // finished packets waiting for the IN callback now
+    uint32_t stage_avg[TELEMETRY_MAX_STAGES];
+    uint32_t stage_max[TELEMETRY_MAX_STAGES];
+    uint32_t total_avg;
+    uint32_t total_max;
+    uint32_t cycle_hist[TELEMETRY_HIST_BINS];       // per-packet total vs. budget
+
+    // Clock drift (I2S vs SOF)
+    int32_t  drift_ppm;
+    uint32_t drift_windows;         // measurement windows since the last rate change
+} telemetry_snapshot_t;
+
+// ---------- Device side (core0) ----------
+// drift is the tracker the snapshot reports (the one main.c feeds from SOF).
+void telemetry_init(drift_t *drift);
+
+// Hot path: SOF callback, and around the IN pre-load callback's packet hand-over.
+void     telemetry_sof(void);
+uint32_t telemetry_in_begin(void);
+void     telemetry_in_end(uint32_t t_begin);
+
+#endif // TELEMETRY_H
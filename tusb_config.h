@@ -1,12 +1,16 @@
 #ifndef _TUSB_CONFIG_H_
 #define _TUSB_CONFIG_H_
 
+#include "audio_config.h"
+#include "telemetry.h"
+#include "vstream.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // --- MCU & OS ---
-#define CFG_TUSB_MCU    OPT_MCU_RP2040
+#define CFG_TUSB_MCU    OPT_MCU_RP2040      // also the RP2350: same USB controller
 #define CFG_TUSB_OS     OPT_OS_PICO
 
 #ifndef CFG_TUSB_DEBUG
@@ -22,24 +26,35 @@ extern "C" {
 #define CFG_TUD_MSC     0
 #define CFG_TUD_HID     0
 #define CFG_TUD_MIDI    0
-#define CFG_TUD_VENDOR  0
+#define CFG_TUD_VENDOR  1           // telemetry (telemetry.h) + bulk stream (vstream.h)
 #define CFG_TUD_AUDIO   1
 
-// --- AUDIO (2ch mic: device -> host @ 48kHz/16-bit) ---
+// --- AUDIO (mics [+ beams]: device -> host, rate/depth from audio_config.h) ---
 #define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ            64
-#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN               TUD_AUDIO_DESC_IAD_LEN
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN               AUDIO_FUNC_DESC_LEN
 #define CFG_TUD_AUDIO_FUNC_1_N_AS_INT               1
 
-#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX          2     // MODIFIED: Was 6
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX          AUDIO_N_CHANNELS
 #define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX          0
 
-#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX  2     // MODIFIED: Was 3
-#define CFG_TUD_AUDIO_FUNC_1_N_BITS_PER_SAMPLE_TX   16    // MODIFIED: Was 24
+// Largest alt setting (24-bit unless it exceeds an iso packet); the 16-bit alt uses less
+// of the same buffers
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX  AUDIO_ISO_MAX_SAMPLE_BYTES
+#define CFG_TUD_AUDIO_FUNC_1_N_BITS_PER_SAMPLE_TX   (8 * AUDIO_ISO_MAX_SAMPLE_BYTES)
 
-#define CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE        48000 // MODIFIED: Was 16000
+#define CFG_TUD_AUDIO_FUNC_1_MAX_SAMPLE_RATE        AUDIO_MAX_SAMPLE_RATE
 
-// 1ms frame: 48kHz/1000 * 2ch * 2B = 192 B
-#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX           (48000/1000 * 2 * 2)
+// One 1 ms packet of the widest alt at the top rate, +1 frame for async drift: scales with
+// the USB channels (mics, beams, TDM map), e.g. 6 ch * 3 B * 49 = 882 B. With no alt the
+// endpoint is never opened and gets the full iso packet.
+#if AUDIO_N_ALTS
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX           AUDIO_EP_SIZE(AUDIO_ISO_MAX_SAMPLE_BYTES)
+#else
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX           AUDIO_ISO_MAX_PACKET
+#endif
+#if CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX > AUDIO_ISO_MAX_PACKET
+#error "IN endpoint larger than a Full-Speed iso packet: fewer channels or 16-bit only"
+#endif
 #define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ        (2 * CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX)
 
 #ifndef CFG_TUD_AUDIO_ENABLE_EP_IN
@@ -49,6 +64,12 @@ extern "C" {
 #define CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP 0
 #endif
 
+// --- VENDOR (telemetry on EP0; bulk IN carries vstream blocks, bulk OUT is unused) ---
+// TX holds a few 1 ms blocks so a host that polls late does not stall the stream at once
+#define CFG_TUD_VENDOR_EPSIZE       VSTREAM_EP_SIZE
+#define CFG_TUD_VENDOR_RX_BUFSIZE   64
+#define CFG_TUD_VENDOR_TX_BUFSIZE   4096
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,13 +6,14 @@ tusb_desc_device_t const desc_device = {
   .bLength            = sizeof(tusb_desc_device_t),
   .bDescriptorType    = TUSB_DESC_DEVICE,
   .bcdUSB             = 0x0200,
-  .bDeviceClass       = 0x00,
-  .bDeviceSubClass    = 0x00,
-  .bDeviceProtocol    = 0x00,
+  // Composite (audio function + telemetry): IAD device class
+  .bDeviceClass       = TUSB_CLASS_MISC,
+  .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+  .bDeviceProtocol    = MISC_PROTOCOL_IAD,
   .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
   .idVendor           = 0xCafe,
   .idProduct          = 0x4066,
-  .bcdDevice          = 0x0100,
+  .bcdDevice          = 0x0120,
   .iManufacturer      = 0x01,
   .iProduct           = 0x02,
   .iSerialNumber      = 0x03,
@@ -23,67 +24,70 @@ uint8_t const* tud_descriptor_device_cb(void) {
   return (uint8_t const*) &desc_device;
 }
 
-// ---------- Config descriptor (UAC2, 6ch mic @ 16 kHz / 16-bit packed) ----------
-enum { ITF_NUM_AC = 0, ITF_NUM_AS, ITF_NUM_TOTAL };
+// ---------- Config descriptor (UAC2, derived from audio_config.h) ----------
+// One AS interface with a 16-bit and a 24-bit alternate setting (those that fit an iso
+// packet at the channel count, see audio_config.h); the Clock Source
+// has a host-programmable sample frequency (see audio_ctrl.c for the requests).
+// A vendor interface follows: telemetry on EP0 (telemetry.h) and a bulk IN/OUT pair
+// for the lossless stream (vstream.h; TinyUSB's vendor class opens both).
+enum { ITF_NUM_AC = AUDIO_ITF_AC, ITF_NUM_AS = AUDIO_ITF_AS, ITF_NUM_TELEMETRY = TELEMETRY_ITF, ITF_NUM_TOTAL };
 #define EPNUM_AUDIO_IN      0x01
 #define EP_ADDR_AUDIO_IN    (0x80 | EPNUM_AUDIO_IN)
 
-#define AUDIO_N_CHANNELS    6
-#define AUDIO_SAMPLE_RATE   16000
-#define AUDIO_SAMPLE_BYTES  2
-#define AUDIO_PACKET_SIZE   ((AUDIO_SAMPLE_RATE/1000) * AUDIO_N_CHANNELS * AUDIO_SAMPLE_BYTES) // 16 * 6 * 2 = 192
+#define ID_CLK  AUDIO_ENTITY_CLOCK
+#define ID_IT   AUDIO_ENTITY_IT
+#define ID_OT   AUDIO_ENTITY_OT
 
-#define ID_CLK  0x01
-#define ID_IT   0x02
-#define ID_FU   0x03
-#define ID_OT   0x04
-#define LEN_CS_AC_HEADER    9
-#define LEN_CS_CLK_SRC      8
-#define LEN_CS_IT           17
-#define LEN_CS_FU           34
-#define LEN_CS_OT           12
-#define AC_CS_TOTAL         80
+#define STRID_TELEMETRY     4
+
+#define CONFIG_TOTAL_LEN    (9 + AUDIO_FUNC_DESC_LEN + TELEMETRY_DESC_LEN + VSTREAM_DESC_LEN)
+
+// AS alternate setting: interface, CS general, Type I format, ISO IN (async) endpoint
+#define AS_ALT_DESC(alt, bytes)                                                                 \
+  9, TUSB_DESC_INTERFACE, ITF_NUM_AS, alt, 1, TUSB_CLASS_AUDIO, 0x02, 0x20, 0,                  \
+  AUDIO_DESC_LEN_AS_GENERAL, 0x24, 0x01, ID_OT, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00,             \
+      AUDIO_N_CHANNELS, 0, 0, 0, 0, 0,                                                          \
+  AUDIO_DESC_LEN_FORMAT, 0x24, 0x02, 0x01, (bytes), 8 * (bytes),                                \
+  AUDIO_DESC_LEN_EP, TUSB_DESC_ENDPOINT, EP_ADDR_AUDIO_IN, 0x05,                                \
+      (uint8_t)(AUDIO_EP_SIZE(bytes) & 0xFF), (uint8_t)(AUDIO_EP_SIZE(bytes) >> 8), 0x01,       \
+  AUDIO_DESC_LEN_CS_EP, 0x25, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00
 
 static uint8_t const desc_configuration[] = {
   // ---- Standard Configuration ----
   9, TUSB_DESC_CONFIGURATION,
-  0x00, 0x00, ITF_NUM_TOTAL, 1, 0, 0x80, 50,
-  // ---- IAD (Audio Function) ----
-  8, TUSB_DESC_INTERFACE_ASSOCIATION, ITF_NUM_AC, 2, TUSB_CLASS_AUDIO, 0x00, 0x00, 0,
+  (uint8_t)(CONFIG_TOTAL_LEN & 0xFF), (uint8_t)(CONFIG_TOTAL_LEN >> 8), ITF_NUM_TOTAL, 1, 0, 0x80, 50,
+  // ---- IAD (Audio Function, UAC2) ----
+  AUDIO_DESC_LEN_IAD, TUSB_DESC_INTERFACE_ASSOCIATION, ITF_NUM_AC, 2, TUSB_CLASS_AUDIO, 0x00, 0x20, 0,
   // ---- Standard AC Interface ----
   9, TUSB_DESC_INTERFACE, ITF_NUM_AC, 0, 0, TUSB_CLASS_AUDIO, 0x01, 0x20, 0,
-  // ---- Class-Specific AC Header ----
-  LEN_CS_AC_HEADER, 0x24, 0x01, 0x00, 0x02, (uint8_t)(AC_CS_TOTAL & 0xFF), (uint8_t)(AC_CS_TOTAL >> 8), 1, ITF_NUM_AS,
-  // ---- Clock Source Entity ----
-  LEN_CS_CLK_SRC, 0x24, 0x0A, ID_CLK, 0x01, 0x01, 0x00, 0x00,
-  // ---- Input Terminal ----
-  LEN_CS_IT, 0x24, 0x02, ID_IT, 0x01, 0x02, 0x00, ID_CLK, AUDIO_N_CHANNELS, 0,0,0,0, 0x00, 0x00, 0x00, 0x00,
-  // ---- Feature Unit ----
-  LEN_CS_FU, 0x24, 0x06, ID_FU, ID_IT,
-  0x03, 0x00, 0x00, 0x00, // Master
-  0x00, 0x00, 0x00, 0x00, // Ch1
-  0x00, 0x00, 0x00, 0x00, // Ch2
-  0x00, 0x00, 0x00, 0x00, // Ch3
-  0x00, 0x00, 0x00, 0x00, // Ch4
-  0x00, 0x00, 0x00, 0x00, // Ch5
-  0x00, 0x00, 0x00, 0x00, // Ch6  <-- CORRECTED: Added comma
-  0x00,                   // iFeature
-  // ---- Output Terminal ----
-  LEN_CS_OT, 0x24, 0x03, ID_OT, 0x01, 0x01, 0x00, ID_FU, ID_CLK, 0x00, 0x00, 0x00,
-  // ---- AS Interface, alt 0 ----
+  // ---- Class-Specific AC Header (bcdADC 2.00, category microphone) ----
+  AUDIO_DESC_LEN_AC_HEADER, 0x24, 0x01, 0x00, 0x02, 0x03,
+      (uint8_t)(AUDIO_DESC_LEN_AC_CS & 0xFF), (uint8_t)(AUDIO_DESC_LEN_AC_CS >> 8), 0x00,
+  // ---- Clock Source: internal programmable, frequency R/W, validity R ----
+  AUDIO_DESC_LEN_CLK_SRC, 0x24, 0x0A, ID_CLK, 0x03, 0x07, 0x00, 0x00,
+  // ---- Input Terminal (microphone array) ----
+  AUDIO_DESC_LEN_IT, 0x24, 0x02, ID_IT, 0x01, 0x02, 0x00, ID_CLK, AUDIO_N_CHANNELS, 0,0,0,0, 0x00, 0x00, 0x00, 0x00,
+  // ---- Output Terminal (USB streaming), fed straight from the IT ----
+  AUDIO_DESC_LEN_OT, 0x24, 0x03, ID_OT, 0x01, 0x01, 0x00, ID_IT, ID_CLK, 0x00, 0x00, 0x00,
+  // ---- AS Interface, alt 0 (zero bandwidth) ----
   9, TUSB_DESC_INTERFACE, ITF_NUM_AS, 0, 0, TUSB_CLASS_AUDIO, 0x02, 0x20, 0,
-  // ---- AS Interface, alt 1 ----
-  9, TUSB_DESC_INTERFACE, ITF_NUM_AS, 1, 1, TUSB_CLASS_AUDIO, 0x02, 0x20, 0,
-  // ---- CS AS General ----
-  16, 0x24, 0x01, ID_OT, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, AUDIO_N_CHANNELS, 0,0,0,0, 0,
-  // ---- Type I Format (16-bit) ----
-  6, 0x24, 0x02, 0x01, AUDIO_SAMPLE_BYTES, 16,
-  // ---- Standard ISO IN Endpoint ----
-  7, TUSB_DESC_ENDPOINT, EP_ADDR_AUDIO_IN, 0x05, (AUDIO_PACKET_SIZE & 0xFF), (AUDIO_PACKET_SIZE >> 8), 0x01,
-  // ---- CS ISO IN Endpoint ----
-  8, 0x25, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+#if AUDIO_N_ALTS >= 1
+  // ---- AS Interface, alt 1: 16-bit ----
+  AS_ALT_DESC(AUDIO_ALT_16BIT, 2),
+#endif
+#if AUDIO_N_ALTS >= 2
+  // ---- AS Interface, alt 2: 24-bit in 3 bytes ----
+  AS_ALT_DESC(AUDIO_ALT_24BIT, 3),
+#endif
+  // ---- Telemetry + bulk stream: vendor interface, bulk OUT/IN ----
+  TELEMETRY_DESC_LEN, TUSB_DESC_INTERFACE, ITF_NUM_TELEMETRY, 0, 2, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, STRID_TELEMETRY,
+  7, TUSB_DESC_ENDPOINT, VSTREAM_EP_OUT, TUSB_XFER_BULK, VSTREAM_EP_SIZE, 0, 0,
+  7, TUSB_DESC_ENDPOINT, VSTREAM_EP_IN, TUSB_XFER_BULK, VSTREAM_EP_SIZE, 0, 0,
 };
 
+_Static_assert(sizeof(desc_configuration) == CONFIG_TOTAL_LEN, "audio_config.h descriptor lengths out of sync");
+_Static_assert(TELEMETRY_ITF == AUDIO_ITF_AS + 1, "interface numbers must be contiguous");
+
 static uint8_t cfg_desc_buf[sizeof(desc_configuration)];
 
 uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
@@ -99,8 +103,9 @@ uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
 static char const* string_desc[] = {
   (const char[]){ 0x09, 0x04 },   // 0: English (US)
   "het68",                        // 1: Manufacturer
-  "Pico 6ch Microphone 16k/16",   // 2: Product
+  "Pico 6ch Microphone",          // 2: Product
   "123654",                       // 3: Serial
+  "het68 telemetry/stream",       // 4: Telemetry + bulk stream interface
 };
 
 static uint16_t _desc_str[32];
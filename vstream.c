@@ -0,0 +1,108 @@
+// vstream.c — vendor bulk stream: hands lossless blocks from the pipeline to the bulk IN FIFO
+//
+// Runs on core0 from the SOF callback, like the iso path's IN callback: the blocks are
+// already coded by the stages, so this only copies them into TinyUSB's vendor FIFO.
+// A block is written whole or not at all; with no room it stays queued (dual-core) and
+// core1 backs up into the capture ring, which skips frames once full - visible to the
+// host as a jump in the block's frame number. In event mode the pipeline pauses the
+// pre-trigger drain instead, so the detector keeps every frame. Every SOF also goes to
+// the pipeline for the stamps, with its 11-bit frame number extended here.
+
+#include "vstream.h"
+#include "audio_ctrl.h"
+#include "pipeline.h"
+#include "tusb.h"
+#include "pico/stdlib.h"
+#include <string.h>
+
+_Static_assert(PIPELINE_EVENT_BYTES <= CFG_TUD_VENDOR_TX_BUFSIZE, "bulk FIFO must hold a worst-case packet");
+
+// ---------- Globals (core0 only) ----------
+static vstream_info_t counters;
+static bool           stamped;          // of the running stream
+static bool           detect;           // event mode: reports ahead of the blocks
+static uint32_t       sof_ext;          // USB frame number, extended past 11 bits
+
+// Worst-case block at a rate and depth
+static uint32_t block_bytes(uint32_t rate, uint32_t sample_bytes)
+{
+    return VSTREAM_BLOCK_MAX_BYTES(PIPELINE_N_CHANNELS, rate / 1000 + 1, 8 * sample_bytes, stamped);
+}
+
+// ---------- Control (telemetry.c dispatches the requests) ----------
+bool vstream_start(uint32_t value)
+{
+    if (value & ~(VSTREAM_START_STAMPED | VSTREAM_START_DETECT | 0xFFu)) return false;     // unknown flags
+    bool stamp = (value & VSTREAM_START_STAMPED) != 0;
+    bool event = (value & VSTREAM_START_DETECT) != 0;
+    if (!audio_ctrl_bulk_start(value & 0xFFu, stamp, event)) return false;
+    stamped = stamp;
+    detect = event;
+    return true;
+}
+
+void vstream_stop(void)
+{
+    audio_ctrl_bulk_stop();
+}
+
+void vstream_info(vstream_info_t *info)
+{
+    bool running = audio_ctrl_bulk_running();
+    *info = counters;
+    info->version         = VSTREAM_VERSION;
+    info->n_channels      = PIPELINE_N_CHANNELS;
+    info->bits            = running ? (uint8_t)(8 * audio_ctrl_sample_bytes()) : 0;
+    info->sample_rate     = audio_ctrl_sample_rate();
+    info->max_block_bytes = (uint16_t)block_bytes(info->sample_rate, running ? audio_ctrl_sample_bytes()
+                                                                             : AUDIO_MAX_SAMPLE_BYTES);
+    info->running         = running;
+}
+
+// ---------- Hot path ----------
+// One finished packet into the FIFO; false if it does not fit yet. A packet is one
+// block, or in event mode reports and blocks (pipeline_set_detect()).
+static bool send_block(void)
+{
+    uint32_t room = block_bytes(audio_ctrl_sample_rate(), audio_ctrl_sample_bytes());
+    if (detect) room = (room > PIPELINE_DRAIN_BYTES ? room : PIPELINE_DRAIN_BYTES) * 3 / 2 +
+                       PIPELINE_MAX_REPORTS * VSTREAM_REPORT_BYTES;
+    if (tud_vendor_write_available() < room)
+    {
+        counters.stalls++;
+        return false;
+    }
+    uint16_t len;
+    const uint8_t *blk = pipeline_packet_acquire(&len);
+    if (len) tud_vendor_write(blk, len);
+    for (uint32_t off = 0; off < len;)
+    {
+        vstream_block_t h;
+        memcpy(&h, blk + off, sizeof(h));
+        off += h.bytes;
+        if (h.sync == VSTREAM_SYNC_DETECT) continue;
+        counters.blocks++;
+        counters.raw_bytes += (uint32_t)h.n_frames * h.n_channels * (h.bits / 8);
+    }
+    pipeline_packet_release();
+    counters.bytes += len;
+    return true;
+}
+
+void vstream_sof(uint32_t frame_count, uint32_t cap_frames, uint32_t cap_frac_q8)
+{
+    uint32_t now = time_us_32();
+    sof_ext += (frame_count - sof_ext) & 0x7FF;
+    pipeline_sof(sof_ext, cap_frames << 8 | cap_frac_q8, now);
+
+    if (!audio_ctrl_bulk_running() || !tud_vendor_mounted()) return;
+
+#if PIPELINE_DUAL_CORE
+    // Everything core1 has finished, so a backlog after a slow host read drains at once
+    while (pipeline_queued() && send_block()) {}
+#else
+    // Stages run inline: one block per SOF, as the iso stream takes them
+    send_block();
+#endif
+    tud_vendor_write_flush();
+}
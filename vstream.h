@@ -0,0 +1,113 @@
+// vstream.h — vendor bulk stream: lossless-coded blocks with sequence numbers and timestamps
+//
+// Alternative to the UAC2 isochronous stream for channel counts Full-Speed iso cannot
+// carry. The host starts it with a vendor request on the telemetry interface
+// (telemetry.h); the stages then code every packet with lossless.h on the stage core,
+// and core0 moves the blocks to the interface's bulk IN endpoint on every SOF. Bulk
+// has no reserved bandwidth, so a host that falls behind shows up as jumps in `frame`
+// (capture overruns), never as corrupt data. The iso stream and the bulk stream are
+// exclusive: selecting an audio alt setting stops the bulk stream.
+//
+// Stamped blocks (START with VSTREAM_START_STAMPED) also carry where the stream stood
+// at the latest USB SOF. Devices on one bus see the same SOFs, so the stamps line up
+// the streams of several devices to well under a sample (host/vstream_align.h).
+//
+// Event mode (START with VSTREAM_START_DETECT) runs the drone detector (detect.h) on the
+// mics and sends one report record per analysed frame: a header with VSTREAM_SYNC_DETECT
+// and bits 0, then a detect_features_t. The audio blocks are still coded, but wait in a
+// pre-trigger ring on the device; they go out from the onset of a detection, oldest
+// first, up to the last one coded before the release. Sent blocks are numbered in
+// sending order, so a seq gap still means host-side loss; what the ring never sent shows
+// up as a jump in `frame`. Reports number their own seq.
+//
+// The wire format below is shared with host/vstream_rec.c (no SDK dependencies).
+
+#ifndef VSTREAM_H
+#define VSTREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lossless.h"
+#include "detect.h"
+
+// ---------- Endpoints (on the telemetry interface) ----------
+#define VSTREAM_EP_OUT              0x02        // unused, TinyUSB's vendor class opens a pair
+#define VSTREAM_EP_IN               0x82
+#define VSTREAM_EP_SIZE             64
+#define VSTREAM_DESC_LEN            14          // the two endpoint descriptors
+
+// ---------- Requests: vendor, interface recipient, wIndex = TELEMETRY_ITF ----------
+#define VSTREAM_REQ_INFO            0x10        // IN: vstream_info_t
+#define VSTREAM_REQ_START           0x11        // OUT, wValue = bytes per sample (2 or 3) | flags
+#define VSTREAM_REQ_STOP            0x12        // OUT
+
+#define VSTREAM_START_STAMPED       0x0100      // START flag: every block carries a vstream_stamp_t
+#define VSTREAM_START_DETECT        0x0200      // START flag: event mode (detection reports, triggered audio)
+
+#define VSTREAM_SYNC                0xB10C
+#define VSTREAM_SYNC_STAMPED        0xB10D      // header followed by a vstream_stamp_t, then the payload
+#define VSTREAM_SYNC_DETECT         0xB10E      // header followed by a detect_features_t, no audio
+#define VSTREAM_VERSION             1
+#define VSTREAM_HEADER_BYTES        20
+#define VSTREAM_STAMP_BYTES         12
+#define VSTREAM_REPORT_BYTES        (VSTREAM_HEADER_BYTES + DETECT_FEATURE_BYTES)
+
+// Worst-case block: every channel verbatim
+#define VSTREAM_BLOCK_MAX_BYTES(n_channels, n_frames, bits, stamped) \
+    (VSTREAM_HEADER_BYTES + ((stamped) ? VSTREAM_STAMP_BYTES : 0) + LOSSLESS_MAX_BYTES(n_channels, n_frames, bits))
+
+// One block per 1 ms packet, followed by its lossless.h payload (little-endian).
+// A report record has the same header: n_channels mics, n_frames stream frames per
+// report, frame the stream frame one past the analysed frame's end.
+typedef struct __attribute__((packed)) {
+    uint16_t sync;                  // VSTREAM_SYNC, VSTREAM_SYNC_STAMPED or VSTREAM_SYNC_DETECT
+    uint8_t  n_channels;
+    uint8_t  bits;                  // 16 or 24 (0: report)
+    uint16_t n_frames;
+    uint16_t bytes;                 // whole block, header (and stamp) included
+    uint32_t seq;                   // +1 per block since START
+    uint32_t frame;                 // stream-rate index of the first frame since START
+    uint32_t time_us;               // device time the block was coded
+} vstream_block_t;
+
+_Static_assert(sizeof(vstream_block_t) == VSTREAM_HEADER_BYTES, "vstream block header size");
+
+// SOF stamp of a stamped block: the stream position at the latest SOF before the block
+// was coded. `pos_q8` counts stream frames from the block's first frame (negative: the
+// SOF came after that frame was captured), so frame + pos_q8 / 256 is the SOF's place
+// in the stream. Positions come from the DMA write pointer at the SOF callback, which
+// runs sof_time_us - (SOF time) late; hosts correct that from the timestamps.
+typedef struct __attribute__((packed)) {
+    uint32_t sof;                   // USB frame number, extended past 11 bits by the device
+    int32_t  pos_q8;                // stream position at that SOF relative to `frame`, 1/256 frames
+    uint32_t sof_time_us;           // device time the SOF callback read the position
+} vstream_stamp_t;
+
+_Static_assert(sizeof(vstream_stamp_t) == VSTREAM_STAMP_BYTES, "vstream stamp size");
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint8_t  n_channels;
+    uint8_t  bits;                  // of the running stream, else 0
+    uint32_t sample_rate;           // Clock Source rate (set it with the UAC2 request)
+    uint16_t max_block_bytes;       // at this rate and depth
+    uint8_t  running;
+    uint8_t  reserved;
+    uint32_t blocks;                // sent since boot
+    uint32_t bytes;                 // block and report bytes sent since boot
+    uint32_t raw_bytes;             // what the same frames take as PCM
+    uint32_t stalls;                // SOFs a finished block waited for room in the bulk FIFO
+} vstream_info_t;
+
+// ---------- Device side (core0) ----------
+// START/STOP (telemetry.c dispatches the requests); value is START's wValue. Start fails
+// while the iso stream runs.
+bool vstream_start(uint32_t value);
+void vstream_stop(void);
+void vstream_info(vstream_info_t *info);
+
+// Moves finished blocks from the pipeline to the bulk endpoint and hands the SOF's
+// capture position (capture_position()) to the stamps; call from the SOF callback.
+void vstream_sof(uint32_t frame_count, uint32_t cap_frames, uint32_t cap_frac_q8);
+
+#endif // VSTREAM_H